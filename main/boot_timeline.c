@@ -0,0 +1,126 @@
+#include "boot_timeline.h"
+#include "mqtt_manager.h"
+#include "wifi_manager.h"
+#include "json_writer.h"
+#include "esp_system.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include <stdbool.h>
+
+static const char *TAG = "BOOT";
+
+static const char *boot_stage_names[BOOT_STAGE_COUNT] = {
+    "sensors", "wifi", "ip", "time", "mqtt", "first_publish"
+};
+
+static uint32_t stage_ms[BOOT_STAGE_COUNT];
+static uint32_t reached = 0;   // Bit por etapa
+static portMUX_TYPE timeline_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *boot_reset_name(void)
+{
+    switch (esp_reset_reason()) {
+    case ESP_RST_POWERON:   return "poweron";
+    case ESP_RST_EXT:       return "ext";
+    case ESP_RST_SW:        return "sw";
+    case ESP_RST_PANIC:     return "panic";
+    case ESP_RST_INT_WDT:
+    case ESP_RST_TASK_WDT:
+    case ESP_RST_WDT:       return "wdt";
+    case ESP_RST_DEEPSLEEP: return "deepsleep";
+    case ESP_RST_BROWNOUT:  return "brownout";
+    default:                return "other";
+    }
+}
+
+static const char *boot_wake_name(void)
+{
+    switch (esp_sleep_get_wakeup_cause()) {
+    case ESP_SLEEP_WAKEUP_UNDEFINED: return "none";
+    case ESP_SLEEP_WAKEUP_TIMER:     return "timer";
+    case ESP_SLEEP_WAKEUP_ULP:       return "ulp";
+    default:                         return "other";
+    }
+}
+
+// Log e publicação retida; etapas não alcançadas ficam de fora
+static void boot_timeline_report(void)
+{
+    static char message[320];
+    json_writer_t w;
+
+    json_writer_init(&w, message, sizeof(message));
+    json_writer_begin_object(&w, NULL);
+    mqtt_manager_add_device_id(&w);
+    json_writer_add_string(&w, "reset", boot_reset_name());
+    json_writer_add_string(&w, "wake", boot_wake_name());
+    json_writer_begin_object(&w, "ms");
+    for (int i = 0; i < BOOT_STAGE_COUNT; i++) {
+        int32_t ms = boot_timeline_get_ms(i);
+        if (ms >= 0) {
+            json_writer_add_int(&w, boot_stage_names[i], ms);
+        }
+    }
+    json_writer_end_object(&w);
+    // Associação -> IP: pago a cada despertar no duty cycle
+    wifi_manager_stats_t wifi = wifi_manager_get_stats();
+    json_writer_add_int(&w, "assoc_ip_ms", wifi.last_ip_ms);
+    json_writer_add_string(&w, "ip_mode", wifi_manager_ip_mode_name());
+    json_writer_end_object(&w);
+    size_t len = json_writer_finish(&w);
+
+    ESP_LOGI(TAG, "Boot -> primeira publicação: %ld ms (WiFi %ld, IP %ld, hora %ld, MQTT %ld, sensores %ld)",
+             (long)boot_timeline_get_ms(BOOT_STAGE_FIRST_PUBLISH),
+             (long)boot_timeline_get_ms(BOOT_STAGE_WIFI), (long)boot_timeline_get_ms(BOOT_STAGE_IP),
+             (long)boot_timeline_get_ms(BOOT_STAGE_TIME), (long)boot_timeline_get_ms(BOOT_STAGE_MQTT),
+             (long)boot_timeline_get_ms(BOOT_STAGE_SENSORS));
+    ESP_LOGI(TAG, "Associação -> IP: %lu ms (%s)", (unsigned long)wifi.last_ip_ms,
+             wifi_manager_ip_mode_name());
+
+    if (len > 0) {
+        mqtt_manager_publish(TOPIC_BOOT, message, len);
+    }
+}
+
+void boot_timeline_mark(boot_stage_t stage)
+{
+    if (stage >= BOOT_STAGE_COUNT) {
+        return;
+    }
+
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    bool first = false;
+
+    portENTER_CRITICAL(&timeline_mux);
+    if (!(reached & (1u << stage))) {
+        reached |= 1u << stage;
+        stage_ms[stage] = now_ms;
+        first = true;
+    }
+    portEXIT_CRITICAL(&timeline_mux);
+
+    if (!first) {
+        return;
+    }
+    ESP_LOGD(TAG, "Etapa %s em %lu ms", boot_stage_names[stage], (unsigned long)now_ms);
+    if (stage == BOOT_STAGE_FIRST_PUBLISH) {
+        boot_timeline_report();
+    }
+}
+
+int32_t boot_timeline_get_ms(boot_stage_t stage)
+{
+    if (stage >= BOOT_STAGE_COUNT) {
+        return -1;
+    }
+
+    int32_t ms = -1;
+    portENTER_CRITICAL(&timeline_mux);
+    if (reached & (1u << stage)) {
+        ms = (int32_t)stage_ms[stage];
+    }
+    portEXIT_CRITICAL(&timeline_mux);
+    return ms;
+}
@@ -0,0 +1,39 @@
+#ifndef BOOT_TIMELINE_H
+#define BOOT_TIMELINE_H
+
+#include <stdint.h>
+
+/**
+ * Linha do tempo do boot
+ *
+ * O boot não espera mais em sequência: sensores, WiFi, SNTP e MQTT avançam em
+ * paralelo, guiados pelos eventos do connectivity_manager. Cada etapa marca
+ * aqui o instante (ms desde o reset) em que ficou pronta pela primeira vez.
+ * Na primeira leitura entregue ao broker a linha do tempo é registrada no log
+ * e publicada (retida) em TOPIC_BOOT.
+ */
+
+#define TOPIC_BOOT "esp32/boot"
+
+typedef enum {
+    BOOT_STAGE_SENSORS,        // Sensores e atuadores inicializados
+    BOOT_STAGE_WIFI,           // Associado ao AP
+    BOOT_STAGE_IP,             // IP obtido
+    BOOT_STAGE_TIME,           // Relógio sincronizado pelo SNTP
+    BOOT_STAGE_MQTT,           // Sessão MQTT ativa
+    BOOT_STAGE_FIRST_PUBLISH,  // Primeira telemetria entregue ao cliente MQTT
+    BOOT_STAGE_COUNT
+} boot_stage_t;
+
+/**
+ * @brief Marca uma etapa (só a primeira vez conta; reconexões são ignoradas)
+ * Pode ser chamada de qualquer task ou callback de evento
+ */
+void boot_timeline_mark(boot_stage_t stage);
+
+/**
+ * @brief Instante da etapa em ms desde o reset (-1 se ainda não chegou)
+ */
+int32_t boot_timeline_get_ms(boot_stage_t stage);
+
+#endif // BOOT_TIMELINE_H
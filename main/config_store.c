@@ -0,0 +1,310 @@
+#include "config_store.h"
+#include "plant_config.h"
+#include "system_commands.h"
+#include "power_manager.h"
+#include "wifi_manager.h"
+#include "nvs.h"
+#include "esp_crc.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <string.h>
+
+static const char *TAG = "CONFIG_STORE";
+
+// Cabeçalho gravado antes da struct
+typedef struct {
+    uint16_t version;
+    uint16_t size;
+    uint32_t crc;     // CRC32 da struct
+} config_blob_header_t;
+
+#define CONFIG_STORE_MAX_SIZE 64   // Maior struct persistida
+
+typedef struct {
+    const char *key;                   // Chave na NVS
+    uint16_t version;
+    uint16_t size;
+    void (*read)(void *out);           // Cópia da configuração ativa
+    void (*restore)(const void *in);   // Substitui a configuração ativa
+} config_store_entry_t;
+
+static void config_store_read_plant(void *out)
+{
+    memcpy(out, plant_config_get(), sizeof(plant_config_t));
+}
+
+static void config_store_restore_plant(const void *in)
+{
+    memcpy(plant_config_get(), in, sizeof(plant_config_t));
+}
+
+static void config_store_read_system(void *out)
+{
+    system_config_t cfg = system_commands_get_config();
+    memcpy(out, &cfg, sizeof(cfg));
+}
+
+static void config_store_restore_system(const void *in)
+{
+    system_config_t cfg;
+    memcpy(&cfg, in, sizeof(cfg));
+    system_commands_restore_config(&cfg);
+}
+
+static void config_store_read_power(void *out)
+{
+    power_config_t cfg = power_manager_get_config();
+    memcpy(out, &cfg, sizeof(cfg));
+}
+
+static void config_store_restore_power(const void *in)
+{
+    power_config_t cfg;
+    memcpy(&cfg, in, sizeof(cfg));
+    power_manager_restore_config(&cfg);
+}
+
+static void config_store_read_wifi(void *out)
+{
+    wifi_ap_cache_t cache = wifi_manager_get_ap_cache();
+    memcpy(out, &cache, sizeof(cache));
+}
+
+static void config_store_restore_wifi(const void *in)
+{
+    wifi_ap_cache_t cache;
+    memcpy(&cache, in, sizeof(cache));
+    wifi_manager_restore_ap_cache(&cache);
+}
+
+static const config_store_entry_t entries[CONFIG_STORE_COUNT] = {
+    [CONFIG_STORE_PLANT]  = {"plant",  CONFIG_STORE_PLANT_VERSION,  sizeof(plant_config_t),
+                             config_store_read_plant, config_store_restore_plant},
+    [CONFIG_STORE_SYSTEM] = {"system", CONFIG_STORE_SYSTEM_VERSION, sizeof(system_config_t),
+                             config_store_read_system, config_store_restore_system},
+    [CONFIG_STORE_POWER]  = {"power",  CONFIG_STORE_POWER_VERSION,  sizeof(power_config_t),
+                             config_store_read_power, config_store_restore_power},
+    [CONFIG_STORE_WIFI]   = {"wifi",   CONFIG_STORE_WIFI_VERSION,   sizeof(wifi_ap_cache_t),
+                             config_store_read_wifi, config_store_restore_wifi},
+};
+
+_Static_assert(sizeof(plant_config_t) <= CONFIG_STORE_MAX_SIZE, "plant_config_t grande demais");
+_Static_assert(sizeof(system_config_t) <= CONFIG_STORE_MAX_SIZE, "system_config_t grande demais");
+_Static_assert(sizeof(power_config_t) <= CONFIG_STORE_MAX_SIZE, "power_config_t grande demais");
+_Static_assert(sizeof(wifi_ap_cache_t) <= CONFIG_STORE_MAX_SIZE, "wifi_ap_cache_t grande demais");
+
+static nvs_handle_t nvs = 0;
+static bool opened = false;
+static SemaphoreHandle_t store_mutex = NULL;
+static SemaphoreHandle_t flush_signal = NULL;   // Timer -> task de gravação
+static esp_timer_handle_t flush_timer = NULL;
+
+// Alterações pendentes (um bit por configuração)
+static portMUX_TYPE dirty_mux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t dirty = 0;
+static int64_t first_dirty_us = 0;
+static int64_t last_write_us = 0;
+
+// CRC do que está na NVS: gravação igual é pulada
+static uint32_t stored_crc[CONFIG_STORE_COUNT];
+static bool stored_valid[CONFIG_STORE_COUNT];
+
+static uint32_t config_store_crc(const void *data, size_t size)
+{
+    return esp_crc32_le(0, data, size);
+}
+
+// Lê e valida o blob; true se o conteúdo em out é utilizável
+static bool config_store_load(config_store_id_t id, uint8_t *out)
+{
+    const config_store_entry_t *e = &entries[id];
+    uint8_t blob[sizeof(config_blob_header_t) + CONFIG_STORE_MAX_SIZE];
+    size_t len = sizeof(blob);
+
+    esp_err_t ret = nvs_get_blob(nvs, e->key, blob, &len);
+    if (ret == ESP_ERR_NVS_NOT_FOUND) {
+        ESP_LOGI(TAG, "%s: nada salvo, usando os padrões", e->key);
+        return false;
+    }
+    if (ret != ESP_OK || len < sizeof(config_blob_header_t)) {
+        ESP_LOGW(TAG, "%s: falha ao ler (%s)", e->key, esp_err_to_name(ret));
+        return false;
+    }
+
+    config_blob_header_t header;
+    memcpy(&header, blob, sizeof(header));
+    if (header.version != e->version || header.size != e->size ||
+        len != sizeof(header) + e->size) {
+        ESP_LOGW(TAG, "%s: versão %u (%u bytes) incompatível com %u (%u bytes), descartado",
+                 e->key, header.version, header.size, e->version, e->size);
+        return false;
+    }
+    memcpy(out, blob + sizeof(header), e->size);
+    if (config_store_crc(out, e->size) != header.crc) {
+        ESP_LOGW(TAG, "%s: CRC inválido, descartado", e->key);
+        return false;
+    }
+
+    stored_crc[id] = header.crc;
+    stored_valid[id] = true;
+    return true;
+}
+
+// Grava as configurações marcadas; chamar com store_mutex
+static void config_store_write(uint32_t mask)
+{
+    uint8_t blob[sizeof(config_blob_header_t) + CONFIG_STORE_MAX_SIZE];
+    int written = 0;
+
+    for (int id = 0; id < CONFIG_STORE_COUNT; id++) {
+        if (!(mask & (1u << id))) {
+            continue;
+        }
+        const config_store_entry_t *e = &entries[id];
+        config_blob_header_t header = {.version = e->version, .size = e->size};
+
+        e->read(blob + sizeof(header));
+        header.crc = config_store_crc(blob + sizeof(header), e->size);
+        if (stored_valid[id] && stored_crc[id] == header.crc) {
+            continue;   // Voltou ao que já estava gravado
+        }
+        memcpy(blob, &header, sizeof(header));
+
+        esp_err_t ret = nvs_set_blob(nvs, e->key, blob, sizeof(header) + e->size);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "%s: falha ao gravar (%s)", e->key, esp_err_to_name(ret));
+            stored_valid[id] = false;
+            continue;
+        }
+        stored_crc[id] = header.crc;
+        stored_valid[id] = true;
+        written++;
+        ESP_LOGI(TAG, "%s: gravado (v%u, %u bytes)", e->key, e->version, e->size);
+    }
+
+    if (written > 0) {
+        esp_err_t ret = nvs_commit(nvs);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "Falha no commit da NVS (%s)", esp_err_to_name(ret));
+        }
+        portENTER_CRITICAL(&dirty_mux);
+        last_write_us = esp_timer_get_time();
+        portEXIT_CRITICAL(&dirty_mux);
+    }
+}
+
+void config_store_flush(void)
+{
+    if (!opened) {
+        return;
+    }
+
+    // Mudança depois daqui rearma o timer e sai na próxima gravação
+    esp_timer_stop(flush_timer);
+    portENTER_CRITICAL(&dirty_mux);
+    uint32_t mask = dirty;
+    dirty = 0;
+    portEXIT_CRITICAL(&dirty_mux);
+
+    if (mask == 0) {
+        return;
+    }
+    xSemaphoreTake(store_mutex, portMAX_DELAY);
+    config_store_write(mask);
+    xSemaphoreGive(store_mutex);
+}
+
+// Só sinaliza: apagar/gravar a flash na task do esp_timer atrasaria os outros
+// timers (backoff de reconexão, debounce de comandos, verificação do IP)
+static void config_store_flush_timer(void *arg)
+{
+    xSemaphoreGive(flush_signal);
+}
+
+static void config_store_task(void *arg)
+{
+    while (1) {
+        if (xSemaphoreTake(flush_signal, portMAX_DELAY) == pdTRUE) {
+            config_store_flush();
+        }
+    }
+}
+
+void config_store_mark_dirty(config_store_id_t id)
+{
+    if (!opened || id >= CONFIG_STORE_COUNT) {
+        return;
+    }
+
+    int64_t now_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&dirty_mux);
+    if (dirty == 0) {
+        first_dirty_us = now_us;
+    }
+    dirty |= 1u << id;
+    int64_t first_us = first_dirty_us;
+    int64_t last_us = last_write_us;
+    portEXIT_CRITICAL(&dirty_mux);
+
+    // Mais mudanças adiam a gravação, até o limite contado da primeira
+    int64_t due_us = now_us + (int64_t)CONFIG_STORE_DEBOUNCE_MS * 1000;
+    int64_t deadline_us = first_us + (int64_t)CONFIG_STORE_DEBOUNCE_MAX_MS * 1000;
+    if (due_us > deadline_us) {
+        due_us = deadline_us;
+    }
+    if (last_us != 0) {
+        int64_t earliest_us = last_us + (int64_t)CONFIG_STORE_MIN_INTERVAL_MS * 1000;
+        if (due_us < earliest_us) {
+            due_us = earliest_us;
+        }
+    }
+
+    esp_timer_stop(flush_timer);
+    esp_timer_start_once(flush_timer, due_us > now_us ? due_us - now_us : 0);
+}
+
+void config_store_init(void)
+{
+    if (opened) {
+        return;
+    }
+
+    esp_err_t ret = nvs_open(CONFIG_STORE_NAMESPACE, NVS_READWRITE, &nvs);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Falha ao abrir a NVS (%s): configurações não serão salvas",
+                 esp_err_to_name(ret));
+        return;
+    }
+
+    store_mutex = xSemaphoreCreateMutex();
+    flush_signal = xSemaphoreCreateBinary();
+    xTaskCreate(config_store_task, "cfg_store", CONFIG_STORE_TASK_STACK, NULL,
+                CONFIG_STORE_TASK_PRIORITY, NULL);
+    const esp_timer_create_args_t timer_args = {
+        .callback = config_store_flush_timer,
+        .name = "cfg_store",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &flush_timer));
+    opened = true;
+
+    // Após deep sleep a RTC tem a versão mais nova (pendências são gravadas antes de dormir)
+    bool cold_boot = esp_reset_reason() != ESP_RST_DEEPSLEEP;
+    int restored = 0;
+
+    for (int id = 0; id < CONFIG_STORE_COUNT; id++) {
+        uint8_t data[CONFIG_STORE_MAX_SIZE];
+        if (config_store_load(id, data) && cold_boot) {
+            entries[id].restore(data);
+            restored++;
+        }
+    }
+
+    if (cold_boot) {
+        ESP_LOGI(TAG, "%d de %d configuração(ões) restaurada(s) da NVS", restored, CONFIG_STORE_COUNT);
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <stdint.h>
+
+/**
+ * Configurações persistidas na NVS
+ *
+ * Planta, sistema e power management ficam na RTC (valem entre deep sleeps);
+ * aqui elas também vão para a NVS, para um reset ou falta de energia não
+ * voltar aos padrões até a nuvem republicar. O último AP do WiFi também, para
+ * a primeira associação após ligar a placa dispensar a varredura. Cada uma é um blob com versão,
+ * tamanho e CRC32: blob de outra versão ou corrompido é ignorado (padrões).
+ *
+ * Alterações são agrupadas: a escrita sai CONFIG_STORE_DEBOUNCE_MS após a
+ * última mudança (no máximo CONFIG_STORE_DEBOUNCE_MAX_MS após a primeira),
+ * nunca antes de CONFIG_STORE_MIN_INTERVAL_MS da anterior, e só se o conteúdo
+ * mudou em relação ao que está gravado.
+ */
+
+#define CONFIG_STORE_NAMESPACE "config"
+#define CONFIG_STORE_DEBOUNCE_MS 5000
+#define CONFIG_STORE_DEBOUNCE_MAX_MS 30000
+#define CONFIG_STORE_MIN_INTERVAL_MS 60000   // Limita o desgaste da flash
+#define CONFIG_STORE_TASK_STACK 3072         // Gravação fora da task do esp_timer
+#define CONFIG_STORE_TASK_PRIORITY 1
+
+// Versão do layout de cada struct: incrementar ao mudar plant_config_t etc.
+#define CONFIG_STORE_PLANT_VERSION 1
+#define CONFIG_STORE_SYSTEM_VERSION 1
+#define CONFIG_STORE_POWER_VERSION 1
+#define CONFIG_STORE_WIFI_VERSION 1
+
+typedef enum {
+    CONFIG_STORE_PLANT,    // plant_config_t
+    CONFIG_STORE_SYSTEM,   // system_config_t
+    CONFIG_STORE_POWER,    // power_config_t
+    CONFIG_STORE_WIFI,     // wifi_ap_cache_t
+    CONFIG_STORE_COUNT
+} config_store_id_t;
+
+/**
+ * @brief Abre a NVS e, num boot frio, restaura as configurações salvas
+ * Após nvs_flash_init e antes das tasks e do power_manager_init. Ao acordar
+ * do deep sleep a cópia da RTC é a mais recente e é mantida
+ */
+void config_store_init(void);
+
+/**
+ * @brief Agenda a gravação de uma configuração alterada (não bloqueia)
+ */
+void config_store_mark_dirty(config_store_id_t id);
+
+/**
+ * @brief Grava já as alterações pendentes (antes do deep sleep ou de reiniciar)
+ */
+void config_store_flush(void);
+
+#endif // CONFIG_STORE_H
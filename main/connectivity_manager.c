@@ -0,0 +1,282 @@
+#include "connectivity_manager.h"
+#include "boot_timeline.h"
+#include "esp_wifi.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+
+static const char *TAG = "CONNECTIVITY";
+
+// Estado de reconexão de um enlace
+typedef struct {
+    const char *name;
+    esp_timer_handle_t timer;
+    uint32_t attempt;     // Falhas consecutivas (expoente do backoff)
+} connectivity_link_t;
+
+static connectivity_link_t wifi_link = {.name = "WiFi"};
+static connectivity_link_t mqtt_link = {.name = "MQTT"};
+
+static EventGroupHandle_t connectivity_events = NULL;
+static esp_mqtt_client_handle_t mqtt_client = NULL;
+static connectivity_stats_t stats = {0};
+static int64_t offline_since_us = 0;
+static bool mqtt_paused = false;   // Sessão encerrada de propósito até a próxima janela
+static bool wifi_paused = false;   // Rádio desligado de propósito até a próxima janela
+static bool wifi_resumed = false;  // Rádio acabou de religar: IP sem jitter no MQTT
+static bool mqtt_start_requested = false;
+static bool mqtt_started = false;  // esp_mqtt_client_start já chamado
+static portMUX_TYPE start_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Jitter total: espalha as reconexões de vários dispositivos após uma queda do AP
+static uint32_t connectivity_backoff_ms(uint32_t attempt)
+{
+    uint32_t ceiling = CONNECTIVITY_BACKOFF_BASE_MS;
+    for (uint32_t i = 0; i < attempt && ceiling < CONNECTIVITY_BACKOFF_MAX_MS; i++) {
+        ceiling *= 2;
+    }
+    if (ceiling > CONNECTIVITY_BACKOFF_MAX_MS) {
+        ceiling = CONNECTIVITY_BACKOFF_MAX_MS;
+    }
+    return esp_random() % (ceiling + 1);
+}
+
+static void connectivity_schedule(connectivity_link_t *link)
+{
+    if (link->timer == NULL || esp_timer_is_active(link->timer)) {
+        return;
+    }
+
+    uint32_t delay_ms = connectivity_backoff_ms(link->attempt);
+    link->attempt++;
+    stats.last_backoff_ms = delay_ms;
+
+    ESP_LOGW(TAG, "%s: nova tentativa em %lu ms (falha #%lu)", link->name,
+             (unsigned long)delay_ms, (unsigned long)link->attempt);
+    esp_timer_start_once(link->timer, (uint64_t)delay_ms * 1000);
+}
+
+static void connectivity_wifi_retry(void *arg)
+{
+    if (wifi_paused || connectivity_manager_has(CONNECTIVITY_WIFI_BIT)) {
+        return;
+    }
+    stats.wifi_attempts++;
+    esp_wifi_connect();
+}
+
+static void connectivity_mqtt_retry(void *arg)
+{
+    if (mqtt_client == NULL || mqtt_paused || connectivity_manager_has(CONNECTIVITY_MQTT_BIT)) {
+        return;
+    }
+    // Sem IP a tentativa falharia: é reagendada quando o IP voltar
+    if (!connectivity_manager_has(CONNECTIVITY_IP_BIT)) {
+        return;
+    }
+    stats.mqtt_attempts++;
+    esp_mqtt_client_reconnect(mqtt_client);
+}
+
+void connectivity_manager_init(void)
+{
+    if (connectivity_events != NULL) {
+        return;
+    }
+
+    connectivity_events = xEventGroupCreate();
+    offline_since_us = esp_timer_get_time();
+
+    const esp_timer_create_args_t wifi_timer_args = {
+        .callback = connectivity_wifi_retry,
+        .name = "wifi_retry",
+    };
+    const esp_timer_create_args_t mqtt_timer_args = {
+        .callback = connectivity_mqtt_retry,
+        .name = "mqtt_retry",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&wifi_timer_args, &wifi_link.timer));
+    ESP_ERROR_CHECK(esp_timer_create(&mqtt_timer_args, &mqtt_link.timer));
+
+    ESP_LOGI(TAG, "Supervisor de conectividade iniciado (backoff %d..%d ms)",
+             CONNECTIVITY_BACKOFF_BASE_MS, CONNECTIVITY_BACKOFF_MAX_MS);
+}
+
+void connectivity_manager_set_mqtt_client(esp_mqtt_client_handle_t client)
+{
+    mqtt_client = client;
+}
+
+void connectivity_manager_on_wifi_connected(void)
+{
+    xEventGroupSetBits(connectivity_events, CONNECTIVITY_WIFI_BIT);
+    boot_timeline_mark(BOOT_STAGE_WIFI);
+}
+
+// Primeiro início do cliente: só uma das chamadas (app_main ou evento do IP) inicia
+static bool connectivity_claim_mqtt_start(void)
+{
+    bool claim = false;
+
+    portENTER_CRITICAL(&start_mux);
+    if (mqtt_start_requested && !mqtt_started && mqtt_client != NULL &&
+        connectivity_manager_has(CONNECTIVITY_IP_BIT)) {
+        mqtt_started = true;
+        claim = true;
+    }
+    portEXIT_CRITICAL(&start_mux);
+    return claim;
+}
+
+void connectivity_manager_on_wifi_disconnected(uint8_t reason)
+{
+    EventBits_t previous = xEventGroupClearBits(connectivity_events,
+                                                CONNECTIVITY_WIFI_BIT | CONNECTIVITY_IP_BIT);
+    if (wifi_paused) {
+        return;
+    }
+    stats.last_wifi_reason = reason;
+    if (previous & CONNECTIVITY_WIFI_BIT) {
+        stats.wifi_disconnects++;
+    }
+    connectivity_schedule(&wifi_link);
+}
+
+void connectivity_manager_on_got_ip(void)
+{
+    xEventGroupSetBits(connectivity_events, CONNECTIVITY_WIFI_BIT | CONNECTIVITY_IP_BIT);
+    wifi_link.attempt = 0;
+    esp_timer_stop(wifi_link.timer);
+    boot_timeline_mark(BOOT_STAGE_IP);
+
+    if (connectivity_claim_mqtt_start()) {
+        ESP_LOGI(TAG, "IP obtido: iniciando o cliente MQTT");
+        esp_mqtt_client_start(mqtt_client);
+        return;
+    }
+
+    if (mqtt_client == NULL || mqtt_paused || connectivity_manager_has(CONNECTIVITY_MQTT_BIT)) {
+        wifi_resumed = false;
+        return;
+    }
+    esp_timer_stop(mqtt_link.timer);
+
+    // Rádio religado no horário da janela: não foi queda do AP, reconecta já
+    if (wifi_resumed) {
+        wifi_resumed = false;
+        esp_mqtt_client_reconnect(mqtt_client);
+        return;
+    }
+
+    // MQTT volta com jitter para não sincronizar a frota com o AP
+    connectivity_schedule(&mqtt_link);
+}
+
+void connectivity_manager_on_mqtt_connected(void)
+{
+    EventBits_t previous = xEventGroupSetBits(connectivity_events, CONNECTIVITY_MQTT_BIT);
+    mqtt_link.attempt = 0;
+    esp_timer_stop(mqtt_link.timer);
+    boot_timeline_mark(BOOT_STAGE_MQTT);
+
+    if (!(previous & CONNECTIVITY_MQTT_BIT)) {
+        int64_t offline_us = esp_timer_get_time() - offline_since_us;
+        stats.offline_ms += offline_us / 1000;
+        ESP_LOGI(TAG, "Online após %lld ms offline", (long long)(offline_us / 1000));
+    }
+}
+
+void connectivity_manager_on_mqtt_disconnected(void)
+{
+    EventBits_t previous = xEventGroupClearBits(connectivity_events, CONNECTIVITY_MQTT_BIT);
+    if (mqtt_paused) {
+        return;
+    }
+    if (previous & CONNECTIVITY_MQTT_BIT) {
+        stats.mqtt_disconnects++;
+        offline_since_us = esp_timer_get_time();
+    }
+    connectivity_schedule(&mqtt_link);
+}
+
+void connectivity_manager_on_time_synced(void)
+{
+    xEventGroupSetBits(connectivity_events, CONNECTIVITY_TIME_BIT);
+    boot_timeline_mark(BOOT_STAGE_TIME);
+}
+
+void connectivity_manager_start_mqtt(void)
+{
+    portENTER_CRITICAL(&start_mux);
+    mqtt_start_requested = true;
+    portEXIT_CRITICAL(&start_mux);
+
+    // Sem IP ainda: on_got_ip inicia
+    if (connectivity_claim_mqtt_start()) {
+        esp_mqtt_client_start(mqtt_client);
+    }
+}
+
+void connectivity_manager_pause_mqtt(void)
+{
+    mqtt_paused = true;
+    esp_timer_stop(mqtt_link.timer);
+}
+
+void connectivity_manager_resume_mqtt(void)
+{
+    if (!mqtt_paused) {
+        return;
+    }
+    mqtt_paused = false;
+    mqtt_link.attempt = 0;
+    offline_since_us = esp_timer_get_time();   // A pausa planejada não conta como offline
+
+    // Sem IP a reconexão sai quando o IP voltar (on_got_ip)
+    if (mqtt_client != NULL && connectivity_manager_has(CONNECTIVITY_IP_BIT) &&
+        !connectivity_manager_has(CONNECTIVITY_MQTT_BIT)) {
+        esp_mqtt_client_reconnect(mqtt_client);
+    }
+}
+
+void connectivity_manager_pause_wifi(void)
+{
+    wifi_paused = true;
+    esp_timer_stop(wifi_link.timer);
+    esp_timer_stop(mqtt_link.timer);
+}
+
+void connectivity_manager_resume_wifi(void)
+{
+    if (!wifi_paused) {
+        return;
+    }
+    wifi_paused = false;
+    wifi_resumed = true;
+    wifi_link.attempt = 0;
+}
+
+bool connectivity_manager_wait(EventBits_t bits, TickType_t timeout)
+{
+    EventBits_t set = xEventGroupWaitBits(connectivity_events, bits, pdFALSE, pdTRUE, timeout);
+    return (set & bits) == bits;
+}
+
+bool connectivity_manager_has(EventBits_t bits)
+{
+    return (xEventGroupGetBits(connectivity_events) & bits) == bits;
+}
+
+bool connectivity_manager_is_online(void)
+{
+    return connectivity_manager_has(CONNECTIVITY_MQTT_BIT);
+}
+
+connectivity_stats_t connectivity_manager_get_stats(void)
+{
+    connectivity_stats_t snapshot = stats;
+    if (!connectivity_manager_is_online()) {
+        snapshot.offline_ms += (esp_timer_get_time() - offline_since_us) / 1000;
+    }
+    return snapshot;
+}
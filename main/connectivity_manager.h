@@ -0,0 +1,107 @@
+#ifndef CONNECTIVITY_MANAGER_H
+#define CONNECTIVITY_MANAGER_H
+
+#include "mqtt_client.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Máquina de estados de conectividade (WiFi -> IP -> MQTT, e SNTP)
+ *
+ * Todas as reconexões passam por aqui com backoff exponencial limitado e
+ * jitter total: espera = aleatório(0, min(MAX, BASE * 2^tentativa)).
+ * As tasks bloqueiam no event group em vez de consultar uma variável global.
+ * O boot segue os mesmos eventos: o cliente MQTT inicia com o primeiro IP.
+ */
+
+// Bits do event group
+#define CONNECTIVITY_WIFI_BIT   (1 << 0)  // Associado ao AP
+#define CONNECTIVITY_IP_BIT     (1 << 1)  // Endereço IP obtido
+#define CONNECTIVITY_MQTT_BIT   (1 << 2)  // Sessão MQTT ativa
+#define CONNECTIVITY_TIME_BIT   (1 << 3)  // Relógio sincronizado pelo SNTP (não é limpo)
+
+// Backoff das reconexões
+#define CONNECTIVITY_BACKOFF_BASE_MS 1000     // Teto da primeira espera
+#define CONNECTIVITY_BACKOFF_MAX_MS  300000   // Teto máximo (5 min)
+
+// Contadores exportados no status
+typedef struct {
+    uint32_t wifi_attempts;      // Tentativas de associação (após a primeira)
+    uint32_t mqtt_attempts;      // Tentativas de reconexão MQTT
+    uint32_t wifi_disconnects;   // Quedas do WiFi
+    uint32_t mqtt_disconnects;   // Quedas da sessão MQTT
+    uint32_t last_backoff_ms;    // Última espera sorteada
+    uint8_t last_wifi_reason;    // Motivo da última queda do WiFi (wifi_err_reason_t)
+    int64_t offline_ms;          // Tempo total sem sessão MQTT (inclui a queda atual)
+} connectivity_stats_t;
+
+/**
+ * @brief Cria o event group e os timers de reconexão (antes do WiFi)
+ */
+void connectivity_manager_init(void);
+
+/**
+ * @brief Define o cliente MQTT reconectado pelo supervisor
+ */
+void connectivity_manager_set_mqtt_client(esp_mqtt_client_handle_t client);
+
+/**
+ * Eventos informados pelo wifi_manager e pelo mqtt_manager
+ */
+void connectivity_manager_on_wifi_connected(void);
+void connectivity_manager_on_wifi_disconnected(uint8_t reason);
+void connectivity_manager_on_got_ip(void);
+void connectivity_manager_on_mqtt_connected(void);
+void connectivity_manager_on_mqtt_disconnected(void);
+void connectivity_manager_on_time_synced(void);
+
+/**
+ * @brief Inicia o cliente MQTT assim que houver IP (na hora, se já houver)
+ * A primeira conexão sai no evento do IP, sem tentativa falha nem backoff
+ */
+void connectivity_manager_start_mqtt(void);
+
+/**
+ * @brief Desconexão MQTT planejada: a queda seguinte não é reagendada nem contada
+ */
+void connectivity_manager_pause_mqtt(void);
+
+/**
+ * @brief Fim da pausa: reconecta imediatamente, sem backoff
+ */
+void connectivity_manager_resume_mqtt(void);
+
+/**
+ * @brief Rádio desligado de propósito: a queda seguinte não é reagendada nem contada
+ */
+void connectivity_manager_pause_wifi(void);
+
+/**
+ * @brief Rádio religado: o MQTT reconecta sem jitter assim que o IP voltar
+ */
+void connectivity_manager_resume_wifi(void);
+
+/**
+ * @brief Bloqueia até todos os bits estarem ativos
+ * @return true se os bits ficaram ativos antes do timeout
+ */
+bool connectivity_manager_wait(EventBits_t bits, TickType_t timeout);
+
+/**
+ * @brief Verifica bits sem bloquear
+ */
+bool connectivity_manager_has(EventBits_t bits);
+
+/**
+ * @brief Indica se há sessão MQTT ativa
+ */
+bool connectivity_manager_is_online(void);
+
+/**
+ * @brief Obtém contadores de reconexão e tempo offline
+ */
+connectivity_stats_t connectivity_manager_get_stats(void);
+
+#endif // CONNECTIVITY_MANAGER_H
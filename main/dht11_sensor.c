@@ -1,8 +1,14 @@
 #include "dht11_sensor.h"
 #include "system_commands.h"
 #include "power_manager.h"
+#include "sampling_governor.h"
+#include "json_writer.h"
+#include "mqtt_manager.h"
+#include "connectivity_manager.h"
+#include "timestamp.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
+#include "esp_attr.h"
 #include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -10,12 +16,9 @@
 #include "rom/ets_sys.h"
 #include <stdio.h>
 #include <string.h>
-#include <time.h>
-#include <sys/time.h>
 #include <stdbool.h>
 
 static const char *TAG = "DHT11_SENSOR";
-extern bool mqtt_connected;
 static SemaphoreHandle_t dht11_mutex = NULL;
 
 esp_err_t dht11_sensor_init(void)
@@ -41,18 +44,9 @@ esp_err_t dht11_sensor_init(void)
     return ESP_OK;
 }
 
-esp_err_t dht11_sensor_read(int16_t *humidity, int16_t *temperature)
+// Protocolo de um fio; chamada com o mutex e o lock de PM
+static esp_err_t dht11_sensor_decode(int16_t *humidity, int16_t *temperature)
 {
-    if (humidity == NULL || temperature == NULL) {
-        return ESP_ERR_INVALID_ARG;
-    }
-    
-    // Aguarda mutex por até 1 segundo
-    if (xSemaphoreTake(dht11_mutex, pdMS_TO_TICKS(1000)) != pdTRUE) {
-        ESP_LOGW(TAG, "Timeout ao aguardar mutex");
-        return ESP_ERR_TIMEOUT;
-    }
-    
     uint8_t bits[5] = {0, 0, 0, 0, 0};
     uint8_t cnt = 7;
     uint8_t idx = 0;
@@ -78,7 +72,6 @@ esp_err_t dht11_sensor_read(int16_t *humidity, int16_t *temperature)
     while (gpio_get_level(DHT11_GPIO) == 1) {
         if (++timeout > 200) {  // Aumentado de 100 para 200
             taskENABLE_INTERRUPTS();
-            xSemaphoreGive(dht11_mutex);
             //ESP_LOGW(TAG, "Timeout: sensor não puxou LOW");
             return ESP_FAIL;
         }
@@ -90,7 +83,6 @@ esp_err_t dht11_sensor_read(int16_t *humidity, int16_t *temperature)
     while (gpio_get_level(DHT11_GPIO) == 0) {
         if (++timeout > 200) {  // Aumentado de 100 para 200
             taskENABLE_INTERRUPTS();
-            xSemaphoreGive(dht11_mutex);
             ESP_LOGW(TAG, "Timeout: sensor não respondeu HIGH");
             return ESP_FAIL;
         }
@@ -102,7 +94,6 @@ esp_err_t dht11_sensor_read(int16_t *humidity, int16_t *temperature)
     while (gpio_get_level(DHT11_GPIO) == 1) {
         if (++timeout > 200) {  // Aumentado de 100 para 200
             taskENABLE_INTERRUPTS();
-            xSemaphoreGive(dht11_mutex);
             ESP_LOGW(TAG, "Timeout: início da transmissão");
             return ESP_FAIL;
         }
@@ -117,7 +108,6 @@ esp_err_t dht11_sensor_read(int16_t *humidity, int16_t *temperature)
             ets_delay_us(1);
             if (++timeout > 200) {  // Timeout generoso
                 taskENABLE_INTERRUPTS();
-                xSemaphoreGive(dht11_mutex);
                 ESP_LOGW(TAG, "Timeout bit %d LOW (após %dus)", i, timeout);
                 return ESP_FAIL;
             }
@@ -130,7 +120,6 @@ esp_err_t dht11_sensor_read(int16_t *humidity, int16_t *temperature)
             high_count++;
             if (high_count > 300) {  // Timeout muito generoso para último bit
                 taskENABLE_INTERRUPTS();
-                xSemaphoreGive(dht11_mutex);
                 ESP_LOGW(TAG, "Timeout bit %d HIGH (após %dus)", i, high_count);
                 return ESP_FAIL;
             }
@@ -159,20 +148,38 @@ esp_err_t dht11_sensor_read(int16_t *humidity, int16_t *temperature)
     if (bits[4] != checksum) {
         ESP_LOGW(TAG, "Checksum fail: calc=0x%02X recv=0x%02X", checksum, bits[4]);
         ESP_LOGD(TAG, "Data: %02X %02X %02X %02X %02X", bits[0], bits[1], bits[2], bits[3], bits[4]);
-        xSemaphoreGive(dht11_mutex);
         return ESP_FAIL;
     }
     
     *humidity = bits[0];
     *temperature = bits[2];
     
-    xSemaphoreGive(dht11_mutex);
-    
     ESP_LOGI(TAG, "Temp=%d°C Umid=%d%%", *temperature, *humidity);
     
     return ESP_OK;
 }
 
+esp_err_t dht11_sensor_read(int16_t *humidity, int16_t *temperature)
+{
+    if (humidity == NULL || temperature == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    // Aguarda mutex por até 1 segundo
+    if (xSemaphoreTake(dht11_mutex, pdMS_TO_TICKS(1000)) != pdTRUE) {
+        ESP_LOGW(TAG, "Timeout ao aguardar mutex");
+        return ESP_ERR_TIMEOUT;
+    }
+    
+    // Frequência máxima e sem light sleep durante o pulso de start e os 40 bits
+    power_manager_lock(POWER_LOCK_DHT11);
+    esp_err_t ret = dht11_sensor_decode(humidity, temperature);
+    power_manager_unlock(POWER_LOCK_DHT11);
+    
+    xSemaphoreGive(dht11_mutex);
+    return ret;
+}
+
 bool dht11_read_data(float *temperature, float *humidity)
 {
     if (temperature == NULL || humidity == NULL) {
@@ -196,16 +203,22 @@ void dht11_sensor_task(void *pvParameters)
     esp_mqtt_client_handle_t client = (esp_mqtt_client_handle_t)pvParameters;
     int16_t temperature = 0, humidity = 0;
     char message[256];
-    int counter = 0;
+    static RTC_DATA_ATTR int counter = 0;   // Continua após o deep sleep
     
     ESP_LOGI(TAG, "Task do sensor DHT11 iniciada no Core %d", xPortGetCoreID());
     
-    // Aguarda inicialização e estabilização do sensor
-    // DHT11 precisa de ~1s após ligar para estabilizar
-    vTaskDelay(pdMS_TO_TICKS(10000));
+    // DHT11 precisa de ~1s após ligar para estabilizar; o boot até aqui já conta
+    int64_t since_boot_ms = esp_timer_get_time() / 1000;
+    if (since_boot_ms < DHT11_STARTUP_MS) {
+        vTaskDelay(pdMS_TO_TICKS(DHT11_STARTUP_MS - since_boot_ms));
+    }
     
     while (1) {
-        if (mqtt_connected && client != NULL) {
+        // Bloqueia até haver sessão MQTT (sem polling)
+        connectivity_manager_wait(CONNECTIVITY_MQTT_BIT, portMAX_DELAY);
+        
+        // Só lê com o período deste sensor vencido
+        if (client != NULL && sampling_governor_is_due(SAMPLING_DHT11)) {
             // Tenta ler até 3 vezes com intervalo de 2.5s entre tentativas
             esp_err_t res = ESP_FAIL;
             int retry = 0;
@@ -221,44 +234,42 @@ void dht11_sensor_task(void *pvParameters)
             }
             
             if (res == ESP_OK) {
-                // Obtém timestamp Unix em segundos e converte para milissegundos
-                time_t now;
-                time(&now);
-                int64_t timestamp_ms = (int64_t)now * 1000;
+                // Horário da leitura (ms) e formatado para o log
+                timestamp_t ts = timestamp_now();
+                char time_str[32];
+                bool dated = timestamp_format(ts, time_str, sizeof(time_str));
                 
-                // Obtém horário formatado para log
-                struct tm timeinfo;
-                localtime_r(&now, &timeinfo);
-                char time_str[64];
-                strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", &timeinfo);
-                
-                snprintf(message, sizeof(message),
-                    "{\"device_id\":\"ESP32_Client\",\"temperature\":%d,\"humidity\":%d,\"counter\":%d,\"timestamp\":%lld,\"datetime\":\"%s\",\"retries\":%d}",
-                    temperature, humidity, counter, timestamp_ms, time_str, retry);
+                json_writer_t w;
+                json_writer_init(&w, message, sizeof(message));
+                json_writer_begin_object(&w, NULL);
+                mqtt_manager_add_device_id(&w);
+                json_writer_add_int(&w, "temperature", temperature);
+                json_writer_add_int(&w, "humidity", humidity);
+                json_writer_add_int(&w, "counter", counter);
+                json_writer_add_int(&w, "seq", mqtt_manager_next_seq(TOPIC_DHT11));
+                timestamp_add_json(&w, ts);
+                if (dated) {
+                    json_writer_add_string(&w, "datetime", time_str);
+                }
+                json_writer_add_int(&w, "retries", retry);
+                json_writer_end_object(&w);
+                size_t len = json_writer_finish(&w);
                 
-                int msg_id = esp_mqtt_client_publish(client, TOPIC_DHT11, message, 0, 1, 0);
-                ESP_LOGI(TAG, "Publicado [%s] [msg_id=%d]: Temp=%d°C, Umid=%d%% (tentativas:%d)", 
-                         time_str, msg_id, temperature, humidity, retry);
+                esp_err_t pub = len > 0 ? mqtt_manager_publish(TOPIC_DHT11, message, len) : ESP_ERR_INVALID_SIZE;
+                ESP_LOGI(TAG, "Publicado [%s] [%s]: Temp=%d°C, Umid=%d%% (tentativas:%d)", 
+                         time_str, esp_err_to_name(pub), temperature, humidity, retry);
                 counter++;
-                
-                // Marca que publicou dados
-                power_manager_mark_sensor_published("dht11");
+                sampling_governor_update(SAMPLING_DHT11, temperature);
             } else {
                 ESP_LOGE(TAG, "Falha ao ler DHT11 após %d tentativas", max_retries);
             }
-        } else {
-            ESP_LOGW(TAG, "MQTT não conectado, aguardando...");
         }
         
-        // Aguarda período configurável entre ciclos de leitura
-        int delay_ms = system_commands_get_read_period_ms();
+        // Aguarda a próxima janela (menor período entre os sensores)
+        int delay_ms = sampling_governor_window_ms();
         ESP_LOGI(TAG, "Próxima leitura em %d ms (%d min)", delay_ms, delay_ms/60000);
         
         // Usa power manager para sleep inteligente
-        if (power_manager_should_sleep(delay_ms)) {
-            power_manager_sleep(delay_ms);
-        } else {
-            vTaskDelay(pdMS_TO_TICKS(delay_ms));
-        }
+        power_manager_end_cycle(POWER_SENSOR_DHT11, delay_ms);
     }
 }
\ No newline at end of file
@@ -8,6 +8,8 @@
 // Configurações do sensor DHT11
 #define DHT11_GPIO 27  // GPIO digital - Lado direito da placa
 #define TOPIC_DHT11 "esp32/dht11"
+#define TOPIC_DHT11_FORCED "esp32/sensor/dht11"  // Leitura sob demanda (publish_all)
+#define DHT11_STARTUP_MS 1500  // Estabilização após energizar (contada desde o boot)
 
 /**
  * @brief Inicializa o sensor DHT11
@@ -0,0 +1,331 @@
+#include "duty_cycle.h"
+#include "power_manager.h"
+#include "plant_config.h"
+#include "dht11_sensor.h"
+#include "soil_moisture.h"
+#include "uv_sensor.h"
+#include "mqtt_manager.h"
+#include "connectivity_manager.h"
+#include "json_writer.h"
+#include "energy_model.h"
+#include "sampling_governor.h"
+#include "power_budget.h"
+#include "soil_watch.h"
+#include "config_store.h"
+#include "timestamp.h"
+#include "esp_attr.h"
+#include "esp_sleep.h"
+#include "esp_wifi.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <sys/time.h>
+#include <time.h>
+
+static const char *TAG = "DUTY_CYCLE";
+
+#define DUTY_CYCLE_NO_READING INT8_MIN   // DHT11 falhou nesta amostra
+#define DUTY_CYCLE_DHT11_RETRY_MS 2500   // DHT11 precisa de 2 s entre leituras
+
+// Amostra de um despertar sem WiFi
+typedef struct {
+    uint32_t timestamp;    // s desde 1970 (timestamp_now; o relógio da RTC segue no deep sleep)
+    int8_t temperature;    // °C ou DUTY_CYCLE_NO_READING
+    uint8_t humidity;      // %
+    uint16_t soil_raw;     // ADC 0-4095
+    uint16_t uv_raw;       // ADC 0-4095
+    bool synced;           // timestamp_t.synced da amostra (sem SNTP pode ser só uptime)
+} duty_cycle_sample_t;
+
+// Estado que sobrevive ao deep sleep (zerado ao ligar)
+static RTC_DATA_ATTR struct {
+    bool armed;                    // Dormiu por duty_cycle_deep_sleep
+    bool watched;                  // Dormiu com o ULP vigiando o solo
+    int64_t sleep_started_us;      // Relógio do sistema ao dormir
+    uint32_t sleep_requested_ms;   // Duração pedida ao timer
+    uint8_t head;                  // Amostra mais antiga
+    uint8_t count;
+    duty_cycle_sample_t samples[DUTY_CYCLE_BATCH_MAX];
+    duty_cycle_stats_t stats;
+} rtc_state;
+
+static bool woke_from_cycle = false;
+static bool woke_watched = false;   // Despertar após um sleep com a vigia do ULP
+static uint8_t in_flight = 0;   // Amostras publicadas neste despertar, aguardando confirmação
+
+static int64_t duty_cycle_now_us(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+void duty_cycle_init(void)
+{
+    esp_sleep_wakeup_cause_t cause = esp_sleep_get_wakeup_cause();
+    if (rtc_state.armed && (cause == ESP_SLEEP_WAKEUP_TIMER || cause == ESP_SLEEP_WAKEUP_ULP)) {
+        // O que passou do tempo pedido é ROM + bootloader: conta como acordado
+        // (o ULP acorda antes do timer: o sleep é o intervalo todo)
+        int64_t gap_ms = (duty_cycle_now_us() - rtc_state.sleep_started_us) / 1000;
+        uint32_t asleep_ms = rtc_state.sleep_requested_ms;
+        if (gap_ms < asleep_ms) {
+            asleep_ms = gap_ms > 0 ? gap_ms : 0;
+        }
+        rtc_state.stats.asleep_ms += asleep_ms;
+        if (gap_ms > asleep_ms) {
+            rtc_state.stats.awake_ms += gap_ms - asleep_ms;
+        }
+        rtc_state.stats.wakes++;
+        woke_from_cycle = true;
+
+        if (rtc_state.watched) {
+            woke_watched = true;
+            soil_watch_collect();
+            if (cause == ESP_SLEEP_WAKEUP_ULP) {
+                rtc_state.stats.ulp_wakes++;
+            }
+        }
+
+        uint32_t permille = duty_cycle_awake_permille();
+        ESP_LOGI(TAG, "Despertar #%lu do deep sleep (%u amostra(s) na RTC, acordado %lu.%lu%%)",
+                 (unsigned long)rtc_state.stats.wakes, rtc_state.count,
+                 (unsigned long)(permille / 10), (unsigned long)(permille % 10));
+    }
+    rtc_state.armed = false;
+    rtc_state.watched = false;
+}
+
+bool duty_cycle_is_active(void)
+{
+    power_config_t cfg = power_manager_get_config();
+    return cfg.enabled && cfg.mode == POWER_MODE_DEEP_SLEEP;
+}
+
+// Despertares por envio (mais espaçados com bateria baixa)
+static uint32_t duty_cycle_upload_every(void)
+{
+    return DUTY_CYCLE_UPLOAD_EVERY * power_budget_get_policy()->upload_scale;
+}
+
+bool duty_cycle_is_sample_wake(void)
+{
+    // Com a vigia do ULP todo despertar é de envio ou de solo seco
+    if (!woke_from_cycle || woke_watched || !duty_cycle_is_active()) {
+        return false;
+    }
+    // Lote cheio ou vez de enviar: janela completa com WiFi
+    return rtc_state.count < DUTY_CYCLE_BATCH_MAX &&
+           (rtc_state.stats.wakes % duty_cycle_upload_every()) != 0;
+}
+
+// Lê os sensores; retorna true se a umidade do solo pede irrigação
+static bool duty_cycle_take_sample(duty_cycle_sample_t *sample)
+{
+    int16_t temperature = 0, humidity = 0;
+    esp_err_t res = dht11_sensor_read(&humidity, &temperature);
+    if (res != ESP_OK) {
+        vTaskDelay(pdMS_TO_TICKS(DUTY_CYCLE_DHT11_RETRY_MS));
+        res = dht11_sensor_read(&humidity, &temperature);
+    }
+
+    int soil_raw = 0, uv_raw = 0;
+    soil_moisture_read(&soil_raw);
+    uv_sensor_read(&uv_raw);
+    power_budget_update();
+
+    timestamp_t ts = timestamp_now();
+    sample->timestamp = (uint32_t)(ts.ms / 1000);
+    sample->synced = ts.synced;
+    sample->temperature = res == ESP_OK ? (int8_t)temperature : DUTY_CYCLE_NO_READING;
+    sample->humidity = res == ESP_OK ? (uint8_t)humidity : 0;
+    sample->soil_raw = (uint16_t)soil_raw;
+    sample->uv_raw = (uint16_t)uv_raw;
+
+    // Mesma conversão da task do solo: 4095 (seco) -> 0%, 0 (úmido) -> 100%
+    int moisture_percent = 100 - ((soil_raw * 100) / 4095);
+    if (res == ESP_OK) {
+        sampling_governor_update(SAMPLING_DHT11, temperature);
+    }
+    sampling_governor_update(SAMPLING_SOIL, moisture_percent);
+    if (sampling_governor_is_due(SAMPLING_UV)) {
+        sampling_governor_update(SAMPLING_UV, (uv_raw * 100) / 4095);
+    }
+    return plant_config_should_irrigate(moisture_percent);
+}
+
+static void duty_cycle_store(const duty_cycle_sample_t *sample)
+{
+    if (rtc_state.count == DUTY_CYCLE_BATCH_MAX) {
+        // Envios falhando: descarta a mais antiga
+        rtc_state.head = (rtc_state.head + 1) % DUTY_CYCLE_BATCH_MAX;
+        rtc_state.count--;
+        rtc_state.stats.samples_lost++;
+    }
+    rtc_state.samples[(rtc_state.head + rtc_state.count) % DUTY_CYCLE_BATCH_MAX] = *sample;
+    rtc_state.count++;
+}
+
+void duty_cycle_sample_and_sleep(void)
+{
+    duty_cycle_sample_t sample;
+    bool irrigate = duty_cycle_take_sample(&sample);
+    duty_cycle_store(&sample);
+
+    if (irrigate) {
+        ESP_LOGW(TAG, "Solo seco na amostragem: janela completa para irrigar");
+        return;
+    }
+
+    rtc_state.stats.sample_wakes++;
+    duty_cycle_deep_sleep(sampling_governor_window_ms());
+}
+
+static void duty_cycle_guard_task(void *pvParameters)
+{
+    if (!connectivity_manager_wait(CONNECTIVITY_MQTT_BIT, pdMS_TO_TICKS(DUTY_CYCLE_CONNECT_TIMEOUT_MS))) {
+        ESP_LOGW(TAG, "Sem sessão MQTT em %d ms: amostra fica na RTC para o próximo envio",
+                 DUTY_CYCLE_CONNECT_TIMEOUT_MS);
+        rtc_state.stats.failed_windows++;
+        duty_cycle_sample_t sample;
+        duty_cycle_take_sample(&sample);
+        duty_cycle_store(&sample);
+        duty_cycle_deep_sleep(sampling_governor_window_ms());
+    }
+
+    int64_t elapsed_ms = esp_timer_get_time() / 1000;
+    if (elapsed_ms < DUTY_CYCLE_WINDOW_MAX_MS) {
+        vTaskDelay(pdMS_TO_TICKS(DUTY_CYCLE_WINDOW_MAX_MS - elapsed_ms));
+    }
+    if (duty_cycle_is_active()) {
+        ESP_LOGW(TAG, "Janela passou de %d ms: voltando ao deep sleep", DUTY_CYCLE_WINDOW_MAX_MS);
+        duty_cycle_deep_sleep(sampling_governor_window_ms());
+    }
+    vTaskDelete(NULL);
+}
+
+void duty_cycle_start_guard(void)
+{
+    if (!duty_cycle_is_active()) {
+        return;
+    }
+    xTaskCreate(duty_cycle_guard_task, "duty_guard", 3072, NULL, 2, NULL);
+}
+
+int duty_cycle_publish_batch(void)
+{
+    char message[MQTT_OUTBOUND_MAX_PAYLOAD];
+    uint8_t sent = 0;
+
+    while (sent < rtc_state.count) {
+        uint8_t chunk = 0;
+        bool unsynced = false;
+        json_writer_t w;
+        json_writer_init(&w, message, sizeof(message));
+        json_writer_begin_object(&w, NULL);
+        mqtt_manager_add_device_id(&w);
+        // Cada amostra: [timestamp, temperatura, umidade, solo_raw, uv_raw]
+        json_writer_begin_array(&w, "samples");
+        while (sent + chunk < rtc_state.count && chunk < DUTY_CYCLE_SAMPLES_PER_MSG) {
+            const duty_cycle_sample_t *s =
+                &rtc_state.samples[(rtc_state.head + sent + chunk) % DUTY_CYCLE_BATCH_MAX];
+            json_writer_begin_array(&w, NULL);
+            json_writer_add_int(&w, NULL, s->timestamp);
+            if (s->temperature == DUTY_CYCLE_NO_READING) {
+                json_writer_add_int(&w, NULL, -1);
+                json_writer_add_int(&w, NULL, -1);
+            } else {
+                json_writer_add_int(&w, NULL, s->temperature);
+                json_writer_add_int(&w, NULL, s->humidity);
+            }
+            json_writer_add_int(&w, NULL, s->soil_raw);
+            json_writer_add_int(&w, NULL, s->uv_raw);
+            json_writer_end_array(&w);
+            unsynced |= !s->synced;
+            chunk++;
+        }
+        json_writer_end_array(&w);
+        // Índices (nesta mensagem) das amostras com horário não sincronizado
+        if (unsynced) {
+            json_writer_begin_array(&w, "unsynced");
+            for (uint8_t i = 0; i < chunk; i++) {
+                if (!rtc_state.samples[(rtc_state.head + sent + i) % DUTY_CYCLE_BATCH_MAX].synced) {
+                    json_writer_add_int(&w, NULL, i);
+                }
+            }
+            json_writer_end_array(&w);
+        }
+        json_writer_add_int(&w, "seq", mqtt_manager_next_seq(TOPIC_BATCH));
+        json_writer_end_object(&w);
+        size_t len = json_writer_finish(&w);
+
+        if (len == 0 || mqtt_manager_publish(TOPIC_BATCH, message, len) != ESP_OK) {
+            ESP_LOGW(TAG, "Lote não enfileirado: %u amostra(s) ficam na RTC", rtc_state.count - sent);
+            break;
+        }
+        sent += chunk;
+    }
+
+    in_flight = sent;
+    if (sent > 0) {
+        ESP_LOGI(TAG, "Lote de %u amostra(s) publicado em %s", sent, TOPIC_BATCH);
+    }
+    return sent;
+}
+
+void duty_cycle_ack_batch(void)
+{
+    if (in_flight == 0) {
+        return;
+    }
+    rtc_state.head = (rtc_state.head + in_flight) % DUTY_CYCLE_BATCH_MAX;
+    rtc_state.count -= in_flight;
+    in_flight = 0;
+    rtc_state.stats.uploads++;
+}
+
+void duty_cycle_deep_sleep(uint32_t duration_ms)
+{
+    // ULP vigiando o solo: sem despertares só de amostragem, o timer marca o próximo envio.
+    // Em 64 bits: janela de 24 h x escala da bateria x envios passa de 2^32 ms
+    uint64_t sleep_ms = duration_ms;
+    rtc_state.watched = soil_watch_start();
+    if (rtc_state.watched) {
+        sleep_ms *= duty_cycle_upload_every();
+    }
+    if (sleep_ms > DUTY_CYCLE_SLEEP_MAX_MS) {
+        ESP_LOGW(TAG, "Deep sleep de %llu ms limitado a %lu ms", (unsigned long long)sleep_ms,
+                 (unsigned long)DUTY_CYCLE_SLEEP_MAX_MS);
+        sleep_ms = DUTY_CYCLE_SLEEP_MAX_MS;
+    }
+    duration_ms = (uint32_t)sleep_ms;
+
+    rtc_state.stats.awake_ms += esp_timer_get_time() / 1000;
+    energy_model_fold();
+    rtc_state.sleep_requested_ms = duration_ms;
+    rtc_state.sleep_started_us = duty_cycle_now_us();
+    rtc_state.armed = true;
+
+    uint32_t permille = duty_cycle_awake_permille();
+    ESP_LOGI(TAG, "Deep sleep por %lu ms (acordado %lu.%lu%% do tempo)",
+             (unsigned long)duration_ms, (unsigned long)(permille / 10), (unsigned long)(permille % 10));
+
+    // Configuração ainda no debounce vai para a NVS antes de dormir
+    config_store_flush();
+
+    // Sem WiFi iniciado (despertar de amostragem) retorna erro e segue
+    esp_wifi_stop();
+    esp_sleep_enable_timer_wakeup((uint64_t)duration_ms * 1000);
+    esp_deep_sleep_start();
+}
+
+uint32_t duty_cycle_awake_permille(void)
+{
+    uint64_t total_ms = rtc_state.stats.awake_ms + rtc_state.stats.asleep_ms;
+    return total_ms > 0 ? (uint32_t)(rtc_state.stats.awake_ms * 1000 / total_ms) : 0;
+}
+
+duty_cycle_stats_t duty_cycle_get_stats(void)
+{
+    return rtc_state.stats;
+}
@@ -0,0 +1,101 @@
+#ifndef DUTY_CYCLE_H
+#define DUTY_CYCLE_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Ciclo com deep sleep (POWER_MODE_DEEP_SLEEP)
+ *
+ * Acorda, amostra, envia em lote e volta ao deep sleep. A maior parte dos
+ * despertares só amostra e guarda na RTC, sem ligar o WiFi; a cada
+ * DUTY_CYCLE_UPLOAD_EVERY despertares (multiplicado pelo upload_scale do
+ * power_budget; ou com o lote cheio) a janela é completa:
+ * conecta, publica as leituras atuais e o lote em TOPIC_BATCH.
+ * Com o ULP vigiando o solo (soil_watch.h) só há despertares de envio e os
+ * do ULP quando o solo seca.
+ *
+ * Contadores, configuração, números de sequência e amostras pendentes ficam
+ * em RTC_DATA_ATTR e sobrevivem ao deep sleep (perdem-se ao desligar).
+ */
+
+#define TOPIC_BATCH "esp32/batch"
+
+#define DUTY_CYCLE_BATCH_MAX 24            // Amostras guardadas na RTC entre envios
+#define DUTY_CYCLE_SAMPLES_PER_MSG 16      // Amostras por mensagem (cabe em MQTT_OUTBOUND_MAX_PAYLOAD)
+#define DUTY_CYCLE_UPLOAD_EVERY 4          // Um despertar com WiFi a cada N
+#define DUTY_CYCLE_CONNECT_TIMEOUT_MS 30000   // Sem sessão MQTT até aqui: guarda a amostra e dorme
+#define DUTY_CYCLE_WINDOW_MAX_MS 90000        // Janela completa nunca passa disso
+#define DUTY_CYCLE_SLEEP_MAX_MS (24UL * 3600 * 1000)   // Teto de um deep sleep (cabe em uint32_t)
+
+/**
+ * Contadores do ciclo (mantidos na RTC)
+ */
+typedef struct {
+    uint32_t wakes;            // Despertares vindos do deep sleep
+    uint32_t sample_wakes;     // Despertares só de amostragem (sem WiFi)
+    uint32_t uploads;          // Lotes confirmados pelo broker
+    uint32_t failed_windows;   // Janelas sem conexão a tempo
+    uint32_t samples_lost;     // Amostras sobrescritas com o lote cheio
+    uint32_t ulp_wakes;        // Despertares pelo ULP (solo cruzou o limiar)
+    uint64_t awake_ms;         // Tempo acordado (inclui ROM e bootloader)
+    uint64_t asleep_ms;        // Tempo em deep sleep
+} duty_cycle_stats_t;
+
+/**
+ * @brief Contabiliza o deep sleep que terminou (chamar no início do app_main)
+ */
+void duty_cycle_init(void);
+
+/**
+ * @brief Indica se o modo de deep sleep está ativo e habilitado
+ */
+bool duty_cycle_is_active(void);
+
+/**
+ * @brief Indica se este despertar é só de amostragem (sem WiFi)
+ */
+bool duty_cycle_is_sample_wake(void);
+
+/**
+ * @brief Lê os sensores, guarda a amostra na RTC e volta ao deep sleep
+ * Retorna apenas se a amostra pedir irrigação (segue o boot completo)
+ * Requer ADC e sensores inicializados
+ */
+void duty_cycle_sample_and_sleep(void);
+
+/**
+ * @brief Limita a janela completa: sem conexão ou além do prazo, volta a dormir
+ */
+void duty_cycle_start_guard(void);
+
+/**
+ * @brief Publica as amostras guardadas em TOPIC_BATCH
+ * @return Número de amostras enfileiradas
+ */
+int duty_cycle_publish_batch(void);
+
+/**
+ * @brief Descarta as amostras publicadas (chamar após a confirmação do broker)
+ */
+void duty_cycle_ack_batch(void);
+
+/**
+ * @brief Entra em deep sleep; o despertar reinicia pelo app_main
+ * Com o ULP vigiando o solo dorme duration_ms x envios por despertar,
+ * limitado a DUTY_CYCLE_SLEEP_MAX_MS
+ */
+void duty_cycle_deep_sleep(uint32_t duration_ms);
+
+/**
+ * @brief Fração do tempo acordado, em décimos de % (0 sem ciclos medidos)
+ */
+uint32_t duty_cycle_awake_permille(void);
+
+/**
+ * @brief Obtém os contadores do ciclo
+ */
+duty_cycle_stats_t duty_cycle_get_stats(void);
+
+#endif // DUTY_CYCLE_H
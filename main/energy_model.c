@@ -0,0 +1,227 @@
+#include "energy_model.h"
+#include "power_manager.h"
+#include "duty_cycle.h"
+#include "mqtt_manager.h"
+#include "json_writer.h"
+#include "sdkconfig.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "ENERGY_MODEL";
+
+static const char *const energy_state_names[ENERGY_STATE_COUNT] = {
+    [ENERGY_CPU_MAX]     = "cpu_max",
+    [ENERGY_CPU_LOW]     = "cpu_low",
+    [ENERGY_LIGHT_SLEEP] = "light_sleep",
+    [ENERGY_DEEP_SLEEP]  = "deep_sleep",
+    [ENERGY_RADIO_TX]    = "tx",
+    [ENERGY_RADIO_RX]    = "rx",
+    [ENERGY_RADIO_IDLE]  = "radio_idle",
+    [ENERGY_VALVE]       = "valve",
+};
+
+static const uint32_t energy_state_ua[ENERGY_STATE_COUNT] = {
+    [ENERGY_CPU_MAX]     = ENERGY_UA_CPU_MAX,
+    [ENERGY_CPU_LOW]     = ENERGY_UA_CPU_LOW,
+    [ENERGY_LIGHT_SLEEP] = ENERGY_UA_LIGHT_SLEEP,
+    [ENERGY_DEEP_SLEEP]  = ENERGY_UA_DEEP_SLEEP,
+    [ENERGY_RADIO_TX]    = ENERGY_UA_RADIO_TX,
+    [ENERGY_RADIO_RX]    = ENERGY_UA_RADIO_RX,
+    [ENERGY_RADIO_IDLE]  = ENERGY_UA_RADIO_IDLE,
+    [ENERGY_VALVE]       = ENERGY_UA_VALVE,
+};
+
+// Totais de boots anteriores (o deep sleep vem do duty_cycle)
+static RTC_DATA_ATTR struct {
+    uint64_t state_ms[ENERGY_STATE_COUNT];
+    uint64_t awake_ms;
+    uint64_t last_publish_ms;   // elapsed_ms da última publicação
+} rtc_totals;
+
+// Este boot
+static portMUX_TYPE energy_mux = portMUX_INITIALIZER_UNLOCKED;
+static int64_t radio_since_us = -1;   // -1: desligado
+static int64_t radio_on_us = 0;
+static int64_t valve_since_us = -1;
+static int64_t valve_on_us = 0;
+static uint64_t tx_air_us = 0;
+static uint64_t rx_air_us = 0;
+
+// Liga/desliga um estado medido por intervalo
+static void energy_model_track(int64_t *since_us, int64_t *total_us, bool on)
+{
+    int64_t now_us = esp_timer_get_time();
+    portENTER_CRITICAL(&energy_mux);
+    if (on && *since_us < 0) {
+        *since_us = now_us;
+    } else if (!on && *since_us >= 0) {
+        *total_us += now_us - *since_us;
+        *since_us = -1;
+    }
+    portEXIT_CRITICAL(&energy_mux);
+}
+
+static int64_t energy_model_tracked_us(int64_t since_us, int64_t total_us, int64_t now_us)
+{
+    return total_us + (since_us >= 0 ? now_us - since_us : 0);
+}
+
+// Tempo no ar de uma rajada: bits na taxa efetiva + custo fixo por quadro
+static uint64_t energy_model_airtime_us(size_t bytes)
+{
+    if (bytes == 0) {
+        return 0;
+    }
+    uint32_t frames = (bytes + ENERGY_FRAME_BYTES - 1) / ENERGY_FRAME_BYTES;
+    return (uint64_t)bytes * 8 * 1000 / ENERGY_PHY_RATE_KBPS + (uint64_t)frames * ENERGY_FRAME_OVERHEAD_US;
+}
+
+void energy_model_radio_on(bool on)
+{
+    energy_model_track(&radio_since_us, &radio_on_us, on);
+}
+
+void energy_model_valve_on(bool on)
+{
+    energy_model_track(&valve_since_us, &valve_on_us, on);
+}
+
+void energy_model_add_traffic(size_t tx_bytes, size_t rx_bytes)
+{
+    uint64_t tx_us = energy_model_airtime_us(tx_bytes);
+    uint64_t rx_us = energy_model_airtime_us(rx_bytes);
+    portENTER_CRITICAL(&energy_mux);
+    tx_air_us += tx_us;
+    rx_air_us += rx_us;
+    portEXIT_CRITICAL(&energy_mux);
+}
+
+// Tempo das tasks IDLE: com tickless idle a CPU dorme (ou espera em 80 MHz) aqui.
+// O chip só dorme com os dois núcleos ociosos: usa o menor dos dois
+static uint64_t energy_model_idle_ms(void)
+{
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    uint64_t idle_us = UINT64_MAX;
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        uint64_t core_us = ulTaskGetRunTimeCounter(xTaskGetIdleTaskHandleForCore(core));
+        if (core_us < idle_us) {
+            idle_us = core_us;
+        }
+    }
+    return idle_us / 1000;
+#else
+    return 0;
+#endif
+}
+
+// Tempos deste boot por estado (sem deep sleep)
+static void energy_model_boot_ms(uint64_t state_ms[ENERGY_STATE_COUNT])
+{
+    int64_t now_us = esp_timer_get_time();
+    uint64_t uptime_ms = now_us / 1000;
+
+    uint64_t max_ms = (power_manager_get_lock_stats(POWER_LOCK_DHT11).held_us +
+                       power_manager_get_lock_stats(POWER_LOCK_TLS).held_us) / 1000;
+    if (max_ms > uptime_ms) {
+        max_ms = uptime_ms;
+    }
+    uint64_t idle_ms = energy_model_idle_ms();
+    if (idle_ms > uptime_ms - max_ms) {
+        idle_ms = uptime_ms - max_ms;
+    }
+
+    portENTER_CRITICAL(&energy_mux);
+    uint64_t radio_ms = energy_model_tracked_us(radio_since_us, radio_on_us, now_us) / 1000;
+    uint64_t valve_ms = energy_model_tracked_us(valve_since_us, valve_on_us, now_us) / 1000;
+    uint64_t tx_ms = tx_air_us / 1000;
+    uint64_t rx_ms = rx_air_us / 1000;
+    portEXIT_CRITICAL(&energy_mux);
+
+    state_ms[ENERGY_CPU_MAX] = max_ms;
+    state_ms[ENERGY_LIGHT_SLEEP] = idle_ms;
+    state_ms[ENERGY_CPU_LOW] = uptime_ms - max_ms - idle_ms;
+    state_ms[ENERGY_DEEP_SLEEP] = 0;
+    state_ms[ENERGY_RADIO_TX] = tx_ms;
+    state_ms[ENERGY_RADIO_RX] = rx_ms;
+    state_ms[ENERGY_RADIO_IDLE] = radio_ms > tx_ms + rx_ms ? radio_ms - tx_ms - rx_ms : 0;
+    state_ms[ENERGY_VALVE] = valve_ms;
+}
+
+void energy_model_fold(void)
+{
+    uint64_t boot_ms[ENERGY_STATE_COUNT];
+    energy_model_boot_ms(boot_ms);
+    for (int i = 0; i < ENERGY_STATE_COUNT; i++) {
+        rtc_totals.state_ms[i] += boot_ms[i];
+    }
+    rtc_totals.awake_ms += esp_timer_get_time() / 1000;
+}
+
+energy_report_t energy_model_get_report(void)
+{
+    energy_report_t report = {0};
+    uint64_t boot_ms[ENERGY_STATE_COUNT];
+    energy_model_boot_ms(boot_ms);
+
+    for (int i = 0; i < ENERGY_STATE_COUNT; i++) {
+        report.state_ms[i] = rtc_totals.state_ms[i] + boot_ms[i];
+    }
+    report.state_ms[ENERGY_DEEP_SLEEP] = duty_cycle_get_stats().asleep_ms;
+    report.elapsed_ms = rtc_totals.awake_ms + esp_timer_get_time() / 1000 +
+                        report.state_ms[ENERGY_DEEP_SLEEP];
+
+    // Carga em uA*ms; média em uA; mAh/dia = uA * 24 h / 1000
+    uint64_t charge = 0;
+    for (int i = 0; i < ENERGY_STATE_COUNT; i++) {
+        charge += report.state_ms[i] * energy_state_ua[i];
+    }
+    if (report.elapsed_ms > 0) {
+        report.avg_ua = (uint32_t)(charge / report.elapsed_ms);
+        report.mah_per_day_x100 = report.avg_ua * 24 / 10;
+    }
+    return report;
+}
+
+esp_err_t energy_model_publish(void)
+{
+    energy_report_t report = energy_model_get_report();
+    char message[MQTT_OUTBOUND_MAX_PAYLOAD];
+
+    json_writer_t w;
+    json_writer_init(&w, message, sizeof(message));
+    json_writer_begin_object(&w, NULL);
+    mqtt_manager_add_device_id(&w);
+    json_writer_add_int(&w, "elapsed_s", report.elapsed_ms / 1000);
+    json_writer_begin_object(&w, "ms");
+    for (int i = 0; i < ENERGY_STATE_COUNT; i++) {
+        json_writer_add_int(&w, energy_state_names[i], report.state_ms[i]);
+    }
+    json_writer_end_object(&w);
+    json_writer_add_int(&w, "avg_ua", report.avg_ua);
+    json_writer_add_fixed(&w, "mah_day", report.mah_per_day_x100, 2);
+    json_writer_add_fixed(&w, "awake_pct", duty_cycle_awake_permille(), 1);
+    json_writer_add_string(&w, "mode", power_manager_mode_name(power_manager_get_config().mode));
+    json_writer_add_int(&w, "seq", mqtt_manager_next_seq(TOPIC_POWER));
+    json_writer_end_object(&w);
+    size_t len = json_writer_finish(&w);
+
+    if (len == 0) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    rtc_totals.last_publish_ms = report.elapsed_ms;
+    ESP_LOGI(TAG, "Média %lu uA, %lu.%02lu mAh/dia", (unsigned long)report.avg_ua,
+             (unsigned long)(report.mah_per_day_x100 / 100), (unsigned long)(report.mah_per_day_x100 % 100));
+    return mqtt_manager_publish(TOPIC_POWER, message, len);
+}
+
+void energy_model_publish_if_due(void)
+{
+    uint64_t elapsed_ms = rtc_totals.awake_ms + esp_timer_get_time() / 1000 +
+                          duty_cycle_get_stats().asleep_ms;
+    if (elapsed_ms - rtc_totals.last_publish_ms >= ENERGY_PUBLISH_PERIOD_MS) {
+        energy_model_publish();
+    }
+}
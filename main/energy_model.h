@@ -0,0 +1,103 @@
+#ifndef ENERGY_MODEL_H
+#define ENERGY_MODEL_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Contabilidade de energia por estado
+ *
+ * Mede o tempo em cada estado, multiplica pela corrente típica de cada um
+ * e estima a carga consumida por dia. CPU e rádio são somados (as correntes do
+ * rádio são o acréscimo sobre a CPU); a válvula é contada à parte.
+ *
+ * CPU: frequência máxima = locks de CPU_FREQ_MAX do power_manager;
+ *      sleep = tempo das tasks IDLE (tickless idle: light sleep ou espera em 80 MHz);
+ *      o resto = ativa em frequência baixa.
+ * Rádio: TX/RX estimados pelos bytes do transporte TLS; idle = ligado e associado.
+ * Deep sleep: contabilizado pelo duty_cycle.
+ *
+ * Os totais sobrevivem ao deep sleep (RTC).
+ */
+
+#define TOPIC_POWER "esp32/power"
+
+// Correntes típicas (uA) - ajuste para a placa e a válvula instaladas
+#define ENERGY_UA_CPU_MAX      50000   // 240 MHz, rádio desligado
+#define ENERGY_UA_CPU_LOW      20000   // 80 MHz, rádio desligado
+#define ENERGY_UA_LIGHT_SLEEP    800
+#define ENERGY_UA_DEEP_SLEEP      10   // Timer da RTC
+#define ENERGY_UA_RADIO_TX    160000   // Acréscimo durante transmissão
+#define ENERGY_UA_RADIO_RX     75000   // Acréscimo durante recepção
+#define ENERGY_UA_RADIO_IDLE    3000   // Acréscimo médio associado em modem sleep (DTIM)
+#define ENERGY_UA_VALVE        70000   // Bobina do relé da solenoide
+
+// Tempo no ar: taxa efetiva e custo fixo por quadro (preâmbulo, ACK, contenção)
+#define ENERGY_PHY_RATE_KBPS       11000
+#define ENERGY_FRAME_OVERHEAD_US   300
+#define ENERGY_FRAME_BYTES         1460
+
+// Tráfego de um handshake TLS (não passa pelo read/write do transporte)
+#define ENERGY_TLS_FULL_TX_BYTES     1800
+#define ENERGY_TLS_FULL_RX_BYTES     5200
+#define ENERGY_TLS_RESUMED_TX_BYTES   600
+#define ENERGY_TLS_RESUMED_RX_BYTES   400
+
+// Publicação periódica em TOPIC_POWER (além do comando power_stats)
+#define ENERGY_PUBLISH_PERIOD_MS 3600000
+
+/**
+ * Estados contabilizados
+ */
+typedef enum {
+    ENERGY_CPU_MAX,
+    ENERGY_CPU_LOW,
+    ENERGY_LIGHT_SLEEP,
+    ENERGY_DEEP_SLEEP,
+    ENERGY_RADIO_TX,
+    ENERGY_RADIO_RX,
+    ENERGY_RADIO_IDLE,
+    ENERGY_VALVE,
+    ENERGY_STATE_COUNT
+} energy_state_t;
+
+/**
+ * Resultado do modelo desde que o dispositivo ligou
+ */
+typedef struct {
+    uint64_t elapsed_ms;                       // Tempo observado (acordado + deep sleep)
+    uint64_t state_ms[ENERGY_STATE_COUNT];     // Tempo em cada estado
+    uint32_t avg_ua;                           // Corrente média
+    uint32_t mah_per_day_x100;                 // Estimativa diária (centésimos de mAh)
+} energy_report_t;
+
+/**
+ * Eventos informados pelos módulos
+ */
+void energy_model_radio_on(bool on);
+void energy_model_valve_on(bool on);
+void energy_model_add_traffic(size_t tx_bytes, size_t rx_bytes);
+
+/**
+ * @brief Guarda os tempos deste boot na RTC (antes do deep sleep)
+ */
+void energy_model_fold(void);
+
+/**
+ * @brief Calcula tempos por estado e a estimativa de consumo
+ */
+energy_report_t energy_model_get_report(void);
+
+/**
+ * @brief Publica o resultado em TOPIC_POWER
+ */
+esp_err_t energy_model_publish(void);
+
+/**
+ * @brief Publica se passou ENERGY_PUBLISH_PERIOD_MS desde a última publicação
+ */
+void energy_model_publish_if_due(void);
+
+#endif // ENERGY_MODEL_H
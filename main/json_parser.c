@@ -0,0 +1,285 @@
+#include "json_parser.h"
+#include "esp_timer.h"
+#include <string.h>
+
+static json_parser_stats_t parser_stats = {0};
+
+static int json_add_token(json_token_t *tokens, int *count, int max_tokens,
+                          json_token_type_t type, size_t start, size_t end)
+{
+    if (*count >= max_tokens) {
+        return JSON_ERR_NOMEM;
+    }
+
+    json_token_t *tok = &tokens[*count];
+    tok->type = type;
+    tok->start = (uint16_t)start;
+    tok->end = (uint16_t)end;
+    tok->size = 0;
+
+    return (*count)++;
+}
+
+int json_parse(const char *js, size_t len, json_token_t *tokens, int max_tokens)
+{
+    int64_t start_us = esp_timer_get_time();
+    int stack[JSON_MAX_DEPTH];
+    int depth = 0;
+    int count = 0;
+    int result = 0;
+
+    if (len > UINT16_MAX) {
+        return JSON_ERR_NOMEM;
+    }
+
+    for (size_t pos = 0; pos < len && result >= 0; pos++) {
+        char c = js[pos];
+        int idx;
+
+        switch (c) {
+        case '{':
+        case '[':
+            if (depth >= JSON_MAX_DEPTH) {
+                result = JSON_ERR_NOMEM;
+                break;
+            }
+            idx = json_add_token(tokens, &count, max_tokens,
+                                 c == '{' ? JSON_TOKEN_OBJECT : JSON_TOKEN_ARRAY, pos, 0);
+            if (idx < 0) {
+                result = idx;
+                break;
+            }
+            if (depth > 0) {
+                tokens[stack[depth - 1]].size++;
+            }
+            stack[depth++] = idx;
+            break;
+
+        case '}':
+        case ']':
+            if (depth == 0 ||
+                tokens[stack[depth - 1]].type != (c == '}' ? JSON_TOKEN_OBJECT : JSON_TOKEN_ARRAY)) {
+                result = JSON_ERR_INVAL;
+                break;
+            }
+            tokens[stack[--depth]].end = (uint16_t)(pos + 1);
+            break;
+
+        case '"': {
+            size_t str_start = pos + 1;
+            size_t i = str_start;
+            while (i < len && js[i] != '"') {
+                // Pula o caractere escapado (\" não fecha a string)
+                i += (js[i] == '\\') ? 2 : 1;
+            }
+            if (i >= len) {
+                result = JSON_ERR_PART;
+                break;
+            }
+            idx = json_add_token(tokens, &count, max_tokens, JSON_TOKEN_STRING, str_start, i);
+            if (idx < 0) {
+                result = idx;
+                break;
+            }
+            if (depth > 0) {
+                tokens[stack[depth - 1]].size++;
+            }
+            pos = i;
+            break;
+        }
+
+        case ' ':
+        case '\t':
+        case '\r':
+        case '\n':
+        case ':':
+        case ',':
+            break;
+
+        default: {
+            // Primitivo: número, true, false ou null
+            if (!(c == '-' || (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z'))) {
+                result = JSON_ERR_INVAL;
+                break;
+            }
+            size_t i = pos;
+            while (i < len && js[i] != ',' && js[i] != '}' && js[i] != ']' &&
+                   js[i] != ':' && js[i] != ' ' && js[i] != '\t' &&
+                   js[i] != '\r' && js[i] != '\n') {
+                i++;
+            }
+            idx = json_add_token(tokens, &count, max_tokens, JSON_TOKEN_PRIMITIVE, pos, i);
+            if (idx < 0) {
+                result = idx;
+                break;
+            }
+            if (depth > 0) {
+                tokens[stack[depth - 1]].size++;
+            }
+            pos = i - 1;
+            break;
+        }
+        }
+    }
+
+    if (result >= 0) {
+        result = (depth != 0) ? JSON_ERR_PART : count;
+    }
+
+    int64_t elapsed_us = esp_timer_get_time() - start_us;
+    parser_stats.count++;
+    parser_stats.bytes += len;
+    parser_stats.total_us += elapsed_us;
+    if (elapsed_us > parser_stats.max_us) {
+        parser_stats.max_us = elapsed_us;
+    }
+
+    return result;
+}
+
+int json_next(const json_token_t *tokens, int count, int i)
+{
+    uint16_t end = tokens[i].end;
+    int j = i + 1;
+
+    // Filhos começam antes do fim do token pai
+    while (j < count && tokens[j].start < end) {
+        j++;
+    }
+    return j;
+}
+
+int json_object_find(const char *js, const json_token_t *tokens, int count, int obj, const char *key)
+{
+    if (obj < 0 || obj >= count || tokens[obj].type != JSON_TOKEN_OBJECT) {
+        return -1;
+    }
+
+    int i = obj + 1;
+    for (int pair = 0; pair < tokens[obj].size / 2 && i + 1 < count; pair++) {
+        if (tokens[i].type == JSON_TOKEN_STRING && json_token_equals(js, &tokens[i], key)) {
+            return i + 1;
+        }
+        i = json_next(tokens, count, i + 1);
+    }
+    return -1;
+}
+
+bool json_token_equals(const char *js, const json_token_t *tok, const char *str)
+{
+    size_t len = tok->end - tok->start;
+    return strlen(str) == len && memcmp(js + tok->start, str, len) == 0;
+}
+
+bool json_token_to_int(const char *js, const json_token_t *tok, int *out)
+{
+    if (tok->type != JSON_TOKEN_PRIMITIVE || tok->end == tok->start) {
+        return false;
+    }
+
+    size_t i = tok->start;
+    bool negative = false;
+    if (js[i] == '-') {
+        negative = true;
+        i++;
+    }
+    if (i >= tok->end) {
+        return false;
+    }
+
+    long value = 0;
+    for (; i < tok->end; i++) {
+        if (js[i] < '0' || js[i] > '9') {
+            return false;
+        }
+        value = value * 10 + (js[i] - '0');
+        if (value > 1000000) {
+            return false;
+        }
+    }
+
+    *out = (int)(negative ? -value : value);
+    return true;
+}
+
+bool json_token_to_bool(const char *js, const json_token_t *tok, bool *out)
+{
+    if (tok->type == JSON_TOKEN_PRIMITIVE) {
+        if (json_token_equals(js, tok, "true") || json_token_equals(js, tok, "1")) {
+            *out = true;
+            return true;
+        }
+        if (json_token_equals(js, tok, "false") || json_token_equals(js, tok, "0")) {
+            *out = false;
+            return true;
+        }
+    } else if (tok->type == JSON_TOKEN_STRING) {
+        if (json_token_equals(js, tok, "true") || json_token_equals(js, tok, "on") ||
+            json_token_equals(js, tok, "ligado")) {
+            *out = true;
+            return true;
+        }
+        if (json_token_equals(js, tok, "false") || json_token_equals(js, tok, "off") ||
+            json_token_equals(js, tok, "desligado")) {
+            *out = false;
+            return true;
+        }
+    }
+    return false;
+}
+
+// FNV-1a com semente, dobrado para melhorar os bits baixos
+static uint32_t json_hash(const char *s, size_t len, uint32_t seed)
+{
+    uint32_t h = 2166136261u ^ seed;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (uint8_t)s[i];
+        h *= 16777619u;
+    }
+    return h ^ (h >> 16);
+}
+
+static const char *json_phash_key(const json_phash_t *ph, int index)
+{
+    const char *entry = (const char *)ph->entries + (size_t)index * ph->stride;
+    return *(const char *const *)entry;
+}
+
+bool json_phash_init(json_phash_t *ph, const void *entries, size_t count, size_t stride, uint32_t seed)
+{
+    ph->entries = entries;
+    ph->stride = stride;
+    ph->seed = seed;
+    memset(ph->slots, -1, sizeof(ph->slots));
+
+    if (count > JSON_PHASH_SLOTS) {
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const char *key = json_phash_key(ph, (int)i);
+        uint32_t slot = json_hash(key, strlen(key), seed) & (JSON_PHASH_SLOTS - 1);
+        if (ph->slots[slot] >= 0) {
+            return false;
+        }
+        ph->slots[slot] = (int8_t)i;
+    }
+    return true;
+}
+
+int json_phash_lookup(const json_phash_t *ph, const char *js, const json_token_t *tok)
+{
+    uint32_t slot = json_hash(js + tok->start, tok->end - tok->start, ph->seed) & (JSON_PHASH_SLOTS - 1);
+    int index = ph->slots[slot];
+
+    // Uma única comparação confirma a chave (hash perfeito: sem sondagem)
+    if (index >= 0 && json_token_equals(js, tok, json_phash_key(ph, index))) {
+        return index;
+    }
+    return -1;
+}
+
+json_parser_stats_t json_parser_get_stats(void)
+{
+    return parser_stats;
+}
@@ -0,0 +1,110 @@
+#ifndef JSON_PARSER_H
+#define JSON_PARSER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Limites do tokenizador (sem alocação dinâmica)
+#define JSON_MAX_TOKENS 32   // Tokens por documento (objeto + pares chave/valor)
+#define JSON_MAX_DEPTH 6     // Aninhamento máximo (metadata do shadow usa 5 níveis)
+#define JSON_PHASH_SLOTS 16  // Slots da tabela hash perfeita (potência de 2)
+
+// Códigos de erro retornados por json_parse
+#define JSON_ERR_NOMEM -1    // Mais tokens que JSON_MAX_TOKENS
+#define JSON_ERR_INVAL -2    // Caractere inesperado ou fechamento inválido
+#define JSON_ERR_PART -3     // Documento incompleto
+
+typedef enum {
+    JSON_TOKEN_OBJECT,
+    JSON_TOKEN_ARRAY,
+    JSON_TOKEN_STRING,     // start/end sem as aspas
+    JSON_TOKEN_PRIMITIVE   // número, true, false, null
+} json_token_type_t;
+
+typedef struct {
+    json_token_type_t type;
+    uint16_t start;        // Offset do primeiro caractere
+    uint16_t end;          // Offset após o último caractere
+    uint16_t size;         // Filhos diretos (chaves + valores em objetos)
+} json_token_t;
+
+// Estatísticas de custo do parser (medidas em firmware)
+typedef struct {
+    uint32_t count;        // Documentos processados
+    uint32_t bytes;        // Total de bytes processados
+    int64_t total_us;      // Tempo total de parse
+    int64_t max_us;        // Maior tempo de parse
+} json_parser_stats_t;
+
+/**
+ * @brief Tabela hash perfeita para resolver chaves conhecidas em O(1)
+ *
+ * Cada entrada da tabela de origem deve começar com um campo `const char *key`.
+ * A semente é escolhida offline para que as chaves não colidam em JSON_PHASH_SLOTS.
+ */
+typedef struct {
+    const void *entries;   // Tabela de origem
+    size_t stride;         // sizeof(entrada)
+    uint32_t seed;         // Semente do hash
+    int8_t slots[JSON_PHASH_SLOTS];  // Índice da entrada em cada slot (-1 = vazio)
+} json_phash_t;
+
+/**
+ * @brief Tokeniza um documento JSON em uma única passada
+ * @param js Texto JSON (não precisa terminar em '\0')
+ * @param len Tamanho do texto
+ * @param tokens Array de saída
+ * @param max_tokens Capacidade do array
+ * @return Número de tokens ou JSON_ERR_* em caso de erro
+ */
+int json_parse(const char *js, size_t len, json_token_t *tokens, int max_tokens);
+
+/**
+ * @brief Índice do próximo irmão do token i (pula filhos aninhados)
+ */
+int json_next(const json_token_t *tokens, int count, int i);
+
+/**
+ * @brief Procura uma chave entre os filhos diretos do objeto obj
+ * @return Índice do token de valor ou -1 se não encontrada
+ */
+int json_object_find(const char *js, const json_token_t *tokens, int count, int obj, const char *key);
+
+/**
+ * @brief Compara o conteúdo de um token com uma string C
+ */
+bool json_token_equals(const char *js, const json_token_t *tok, const char *str);
+
+/**
+ * @brief Converte um token primitivo inteiro (ex: -12, 30)
+ * @return true se o token é um inteiro válido
+ */
+bool json_token_to_int(const char *js, const json_token_t *tok, int *out);
+
+/**
+ * @brief Converte um token booleano
+ *
+ * Aceita true/false, 1/0 e as strings "true"/"false", "on"/"off", "ligado"/"desligado".
+ * @return true se o token representa um booleano
+ */
+bool json_token_to_bool(const char *js, const json_token_t *tok, bool *out);
+
+/**
+ * @brief Inicializa uma tabela hash perfeita
+ * @return false se duas chaves colidirem (semente precisa ser trocada)
+ */
+bool json_phash_init(json_phash_t *ph, const void *entries, size_t count, size_t stride, uint32_t seed);
+
+/**
+ * @brief Resolve o texto de um token para uma entrada da tabela
+ * @return Índice da entrada ou -1 se a chave não é conhecida
+ */
+int json_phash_lookup(const json_phash_t *ph, const char *js, const json_token_t *tok);
+
+/**
+ * @brief Obtém estatísticas de custo do parser
+ */
+json_parser_stats_t json_parser_get_stats(void);
+
+#endif // JSON_PARSER_H
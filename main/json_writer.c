@@ -0,0 +1,184 @@
+#include "json_writer.h"
+#include <string.h>
+
+static void json_writer_putc(json_writer_t *w, char c)
+{
+    // Reserva sempre um byte para o '\0'
+    if (w->overflow || w->len + 1 >= w->size) {
+        w->overflow = true;
+        return;
+    }
+    w->buf[w->len++] = c;
+}
+
+static void json_writer_puts(json_writer_t *w, const char *s, size_t n)
+{
+    if (w->overflow || w->len + n >= w->size) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->buf + w->len, s, n);
+    w->len += n;
+}
+
+// String entre aspas: aspas, barra e caracteres de controle (< 0x20) escapados
+static void json_writer_put_escaped(json_writer_t *w, const char *s)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    json_writer_putc(w, '"');
+    for (; *s != '\0'; s++) {
+        unsigned char c = (unsigned char)*s;
+        char short_escape = 0;
+
+        switch (c) {
+        case '"':  short_escape = '"';  break;
+        case '\\': short_escape = '\\'; break;
+        case '\n': short_escape = 'n';  break;
+        case '\r': short_escape = 'r';  break;
+        case '\t': short_escape = 't';  break;
+        case '\b': short_escape = 'b';  break;
+        case '\f': short_escape = 'f';  break;
+        default:   break;
+        }
+
+        if (short_escape != 0) {
+            json_writer_putc(w, '\\');
+            json_writer_putc(w, short_escape);
+        } else if (c < 0x20) {
+            char u[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0x0f]};
+            json_writer_puts(w, u, sizeof(u));
+        } else {
+            json_writer_putc(w, (char)c);
+        }
+    }
+    json_writer_putc(w, '"');
+}
+
+// Vírgula (se necessário) e "key": antes de cada valor
+static void json_writer_prefix(json_writer_t *w, const char *key)
+{
+    if (w->need_comma) {
+        json_writer_putc(w, ',');
+    }
+    if (key != NULL) {
+        json_writer_put_escaped(w, key);
+        json_writer_putc(w, ':');
+    }
+    w->need_comma = true;
+}
+
+// Inteiro sem sinal em decimal, com zeros à esquerda até min_digits
+static void json_writer_put_uint(json_writer_t *w, uint64_t value, int min_digits)
+{
+    char digits[20];
+    int n = 0;
+
+    do {
+        digits[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0 && n < (int)sizeof(digits));
+
+    while (n < min_digits && n < (int)sizeof(digits)) {
+        digits[n++] = '0';
+    }
+    while (n > 0) {
+        json_writer_putc(w, digits[--n]);
+    }
+}
+
+void json_writer_init(json_writer_t *w, char *buf, size_t size)
+{
+    w->buf = buf;
+    w->size = size;
+    w->len = 0;
+    w->need_comma = false;
+    w->overflow = (buf == NULL || size == 0);
+}
+
+void json_writer_begin_object(json_writer_t *w, const char *key)
+{
+    json_writer_prefix(w, key);
+    json_writer_putc(w, '{');
+    w->need_comma = false;
+}
+
+void json_writer_end_object(json_writer_t *w)
+{
+    json_writer_putc(w, '}');
+    w->need_comma = true;
+}
+
+void json_writer_begin_array(json_writer_t *w, const char *key)
+{
+    json_writer_prefix(w, key);
+    json_writer_putc(w, '[');
+    w->need_comma = false;
+}
+
+void json_writer_end_array(json_writer_t *w)
+{
+    json_writer_putc(w, ']');
+    w->need_comma = true;
+}
+
+void json_writer_add_int(json_writer_t *w, const char *key, int64_t value)
+{
+    json_writer_prefix(w, key);
+    if (value < 0) {
+        json_writer_putc(w, '-');
+        json_writer_put_uint(w, (uint64_t)(-(value + 1)) + 1, 1);
+    } else {
+        json_writer_put_uint(w, (uint64_t)value, 1);
+    }
+}
+
+void json_writer_add_fixed(json_writer_t *w, const char *key, int64_t value, uint8_t decimals)
+{
+    static const uint32_t pow10[] = {
+        1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+    };
+
+    if (decimals == 0 || decimals > 9) {
+        json_writer_add_int(w, key, value);
+        return;
+    }
+
+    json_writer_prefix(w, key);
+
+    uint64_t magnitude = value < 0 ? (uint64_t)(-(value + 1)) + 1 : (uint64_t)value;
+    if (value < 0) {
+        json_writer_putc(w, '-');
+    }
+    json_writer_put_uint(w, magnitude / pow10[decimals], 1);
+    json_writer_putc(w, '.');
+    json_writer_put_uint(w, magnitude % pow10[decimals], decimals);
+}
+
+void json_writer_add_bool(json_writer_t *w, const char *key, bool value)
+{
+    json_writer_prefix(w, key);
+    if (value) {
+        json_writer_puts(w, "true", 4);
+    } else {
+        json_writer_puts(w, "false", 5);
+    }
+}
+
+void json_writer_add_string(json_writer_t *w, const char *key, const char *value)
+{
+    json_writer_prefix(w, key);
+    json_writer_put_escaped(w, value != NULL ? value : "");
+}
+
+size_t json_writer_finish(json_writer_t *w)
+{
+    if (w->overflow) {
+        if (w->size > 0 && w->buf != NULL) {
+            w->buf[0] = '\0';
+        }
+        return 0;
+    }
+    w->buf[w->len] = '\0';
+    return w->len;
+}
@@ -0,0 +1,68 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Escritor de JSON com verificação de limites
+ *
+ * Escreve direto no buffer fornecido, sem printf e sem ponto flutuante.
+ * Ao estourar o buffer, as escritas seguintes são ignoradas e
+ * json_writer_finish retorna 0.
+ */
+typedef struct {
+    char *buf;         // Buffer de destino
+    size_t size;       // Capacidade do buffer (inclui o '\0')
+    size_t len;        // Bytes escritos
+    bool need_comma;   // Próximo elemento precisa de vírgula
+    bool overflow;     // Buffer insuficiente
+} json_writer_t;
+
+/**
+ * @brief Inicializa o escritor sobre um buffer
+ */
+void json_writer_init(json_writer_t *w, char *buf, size_t size);
+
+/**
+ * @brief Abre um objeto (key NULL na raiz ou dentro de arrays)
+ */
+void json_writer_begin_object(json_writer_t *w, const char *key);
+void json_writer_end_object(json_writer_t *w);
+
+/**
+ * @brief Abre um array (key NULL na raiz ou dentro de arrays)
+ */
+void json_writer_begin_array(json_writer_t *w, const char *key);
+void json_writer_end_array(json_writer_t *w);
+
+/**
+ * @brief Adiciona um inteiro
+ */
+void json_writer_add_int(json_writer_t *w, const char *key, int64_t value);
+
+/**
+ * @brief Adiciona um número em ponto fixo
+ * @param value Valor escalado por 10^decimals (ex: 330 com 2 casas = 3.30)
+ * @param decimals Casas decimais (0-9)
+ */
+void json_writer_add_fixed(json_writer_t *w, const char *key, int64_t value, uint8_t decimals);
+
+/**
+ * @brief Adiciona um booleano
+ */
+void json_writer_add_bool(json_writer_t *w, const char *key, bool value);
+
+/**
+ * @brief Adiciona uma string (aspas, barras e caracteres de controle são escapados)
+ */
+void json_writer_add_string(json_writer_t *w, const char *key, const char *value);
+
+/**
+ * @brief Termina o documento com '\0'
+ * @return Tamanho do JSON (sem o '\0') ou 0 se o buffer estourou
+ */
+size_t json_writer_finish(json_writer_t *w);
+
+#endif // JSON_WRITER_H
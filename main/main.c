@@ -13,6 +13,7 @@
 
 #include "wifi_manager.h"
 #include "mqtt_manager.h"
+#include "connectivity_manager.h"
 #include "esp_adc/adc_oneshot.h"
 #include "day_night_control.h"
 
@@ -25,6 +26,12 @@
 #include "ntp_sync.h"
 #include "system_commands.h"
 #include "power_manager.h"
+#include "shadow_sync.h"
+#include "duty_cycle.h"
+#include "power_budget.h"
+#include "boot_timeline.h"
+#include "config_store.h"
+#include "timestamp.h"
 
 
 // #define WIFI_SSID "UFC_QUIXADA"
@@ -35,6 +42,12 @@
 #define WIFI_SSID "brisa-2504280"
 #define WIFI_PASS "eubcidpn"
 
+// IP estático (opcional): sem DHCP a cada despertar; sem MQTT com ele volta ao DHCP
+// #define WIFI_STATIC_IP "192.168.0.50"
+// #define WIFI_STATIC_NETMASK "255.255.255.0"
+// #define WIFI_STATIC_GATEWAY "192.168.0.1"
+// #define WIFI_STATIC_DNS "192.168.0.1"
+
 #define AWS_IOT_ENDPOINT "a1gqpq2oiyi1r1-ats.iot.sa-east-1.amazonaws.com"
 #define AWS_IOT_CLIENT_ID "esp32_estufa_inteligente_001"
 
@@ -44,20 +57,33 @@
 // LED externo
 #define EXTERNAL_LED_GPIO GPIO_NUM_4  // GPIO4 (D4) - LED externo
 
+#define LOG_BLINK_MS 25   // LEDs acesos por log
+
 static const char *TAG = "APP_MAIN";
 
+static esp_timer_handle_t log_blink_timer = NULL;
+
+static void log_blink_off(void *arg)
+{
+    gpio_set_level(BUILTIN_LED_GPIO, 0);   // Desliga LED embutido
+    gpio_set_level(EXTERNAL_LED_GPIO, 0);  // Desliga LED externo
+}
+
 // Função de callback customizado para vprintf (intercepta todos os logs)
 static int custom_vprintf(const char *fmt, va_list args)
 {
     // Chama o printf original
     int ret = vprintf(fmt, args);
     
-    // Pisca ambos os LEDs simultaneamente a cada log
+    // Pisca ambos os LEDs a cada log (não com bateria baixa). Sem espera: o timer
+    // apaga, então logar nunca bloqueia quem loga (callback MQTT, timers)
+    if (log_blink_timer == NULL || !power_budget_get_policy()->log_blink) {
+        return ret;
+    }
     gpio_set_level(BUILTIN_LED_GPIO, 1);   // Liga LED embutido
     gpio_set_level(EXTERNAL_LED_GPIO, 1);  // Liga LED externo
-    vTaskDelay(pdMS_TO_TICKS(25));         // Mantém por 25ms
-    gpio_set_level(BUILTIN_LED_GPIO, 0);   // Desliga LED embutido
-    gpio_set_level(EXTERNAL_LED_GPIO, 0);  // Desliga LED externo
+    esp_timer_stop(log_blink_timer);       // Logs seguidos mantêm aceso
+    esp_timer_start_once(log_blink_timer, LOG_BLINK_MS * 1000);
     
     return ret;
 }
@@ -69,7 +95,6 @@ extern const uint8_t device_certificate_pem_crt_start[] asm("_binary_376f19f7d48
 extern const uint8_t device_private_pem_key_start[] asm("_binary_376f19f7d489fd831039a918bc7a9ec29a363566a92e0c10b4fc5b0f69aa345f_private_pem_key_start");
 
 esp_mqtt_client_handle_t client = NULL;
-extern bool mqtt_connected;
 
 void app_main(void)
 {
@@ -84,8 +109,37 @@ void app_main(void)
     gpio_set_level(EXTERNAL_LED_GPIO, 0);  // Inicia apagado
     
     // Registra função customizada para piscar LEDs a cada log
+    const esp_timer_create_args_t blink_args = {
+        .callback = log_blink_off,
+        .name = "log_blink",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&blink_args, &log_blink_timer));
     esp_log_set_vprintf(custom_vprintf);
     
+    // Horário dos payloads (offset em cache, estado na RTC)
+    timestamp_init();
+    
+    // Contabiliza o deep sleep anterior (estado na RTC)
+    duty_cycle_init();
+    
+    adc_oneshot_unit_init_cfg_t adc_init_config = {
+        .unit_id = ADC_UNIT_1,
+    };
+
+    ESP_ERROR_CHECK(adc_oneshot_new_unit(&adc_init_config, &adc1_handle));
+    ESP_LOGI(TAG, "ADC Start");
+    
+    // Bateria antes do despertar de amostragem: o nível decide o intervalo entre envios
+    power_budget_init();
+    
+    // Despertar só de amostragem: lê, guarda na RTC e volta a dormir sem ligar o WiFi
+    if (duty_cycle_is_sample_wake()) {
+        uv_sensor_init();
+        soil_moisture_init();
+        dht11_sensor_init();
+        duty_cycle_sample_and_sleep();   // Só retorna se for preciso irrigar
+    }
+    
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
         ESP_ERROR_CHECK(nvs_flash_erase());
@@ -95,46 +149,41 @@ void app_main(void)
     ESP_ERROR_CHECK(ret);
     ESP_LOGI(TAG, "NVS Flash inicializado");
 
+    // Configurações salvas antes de qualquer task ou do power management
+    config_store_init();
+
+    // Supervisor de reconexão antes dos eventos de WiFi/MQTT
+    connectivity_manager_init();
+
+    // Boot guiado por eventos: WiFi, SNTP e MQTT avançam sozinhos
+    // (IP -> cliente MQTT -> assinaturas) enquanto o resto inicializa
     ESP_LOGI(TAG, "Conectando ao WiFi: %s", WIFI_SSID);
+#ifdef WIFI_STATIC_IP
+    wifi_manager_set_static_ip(WIFI_STATIC_IP, WIFI_STATIC_NETMASK, WIFI_STATIC_GATEWAY, WIFI_STATIC_DNS);
+#endif
     wifi_manager_init(WIFI_SSID, WIFI_PASS, WIFI_AUTH_OPEN);
-    vTaskDelay(pdMS_TO_TICKS(5000));
+    
+    // Power management (DFS + light sleep) antes do MQTT: o handshake TLS já usa os locks
+    power_manager_init();
 
-    // Inicializa e sincroniza o NTP para obter horário real
+    // SNTP sincroniza quando houver IP (CONNECTIVITY_TIME_BIT); o TLS não depende do horário
     ESP_LOGI(TAG, "Inicializando sincronização de horário via NTP...");
     ntp_sync_init();
-    if (ntp_wait_sync(10000)) {
-        ESP_LOGI(TAG, "Horário sincronizado com sucesso!");
-    } else {
-        ESP_LOGW(TAG, "Falha ao sincronizar horário, continuando sem NTP");
-    }
 
-    // Registra handlers MQTT customizados
+    // Registra handlers MQTT customizados (cada um assina os seus tópicos a cada conexão)
     mqtt_manager_set_custom_handler(solenoid_mqtt_handler);
     mqtt_manager_set_custom_handler(system_commands_mqtt_handler);
+    mqtt_manager_set_custom_handler(shadow_sync_mqtt_handler);
     
-    mqtt_manager_start(AWS_IOT_ENDPOINT, AWS_IOT_CLIENT_ID, 
-                       aws_root_ca_pem_start, 
-                       device_certificate_pem_crt_start, 
-                       device_private_pem_key_start, 
-                       &client);
-    vTaskDelay(pdMS_TO_TICKS(3000));
-
-    adc_oneshot_unit_init_cfg_t adc_init_config = {
-        .unit_id = ADC_UNIT_1,
-    };
+    // Tópicos do Device Shadow (configuração sincronizada)
+    shadow_sync_init(AWS_IOT_CLIENT_ID);
 
-    ESP_ERROR_CHECK(adc_oneshot_new_unit(&adc_init_config, &adc1_handle));
-    ESP_LOGI(TAG, "ADC Start");
-    
     // Inicializa controle diurno/noturno
     day_night_control_init();
     
     // Inicializa sistema de comandos
     system_commands_init();
     
-    // Inicializa gerenciamento de energia
-    power_manager_init();
-    
     plant_config_init();
     
     uv_sensor_init();
@@ -142,26 +191,18 @@ void app_main(void)
     dht11_sensor_init();
     solenoid_init();
     
+    boot_timeline_mark(BOOT_STAGE_SENSORS);
     ESP_LOGI(TAG, "Todos os dispositivos inicializados");
+    
+    // Em deep sleep a janela tem prazo: sem conexão a amostra fica na RTC
+    duty_cycle_start_guard();
 
-    if (mqtt_connected && client != NULL) {
-        ESP_LOGI(TAG, "subscribe nos tópicos.");
-        int msg_id1 = esp_mqtt_client_subscribe(client, TOPIC_SOLENOID, 1);
-        int msg_id2 = esp_mqtt_client_subscribe(client, TOPIC_PLANT_CONFIG, 1);
-        int msg_id3 = esp_mqtt_client_subscribe(client, TOPIC_SYSTEM_COMMANDS, 1);
-        
-        ESP_LOGI(TAG, "Subscribed: %s (msg_id=%d)", TOPIC_SOLENOID, msg_id1);
-        ESP_LOGI(TAG, "Subscribed: %s (msg_id=%d)", TOPIC_PLANT_CONFIG, msg_id2);
-        ESP_LOGI(TAG, "Subscribed: %s (msg_id=%d)", TOPIC_SYSTEM_COMMANDS, msg_id3);
-        
-        // Publica configuração atual
-        plant_config_publish(client);
-        
-        // Publica status inicial do sistema
-        system_commands_publish_status(client);
-    } else {
-        ESP_LOGW(TAG, "MQTT não conectado, não foi possível fazer subscribe");
-    }
+    // Handlers e módulos prontos antes do primeiro MQTT_EVENT_CONNECTED
+    mqtt_manager_start(AWS_IOT_ENDPOINT, AWS_IOT_CLIENT_ID, 
+                       aws_root_ca_pem_start, 
+                       device_certificate_pem_crt_start, 
+                       device_private_pem_key_start, 
+                       &client);
 
 
     // DHT11 no Core 1 (isolado do WiFi/MQTT) com maior prioridade
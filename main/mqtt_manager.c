@@ -1,16 +1,425 @@
 #include "mqtt_manager.h"
 #include "plant_config.h"
+#include "system_commands.h"
+#include "dht11_sensor.h"
+#include "uv_sensor.h"
+#include "soil_moisture.h"
+#include "solenoid.h"
+#include "duty_cycle.h"
+#include "sampling_governor.h"
+#include "energy_model.h"
+#include "tls_transport.h"
+#include "connectivity_manager.h"
+#include "boot_timeline.h"
+#include "sdkconfig.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
 #include <string.h>
 
 static const char *TAG = "MQTT_MANAGER";
-bool mqtt_connected = false;
+
+static esp_mqtt_client_handle_t mqtt_client = NULL;
+
+// Configuração mantida para esp_mqtt_set_config (fallback de protocolo)
+static esp_mqtt_client_config_t mqtt_cfg;
+static char mqtt_url[256];
+
+// Política por tópico: telemetria em QoS 0 (perdas detectadas por "seq"),
+// alertas, status e eventos da válvula em QoS 1 na faixa de alta prioridade.
+// Aliases só nos tópicos de telemetria (1..4 cabe no limite do AWS IoT e do Mosquitto).
+// Retidos: último valor de cada sensor, status, válvula e presença ficam no broker
+// e chegam a quem assinar depois, sem acordar o dispositivo
+static const mqtt_topic_policy_t topic_policies[] = {
+    {TOPIC_DHT11,          0, true,  MQTT_PRIORITY_LOW,  2048, MQTT_TELEMETRY_EXPIRY_S, 1},
+    {TOPIC_DHT11_FORCED,   0, false, MQTT_PRIORITY_LOW,  2048, MQTT_TELEMETRY_EXPIRY_S, 2},
+    {TOPIC_UV_SENSOR,      0, true,  MQTT_PRIORITY_LOW,  2048, MQTT_TELEMETRY_EXPIRY_S, 3},
+    {TOPIC_SOIL_MOISTURE,  0, true,  MQTT_PRIORITY_LOW,  2048, MQTT_TELEMETRY_EXPIRY_S, 4},
+    {TOPIC_ALERTS,         1, false, MQTT_PRIORITY_HIGH, MQTT_OUTBOX_LIMIT_BYTES, 0, 0},
+    {TOPIC_VALVE_EVENTS,   1, true,  MQTT_PRIORITY_HIGH, MQTT_OUTBOX_LIMIT_BYTES, 0, 0},
+    {TOPIC_STATUS,         1, true,  MQTT_PRIORITY_HIGH, MQTT_OUTBOX_LIMIT_BYTES, 0, 0},
+    {TOPIC_ACK,            1, false, MQTT_PRIORITY_HIGH, MQTT_OUTBOX_LIMIT_BYTES, 0, 0},
+    {TOPIC_PRESENCE,       1, true,  MQTT_PRIORITY_HIGH, MQTT_OUTBOX_LIMIT_BYTES, 0, 0},
+    {TOPIC_BATCH,          1, false, MQTT_PRIORITY_LOW,  4096, 0, 0},
+    {TOPIC_POWER,          1, true,  MQTT_PRIORITY_LOW,  4096, 0, 0},
+    {TOPIC_BOOT,           1, true,  MQTT_PRIORITY_LOW,  4096, 0, 0},
+};
+
+#define TOPIC_POLICY_COUNT (sizeof(topic_policies) / sizeof(topic_policies[0]))
+
+static const mqtt_topic_policy_t default_policy = {NULL, 1, false, MQTT_PRIORITY_LOW, 4096, 0, 0};
+
+// Keepalive e janelas
+static uint16_t applied_keepalive_s = 0;   // Último valor entregue ao cliente
+static uint16_t session_keepalive_s = 0;   // Valor enviado no CONNECT da sessão atual
+static bool park_between_windows = false;
+static bool parked = false;
+static SemaphoreHandle_t park_mutex = NULL;
+
+#if CONFIG_MQTT_PROTOCOL_5
+// Broker recusou MQTT 5: segue em 3.1.1 (mantido também após deep sleep)
+static RTC_DATA_ATTR bool mqtt5_refused = false;
+static mqtt5_user_property_handle_t publish_user_props = NULL;
+static bool aliases_enabled = true;   // Desligado se o broker aceitar menos aliases
+#endif
+
+// Na RTC: a sequência continua após o deep sleep e o assinante não vê perdas falsas
+static RTC_DATA_ATTR uint32_t topic_seq[TOPIC_POLICY_COUNT] = {0};
+
+// Mensagem na fila de saída (o payload é copiado para a fila)
+typedef struct {
+    const mqtt_topic_policy_t *policy;
+    const char *topic;
+    int64_t queued_us;
+    uint16_t len;
+    char data[MQTT_OUTBOUND_MAX_PAYLOAD];
+} mqtt_outbound_msg_t;
+
+static QueueHandle_t high_lane = NULL;
+static QueueHandle_t low_lane = NULL;
+static TaskHandle_t outbound_task = NULL;
+static SemaphoreHandle_t staging_mutex = NULL;
+static mqtt_outbound_msg_t staging_msg;   // Montagem do item antes de copiar para a fila
+static mqtt_outbound_stats_t outbound_stats = {0};
+
+// Intervalo entre tentativas enquanto o outbox está acima do limite
+#define MQTT_OUTBOUND_RETRY_MS 500
+
+// Publicações QoS 1 aguardando PUBACK
+typedef struct {
+    int msg_id;
+    int64_t sent_us;
+} mqtt_inflight_t;
+
+static mqtt_inflight_t inflight[MQTT_INFLIGHT_MAX];
+static int inflight_count = 0;
+
+// PUBACKs que chegaram antes do msg_id ser registrado (a task MQTT pode
+// processar a resposta antes de esp_mqtt_client_publish retornar)
+#define MQTT_EARLY_ACKS 4
+static int early_acks[MQTT_EARLY_ACKS];
+static int early_ack_next = 0;
+static SemaphoreHandle_t pending_mutex = NULL;
+static EventGroupHandle_t publish_events = NULL;
+#define MQTT_DRAINED_BIT (1 << 0)   // Nenhuma publicação pendente
 
 // Handlers customizados
 #define MAX_CUSTOM_HANDLERS 5
 static mqtt_custom_event_handler_t custom_handlers[MAX_CUSTOM_HANDLERS] = {NULL};
 static int handler_count = 0;
 
+static mqtt_callback_stats_t callback_stats = {0};
+
+static void mqtt_manager_account_callback(int64_t elapsed_us)
+{
+    callback_stats.count++;
+    callback_stats.last_us = elapsed_us;
+    callback_stats.total_us += elapsed_us;
+    if (elapsed_us > callback_stats.max_us) {
+        callback_stats.max_us = elapsed_us;
+    }
+    if (elapsed_us > MQTT_CALLBACK_BUDGET_US) {
+        callback_stats.over_budget++;
+        ESP_LOGD(TAG, "Callback MQTT demorou %lld us (orçamento: %d us)",
+                 (long long)elapsed_us, MQTT_CALLBACK_BUDGET_US);
+    }
+}
+
+// Contabilidade de pendências: +1 ao enfileirar, -1 ao concluir (enviada, descartada ou PUBACK)
+static void mqtt_pending_add(void)
+{
+    xSemaphoreTake(pending_mutex, portMAX_DELAY);
+    outbound_stats.pending++;
+    xEventGroupClearBits(publish_events, MQTT_DRAINED_BIT);
+    xSemaphoreGive(pending_mutex);
+}
+
+static void mqtt_pending_done_locked(void)
+{
+    if (outbound_stats.pending > 0) {
+        outbound_stats.pending--;
+    }
+    if (outbound_stats.pending == 0) {
+        xEventGroupSetBits(publish_events, MQTT_DRAINED_BIT);
+    }
+}
+
+static void mqtt_pending_done(void)
+{
+    xSemaphoreTake(pending_mutex, portMAX_DELAY);
+    mqtt_pending_done_locked();
+    xSemaphoreGive(pending_mutex);
+}
+
+// QoS 1 entregue ao cliente: conclui só quando o msg_id for confirmado
+static void mqtt_inflight_track(int msg_id)
+{
+    xSemaphoreTake(pending_mutex, portMAX_DELAY);
+    for (int i = 0; i < MQTT_EARLY_ACKS; i++) {
+        if (early_acks[i] == msg_id) {
+            early_acks[i] = 0;
+            outbound_stats.ack_last_ms = 0;
+            mqtt_pending_done_locked();
+            xSemaphoreGive(pending_mutex);
+            return;
+        }
+    }
+    if (inflight_count < MQTT_INFLIGHT_MAX) {
+        inflight[inflight_count].msg_id = msg_id;
+        inflight[inflight_count].sent_us = esp_timer_get_time();
+        inflight_count++;
+    } else {
+        outbound_stats.untracked++;
+        mqtt_pending_done_locked();
+    }
+    xSemaphoreGive(pending_mutex);
+}
+
+// PUBACK recebido (acked) ou mensagem expirada no outbox
+static void mqtt_inflight_complete(int msg_id, bool acked)
+{
+    if (pending_mutex == NULL) {
+        return;
+    }
+
+    xSemaphoreTake(pending_mutex, portMAX_DELAY);
+    bool found = false;
+    for (int i = 0; i < inflight_count; i++) {
+        if (inflight[i].msg_id != msg_id) {
+            continue;
+        }
+        if (acked) {
+            uint32_t ack_ms = (uint32_t)((esp_timer_get_time() - inflight[i].sent_us) / 1000);
+            outbound_stats.ack_last_ms = ack_ms;
+            if (ack_ms > outbound_stats.ack_max_ms) {
+                outbound_stats.ack_max_ms = ack_ms;
+            }
+        } else {
+            outbound_stats.expired++;
+        }
+        inflight[i] = inflight[--inflight_count];
+        mqtt_pending_done_locked();
+        found = true;
+        break;
+    }
+    if (!found && acked && msg_id > 0) {
+        early_acks[early_ack_next] = msg_id;
+        early_ack_next = (early_ack_next + 1) % MQTT_EARLY_ACKS;
+    }
+    xSemaphoreGive(pending_mutex);
+}
+
+bool mqtt_manager_is_v5(void)
+{
+#if CONFIG_MQTT_PROTOCOL_5
+    return !mqtt5_refused;
+#else
+    return false;
+#endif
+}
+
+void mqtt_manager_add_device_id(json_writer_t *w)
+{
+    if (!mqtt_manager_is_v5()) {
+        json_writer_add_string(w, "device_id", MQTT_DEVICE_ID);
+    }
+}
+
+// Reaplica mqtt_cfg no cliente (o próximo CONNECT usa os novos valores)
+static void mqtt_manager_apply_config(void)
+{
+    applied_keepalive_s = (uint16_t)mqtt_cfg.session.keepalive;
+    esp_mqtt_set_config(mqtt_client, &mqtt_cfg);
+}
+
+#if CONFIG_MQTT_PROTOCOL_5
+// Broker só fala 3.1.1: reconfigura o cliente, a próxima tentativa do supervisor já usa 3.1.1
+static void mqtt_manager_fallback_v311(void)
+{
+    ESP_LOGW(TAG, "Broker recusou MQTT 5, usando MQTT 3.1.1");
+    mqtt5_refused = true;
+    mqtt_cfg.session.protocol_ver = MQTT_PROTOCOL_V_3_1_1;
+    mqtt_manager_apply_config();
+}
+
+// Propriedades da próxima publicação (o outbound é o único publicador)
+static void mqtt_manager_set_publish_property(const mqtt_topic_policy_t *policy, uint32_t age_s)
+{
+    esp_mqtt5_publish_property_config_t property = {
+        .payload_format_indicator = true,   // UTF-8 (JSON)
+        // Retido é o "último valor": não expira no broker, só na fila local
+        .message_expiry_interval = policy->expiry_s != 0 && !policy->retain ?
+                                   policy->expiry_s - age_s : 0,
+        .topic_alias = aliases_enabled ? policy->alias : 0,
+        .content_type = "application/json",
+        .user_property = publish_user_props,
+    };
+
+    if (esp_mqtt5_client_set_publish_property(mqtt_client, &property) != ESP_OK &&
+        property.topic_alias != 0) {
+        // Broker anunciou menos aliases no CONNACK: segue com o tópico completo
+        ESP_LOGW(TAG, "Topic alias %u recusado, desativando aliases", property.topic_alias);
+        aliases_enabled = false;
+        property.topic_alias = 0;
+        esp_mqtt5_client_set_publish_property(mqtt_client, &property);
+    }
+}
+#endif
+
+// "online" retido substitui o Last Will deixado pela sessão anterior
+static void mqtt_manager_publish_online(void)
+{
+    char presence[64];
+    json_writer_t w;
+    json_writer_init(&w, presence, sizeof(presence));
+    json_writer_begin_object(&w, NULL);
+    json_writer_add_bool(&w, "online", true);
+    mqtt_manager_add_device_id(&w);
+    json_writer_end_object(&w);
+    size_t len = json_writer_finish(&w);
+
+    if (len > 0) {
+        mqtt_manager_publish(TOPIC_PRESENCE, presence, len);
+    }
+}
+
+// keepalive/2 acima do período: nenhuma janela fica sem tráfego por tempo suficiente para um ping
+static uint16_t mqtt_manager_keepalive_for(uint32_t period_ms, bool *park)
+{
+    uint32_t keepalive_s = 2 * (period_ms / 1000) + MQTT_KEEPALIVE_MARGIN_S;
+
+    *park = keepalive_s > MQTT_KEEPALIVE_MAX_S;
+    if (keepalive_s < MQTT_KEEPALIVE_MIN_S) {
+        keepalive_s = MQTT_KEEPALIVE_MIN_S;
+    } else if (keepalive_s > MQTT_KEEPALIVE_MAX_S) {
+        keepalive_s = MQTT_KEEPALIVE_MAX_S;
+    }
+    return (uint16_t)keepalive_s;
+}
+
+void mqtt_manager_plan_windows(uint32_t period_ms)
+{
+    bool park;
+    uint16_t keepalive_s = mqtt_manager_keepalive_for(period_ms, &park);
+
+    park_between_windows = park;
+    if (keepalive_s == mqtt_cfg.session.keepalive) {
+        return;
+    }
+    mqtt_cfg.session.keepalive = keepalive_s;
+    ESP_LOGI(TAG, "Keepalive: %u s (período %lu s%s)", keepalive_s,
+             (unsigned long)(period_ms / 1000), park ? ", sessão encerrada entre janelas" : "");
+
+    // Aumento com sessão ativa espera o próximo CONNECT: o broker derruba
+    // a sessão após 1,5x o keepalive antigo se os pings rarearem antes
+    if (mqtt_client != NULL &&
+        (!connectivity_manager_is_online() || keepalive_s < session_keepalive_s)) {
+        mqtt_manager_apply_config();
+    }
+}
+
+uint16_t mqtt_manager_get_keepalive_s(void)
+{
+    return session_keepalive_s;
+}
+
+// Publica a presença "dormindo" e encerra a sessão sem reconexão automática
+// Chamar com park_mutex
+static bool mqtt_manager_close_session(uint32_t next_window_ms)
+{
+    if (parked || !connectivity_manager_is_online()) {
+        return false;
+    }
+
+    // DISCONNECT limpo não dispara o Last Will: a presença sai antes
+    char presence[64];
+    json_writer_t w;
+    json_writer_init(&w, presence, sizeof(presence));
+    json_writer_begin_object(&w, NULL);
+    json_writer_add_bool(&w, "online", false);
+    json_writer_add_int(&w, "next_s", next_window_ms / 1000);
+    json_writer_end_object(&w);
+    size_t len = json_writer_finish(&w);
+    if (len > 0) {
+        mqtt_manager_publish(TOPIC_PRESENCE, presence, len);
+    }
+    mqtt_manager_wait_all_published(MQTT_PARK_DRAIN_MS);
+
+    parked = true;
+    connectivity_manager_pause_mqtt();
+    esp_mqtt_client_disconnect(mqtt_client);
+
+    ESP_LOGI(TAG, "Sessão encerrada até a próxima janela (%lu s)",
+             (unsigned long)(next_window_ms / 1000));
+    return true;
+}
+
+bool mqtt_manager_park(uint32_t next_window_ms)
+{
+    if (park_mutex == NULL || !park_between_windows) {
+        return false;
+    }
+
+    xSemaphoreTake(park_mutex, portMAX_DELAY);
+    bool closed = mqtt_manager_close_session(next_window_ms);
+    xSemaphoreGive(park_mutex);
+    return closed;
+}
+
+bool mqtt_manager_shutdown(uint32_t next_window_ms)
+{
+    if (park_mutex == NULL) {
+        return false;
+    }
+
+    xSemaphoreTake(park_mutex, portMAX_DELAY);
+    bool closed = mqtt_manager_close_session(next_window_ms);
+    xSemaphoreGive(park_mutex);
+    return closed;
+}
+
+void mqtt_manager_unpark(void)
+{
+    if (park_mutex == NULL) {
+        return;
+    }
+
+    xSemaphoreTake(park_mutex, portMAX_DELAY);
+    if (parked) {
+        parked = false;
+        ESP_LOGI(TAG, "Janela de leitura: reconectando");
+        connectivity_manager_resume_mqtt();
+    }
+    xSemaphoreGive(park_mutex);
+}
+
+bool mqtt_manager_wait_all_published(uint32_t timeout_ms)
+{
+    if (publish_events == NULL) {
+        return true;
+    }
+    EventBits_t bits = xEventGroupWaitBits(publish_events, MQTT_DRAINED_BIT, pdFALSE, pdTRUE,
+                                           pdMS_TO_TICKS(timeout_ms));
+    return (bits & MQTT_DRAINED_BIT) != 0;
+}
+
+// Repassa o evento à configuração da planta e aos handlers customizados
+static void mqtt_manager_dispatch(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data)
+{
+    plant_config_mqtt_handler(handler_args, base, event_id, event_data);
+
+    for (int i = 0; i < handler_count; i++) {
+        if (custom_handlers[i] != NULL) {
+            custom_handlers[i](handler_args, base, event_id, event_data);
+        }
+    }
+}
+
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data)
 {
     esp_mqtt_event_handle_t event = event_data;
@@ -19,28 +428,47 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
 
     case MQTT_EVENT_CONNECTED:
         ESP_LOGI(TAG, "MQTT_EVENT_CONNECTED - Conectado ao AWS IoT!");
-        mqtt_connected = true;
+        ESP_LOGI(TAG, "Protocolo: MQTT %s", mqtt_manager_is_v5() ? "5" : "3.1.1");
+#if CONFIG_MQTT_PROTOCOL_5
+        aliases_enabled = true;   // Limite de aliases renegociado a cada CONNACK
+#endif
+        session_keepalive_s = applied_keepalive_s;
+        connectivity_manager_on_mqtt_connected();
+        mqtt_manager_publish_online();
+
+        // Sessão limpa: cada módulo assina de novo os seus tópicos a cada conexão
+        mqtt_manager_dispatch(handler_args, base, event_id, event_data);
         break;
 
-    case MQTT_EVENT_DATA:
-        ESP_LOGI(TAG, "MQTT_EVENT_DATA");
-        ESP_LOGI(TAG, "Tópico: %.*s", event->topic_len, event->topic);
-        ESP_LOGI(TAG, "Dados: %.*s", event->data_len, event->data);
-
-        // Chama o handler da configuração da planta
-        plant_config_mqtt_handler(handler_args, base, event_id, event_data);
-        
-        // Chama todos os handlers customizados registrados
-        for (int i = 0; i < handler_count; i++) {
-            if (custom_handlers[i] != NULL) {
-                custom_handlers[i](handler_args, base, event_id, event_data);
-            }
-        }
+    case MQTT_EVENT_DATA: {
+        // Só logs de depuração no callback: o orçamento é de MQTT_CALLBACK_BUDGET_US
+        int64_t start_us = esp_timer_get_time();
+        ESP_LOGD(TAG, "MQTT_EVENT_DATA %.*s: %.*s", event->topic_len, event->topic,
+                 event->data_len, event->data);
+
+        mqtt_manager_dispatch(handler_args, base, event_id, event_data);
+
+        mqtt_manager_account_callback(esp_timer_get_time() - start_us);
+        break;
+    }
+
+    case MQTT_EVENT_PUBLISHED:
+        mqtt_inflight_complete(event->msg_id, true);
+        break;
+
+    case MQTT_EVENT_DELETED:
+        // Expirou no outbox sem PUBACK: não conta mais como pendente
+        ESP_LOGW(TAG, "Mensagem %d expirada no outbox", event->msg_id);
+        mqtt_inflight_complete(event->msg_id, false);
         break;
 
     case MQTT_EVENT_DISCONNECTED:
         ESP_LOGW(TAG, "MQTT_EVENT_DISCONNECTED");
-        mqtt_connected = false;
+        // Aumento de keepalive adiado vale a partir da próxima conexão
+        if (mqtt_cfg.session.keepalive != applied_keepalive_s) {
+            mqtt_manager_apply_config();
+        }
+        connectivity_manager_on_mqtt_disconnected();
         break;
 
     case MQTT_EVENT_ERROR:
@@ -62,12 +490,18 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
                     ESP_LOGE(TAG, "   • Endpoint AWS IoT está correto?");
                 }
             } else if (event->error_handle->error_type == MQTT_ERROR_TYPE_CONNECTION_REFUSED) {
-                ESP_LOGE(TAG, "   CONNECTION_REFUSED: Código %d",
-                         event->error_handle->connect_return_code);
+                int code = event->error_handle->connect_return_code;
+                ESP_LOGE(TAG, "   CONNECTION_REFUSED: Código %d", code);
+#if CONFIG_MQTT_PROTOCOL_5
+                // Broker 3.1.1 responde "protocolo inaceitável" (1); MQTT 5 usa 0x84
+                if (!mqtt5_refused && (code == MQTT_CONNECTION_REFUSE_PROTOCOL ||
+                                       code == MQTT5_UNSUPPORTED_PROTOCOL_VER)) {
+                    mqtt_manager_fallback_v311();
+                }
+#endif
             }
         }
-
-        mqtt_connected = false;
+        // Falhas de conexão terminam em MQTT_EVENT_DISCONNECTED (reagendamento)
         break;
 
     default:
@@ -87,11 +521,173 @@ void mqtt_manager_set_custom_handler(mqtt_custom_event_handler_t handler)
     }
 }
 
+mqtt_callback_stats_t mqtt_manager_get_callback_stats(void)
+{
+    return callback_stats;
+}
+
+static int mqtt_manager_policy_index(const char *topic)
+{
+    for (int i = 0; i < (int)TOPIC_POLICY_COUNT; i++) {
+        if (strcmp(topic_policies[i].topic, topic) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+const mqtt_topic_policy_t *mqtt_manager_get_policy(const char *topic)
+{
+    int index = mqtt_manager_policy_index(topic);
+    return index >= 0 ? &topic_policies[index] : &default_policy;
+}
+
+uint32_t mqtt_manager_next_seq(const char *topic)
+{
+    int index = mqtt_manager_policy_index(topic);
+    return index >= 0 ? topic_seq[index]++ : 0;
+}
+
+mqtt_outbound_stats_t mqtt_manager_get_outbound_stats(void)
+{
+    return outbound_stats;
+}
+
+esp_err_t mqtt_manager_publish(const char *topic, const char *data, size_t len)
+{
+    if (high_lane == NULL || low_lane == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (len == 0 || len > MQTT_OUTBOUND_MAX_PAYLOAD) {
+        ESP_LOGE(TAG, "Payload inválido para %s (%d bytes)", topic, (int)len);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    const mqtt_topic_policy_t *policy = mqtt_manager_get_policy(topic);
+    QueueHandle_t lane = policy->priority == MQTT_PRIORITY_HIGH ? high_lane : low_lane;
+    BaseType_t queued;
+
+    mqtt_pending_add();
+    xSemaphoreTake(staging_mutex, portMAX_DELAY);
+    staging_msg.policy = policy;
+    staging_msg.topic = topic;
+    staging_msg.queued_us = esp_timer_get_time();
+    staging_msg.len = (uint16_t)len;
+    memcpy(staging_msg.data, data, len);
+    queued = xQueueSend(lane, &staging_msg, 0);
+    xSemaphoreGive(staging_mutex);
+
+    if (queued != pdTRUE) {
+        mqtt_pending_done();
+        outbound_stats.dropped_full++;
+        ESP_LOGW(TAG, "Faixa %s cheia, descartando %s",
+                 policy->priority == MQTT_PRIORITY_HIGH ? "alta" : "baixa", topic);
+        return ESP_ERR_NO_MEM;
+    }
+
+    xTaskNotifyGive(outbound_task);
+    return ESP_OK;
+}
+
+// Entrega uma mensagem ao cliente; retorna false se deve ser tentada de novo
+static bool mqtt_outbound_send(const mqtt_outbound_msg_t *msg)
+{
+    const mqtt_topic_policy_t *policy = msg->policy;
+    int outbox = esp_mqtt_client_get_outbox_size(mqtt_client);
+    uint32_t age_s = (uint32_t)((esp_timer_get_time() - msg->queued_us) / 1000000);
+
+    // Leitura vencida na fila local não é enviada
+    if (policy->expiry_s != 0 && age_s >= policy->expiry_s) {
+        outbound_stats.dropped_stale++;
+        ESP_LOGW(TAG, "%s expirou na fila (%lu s)", msg->topic, (unsigned long)age_s);
+        mqtt_pending_done();
+        return true;
+    }
+
+    outbound_stats.outbox_bytes = outbox;
+    if (outbox > outbound_stats.outbox_peak) {
+        outbound_stats.outbox_peak = outbox;
+    }
+
+    if (policy->qos == 0) {
+        // Telemetria: perder uma amostra é melhor que acumular memória
+        if (!connectivity_manager_is_online()) {
+            outbound_stats.dropped_offline++;
+            mqtt_pending_done();
+            return true;
+        }
+        if (outbox > (int)policy->outbox_cap) {
+            outbound_stats.dropped_outbox++;
+            ESP_LOGW(TAG, "Outbox com %d bytes, descartando %s", outbox, msg->topic);
+            mqtt_pending_done();
+            return true;
+        }
+    } else if (outbox > (int)policy->outbox_cap) {
+        // QoS 1: aguarda PUBACKs liberarem o outbox
+        return false;
+    }
+
+#if CONFIG_MQTT_PROTOCOL_5
+    if (mqtt_manager_is_v5()) {
+        mqtt_manager_set_publish_property(policy, age_s);
+    }
+#endif
+
+    int msg_id = esp_mqtt_client_publish(mqtt_client, msg->topic, msg->data, msg->len,
+                                         policy->qos, policy->retain);
+    if (msg_id < 0) {
+        if (policy->qos == 0) {
+            mqtt_pending_done();  // QoS 0 não é reenviada
+            return true;
+        }
+        return false;
+    }
+
+    // QoS 0 já foi escrita no socket; QoS 1 conclui no PUBACK
+    if (policy->qos == 0) {
+        mqtt_pending_done();
+    } else {
+        mqtt_inflight_track(msg_id);
+    }
+    outbound_stats.published++;
+    ESP_LOGD(TAG, "Publicado %s [msg_id=%d, qos=%d]", msg->topic, msg_id, policy->qos);
+    // Só leituras dos sensores (únicos tópicos com validade): lote, energia e boot não contam
+    if (policy->expiry_s != 0) {
+        boot_timeline_mark(BOOT_STAGE_FIRST_PUBLISH);
+    }
+    return true;
+}
+
+static void mqtt_outbound_task(void *pvParameters)
+{
+    static mqtt_outbound_msg_t msg;
+
+    while (1) {
+        // Faixa alta sempre primeiro; telemetria só sai com ela vazia
+        QueueHandle_t lane = high_lane;
+        if (xQueueReceive(high_lane, &msg, 0) != pdTRUE) {
+            lane = low_lane;
+            if (xQueueReceive(low_lane, &msg, 0) != pdTRUE) {
+                ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+                continue;
+            }
+        }
+
+        if (!mqtt_outbound_send(&msg)) {
+            // Mantém a ordem: volta para o início da própria faixa
+            if (xQueueSendToFront(lane, &msg, 0) != pdTRUE) {
+                outbound_stats.dropped_full++;
+                mqtt_pending_done();
+            }
+            vTaskDelay(pdMS_TO_TICKS(MQTT_OUTBOUND_RETRY_MS));
+        }
+    }
+}
+
 void mqtt_manager_start(const char *endpoint, const char *client_id,
                        const uint8_t *root_ca, const uint8_t *device_cert, const uint8_t *device_key,
                        esp_mqtt_client_handle_t *out_client)
 {
-    char mqtt_url[256];
     snprintf(mqtt_url, sizeof(mqtt_url), "mqtts://%s:8883", endpoint);
 
     ESP_LOGI(TAG, "══════════════════════════════════════════════");
@@ -99,6 +695,9 @@ void mqtt_manager_start(const char *endpoint, const char *client_id,
     ESP_LOGI(TAG, "══════════════════════════════════════════════");
     ESP_LOGI(TAG, "URL: %s", mqtt_url);
     ESP_LOGI(TAG, "Client ID: %s", client_id);
+
+    bool park;
+    uint16_t keepalive_s = mqtt_manager_keepalive_for(sampling_governor_window_ms(), &park);
     ESP_LOGI(TAG, "Root CA: %p", root_ca);
     ESP_LOGI(TAG, "Cert:    %p", device_cert);
     ESP_LOGI(TAG, "Key:     %p", device_key);
@@ -114,36 +713,70 @@ void mqtt_manager_start(const char *endpoint, const char *client_id,
         return;
     }
 
-    esp_mqtt_client_config_t mqtt_cfg = {
+    // Transporte TLS próprio: reconexões oferecem a sessão salva
+    esp_transport_handle_t transport = tls_transport_create((const char *)root_ca,
+                                                            (const char *)device_cert,
+                                                            (const char *)device_key);
+    if (transport == NULL) {
+        ESP_LOGE(TAG, "Falha ao criar transporte TLS");
+        *out_client = NULL;
+        return;
+    }
+
+    mqtt_cfg = (esp_mqtt_client_config_t){
         .broker = {
             .address.uri = mqtt_url,
-            .verification = {
-                .certificate = (const char *)root_ca,
-                .use_global_ca_store = false,
-            },
         },
         .credentials = {
-            .authentication = {
-                .certificate = (const char *)device_cert,
-                .key = (const char *)device_key,
-            },
             .client_id = client_id,
         },
         .session = {
-            .keepalive = 120,
+            // Queda sem DISCONNECT (energia, rede, keepalive): broker retém "offline"
+            .last_will = {
+                .topic = TOPIC_PRESENCE,
+                .msg = MQTT_PRESENCE_OFFLINE,
+                .msg_len = sizeof(MQTT_PRESENCE_OFFLINE) - 1,
+                .qos = 1,
+                .retain = 1,
+            },
+            .keepalive = keepalive_s,   // Ajustado ao período de leitura
             .disable_clean_session = false,
         },
         .network = {
             .timeout_ms = 10000,  // Timeout de 10 segundos
             .refresh_connection_after_ms = 0,
-            .disable_auto_reconnect = false,
+            .disable_auto_reconnect = true,  // Reconexão com backoff no connectivity_manager
+            .transport = transport,  // CA e certificados configurados no transporte
         },
         .buffer = {
-            .size = 2048,
+            .size = MQTT_RX_BUFFER_SIZE,
             .out_size = 2048,
+        },
+        .outbox = {
+            .limit = MQTT_OUTBOX_LIMIT_BYTES,
         }
     };
 
+#if CONFIG_MQTT_PROTOCOL_5
+    mqtt_cfg.session.protocol_ver = mqtt5_refused ? MQTT_PROTOCOL_V_3_1_1 : MQTT_PROTOCOL_V_5;
+
+    // Identificação em toda publicação, fora do corpo
+    if (publish_user_props == NULL) {
+        esp_mqtt5_user_property_item_t items[] = {
+            {"device_id", MQTT_DEVICE_ID},
+            {"schema", MQTT_SCHEMA_VERSION},
+        };
+        esp_mqtt5_client_set_user_property(&publish_user_props, items,
+                                           sizeof(items) / sizeof(items[0]));
+    }
+#else
+    mqtt_cfg.session.protocol_ver = MQTT_PROTOCOL_V_3_1_1;
+#endif
+
+    park_between_windows = park;
+    applied_keepalive_s = keepalive_s;
+    ESP_LOGI(TAG, "Keepalive: %u s", keepalive_s);
+
     esp_mqtt_client_handle_t client = esp_mqtt_client_init(&mqtt_cfg);
     if (client == NULL) {
         ESP_LOGE(TAG, "Falha ao inicializar cliente MQTT");
@@ -154,8 +787,25 @@ void mqtt_manager_start(const char *endpoint, const char *client_id,
     ESP_LOGI(TAG, "Cliente MQTT inicializado");
     ESP_ERROR_CHECK(esp_mqtt_client_register_event(client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL));
 
+    mqtt_client = client;
+    connectivity_manager_set_mqtt_client(client);
+
+    // Fila de saída com duas faixas e task de envio
+    if (high_lane == NULL) {
+        high_lane = xQueueCreate(MQTT_OUTBOUND_HIGH_DEPTH, sizeof(mqtt_outbound_msg_t));
+        low_lane = xQueueCreate(MQTT_OUTBOUND_LOW_DEPTH, sizeof(mqtt_outbound_msg_t));
+        staging_mutex = xSemaphoreCreateMutex();
+        pending_mutex = xSemaphoreCreateMutex();
+        park_mutex = xSemaphoreCreateMutex();
+        publish_events = xEventGroupCreate();
+        xEventGroupSetBits(publish_events, MQTT_DRAINED_BIT);
+        xTaskCreatePinnedToCore(mqtt_outbound_task, "mqtt_out", 3072, NULL, 4, &outbound_task, 0);
+    }
+
+    // O cliente inicia com o primeiro IP (ou já, se houver): sem tentativa
+    // falha antes do WiFi nem espera fixa no app_main
     ESP_LOGI(TAG, "Iniciando cliente MQTT...");
-    ESP_ERROR_CHECK(esp_mqtt_client_start(client));
+    connectivity_manager_start_mqtt();
 
     *out_client = client;
 }
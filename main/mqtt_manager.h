@@ -2,6 +2,80 @@
 #define MQTT_MANAGER_H
 
 #include "mqtt_client.h"
+#include "json_writer.h"
+
+// Orçamento de tempo para o processamento de um MQTT_EVENT_DATA (µs)
+#define MQTT_CALLBACK_BUDGET_US 2000
+
+// Estatísticas de tempo de execução dos handlers de MQTT_EVENT_DATA
+typedef struct {
+    uint32_t count;        // Eventos processados
+    uint32_t over_budget;  // Eventos acima de MQTT_CALLBACK_BUDGET_US
+    int64_t last_us;       // Duração do último evento
+    int64_t max_us;        // Maior duração observada
+    int64_t total_us;      // Soma das durações (para média)
+} mqtt_callback_stats_t;
+
+// Fila de saída com duas faixas de prioridade
+#define MQTT_OUTBOUND_MAX_PAYLOAD 832   // Maior payload aceito por mqtt_manager_publish
+#define MQTT_OUTBOUND_HIGH_DEPTH 4      // Alertas, status, eventos da válvula
+#define MQTT_OUTBOUND_LOW_DEPTH 6       // Telemetria
+#define MQTT_OUTBOX_LIMIT_BYTES 8192    // Limite rígido do outbox do esp-mqtt
+#define MQTT_INFLIGHT_MAX 16            // msg_ids QoS 1 aguardando PUBACK
+#define MQTT_RX_BUFFER_SIZE 4096        // Recepção: get/accepted do shadow com metadata (~2,4 KB)
+
+// Identificação do dispositivo e versão do formato dos payloads.
+// Em MQTT 5 vão como user properties; em 3.1.1 o device_id vai no corpo
+#define MQTT_DEVICE_ID "ESP32_Client"
+#define MQTT_SCHEMA_VERSION "1"
+
+// Presença: "online" retido na conexão, "offline" retido pelo broker (Last Will)
+#define TOPIC_PRESENCE "esp32/presence"
+#define MQTT_PRESENCE_OFFLINE "{\"online\":false}"
+
+// Keepalive derivado do período de leitura: o esp-mqtt só envia PINGREQ após
+// keepalive/2 sem tráfego de saída, então com keepalive/2 acima do período a
+// publicação de cada janela mantém a sessão viva sem pings
+#define MQTT_KEEPALIVE_MIN_S 120
+#define MQTT_KEEPALIVE_MAX_S 1200     // Maior keepalive aceito pelo AWS IoT
+#define MQTT_KEEPALIVE_MARGIN_S 30    // Folga para atrasos da janela
+#define MQTT_PARK_DRAIN_MS 2000       // Prazo para a presença "dormindo" sair
+
+// Validade da telemetria: descartada na fila local e, em MQTT 5,
+// também no broker (message expiry) depois desse tempo
+#define MQTT_TELEMETRY_EXPIRY_S 600
+
+typedef enum {
+    MQTT_PRIORITY_HIGH,   // Sempre drenada antes da telemetria
+    MQTT_PRIORITY_LOW
+} mqtt_priority_t;
+
+// Política de publicação de um tópico
+typedef struct {
+    const char *topic;
+    uint8_t qos;
+    bool retain;
+    mqtt_priority_t priority;
+    uint32_t outbox_cap;  // Não publica enquanto o outbox estiver acima (bytes)
+    uint32_t expiry_s;    // Validade da mensagem (0 = sem expiração)
+    uint16_t alias;       // Topic alias em MQTT 5 (0 = sem alias)
+} mqtt_topic_policy_t;
+
+// Estatísticas da fila de saída
+typedef struct {
+    uint32_t published;       // Entregues ao cliente MQTT
+    uint32_t dropped_full;    // Descartadas por faixa cheia
+    uint32_t dropped_outbox;  // Telemetria QoS 0 descartada por outbox acima do limite
+    uint32_t dropped_offline; // Telemetria QoS 0 descartada sem conexão
+    uint32_t dropped_stale;   // Expiradas ainda na fila local (expiry_s)
+    int outbox_bytes;         // Último tamanho observado do outbox
+    int outbox_peak;          // Maior tamanho observado do outbox
+    uint32_t pending;         // Aceitas e ainda não concluídas (fila + sem PUBACK)
+    uint32_t expired;         // QoS 1 removidas do outbox sem PUBACK
+    uint32_t untracked;       // QoS 1 enviadas com a tabela de msg_id cheia
+    uint32_t ack_last_ms;     // Publicação -> PUBACK da última mensagem
+    uint32_t ack_max_ms;      // Maior tempo até o PUBACK
+} mqtt_outbound_stats_t;
 
 // Tipo de callback para eventos MQTT personalizados
 typedef void (*mqtt_custom_event_handler_t)(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data);
@@ -12,6 +86,77 @@ void mqtt_manager_start(const char *endpoint, const char *client_id,
 
 void mqtt_manager_set_custom_handler(mqtt_custom_event_handler_t handler);
 
-extern bool mqtt_connected;
+mqtt_callback_stats_t mqtt_manager_get_callback_stats(void);
+
+/**
+ * Enfileira uma publicação seguindo a política do tópico (QoS, retain, prioridade)
+ * O payload é copiado; topic deve ser uma string estática (ex: TOPIC_*)
+ * @return ESP_OK, ESP_ERR_INVALID_SIZE (payload grande demais) ou ESP_ERR_NO_MEM (faixa cheia)
+ */
+esp_err_t mqtt_manager_publish(const char *topic, const char *data, size_t len);
+
+/**
+ * Próximo número de sequência de um tópico (detecção de perdas em QoS 0)
+ */
+uint32_t mqtt_manager_next_seq(const char *topic);
+
+/**
+ * Política aplicada a um tópico (a padrão se não estiver na tabela)
+ */
+const mqtt_topic_policy_t *mqtt_manager_get_policy(const char *topic);
+
+mqtt_outbound_stats_t mqtt_manager_get_outbound_stats(void);
+
+/**
+ * Ajusta o keepalive ao período entre janelas de leitura
+ * Reduções valem já; aumentos só no próximo CONNECT (o broker ainda usa o valor antigo).
+ * Períodos longos demais para o keepalive máximo fazem a sessão ser encerrada
+ * entre janelas (mqtt_manager_park) em vez de mantida por PINGREQs
+ */
+void mqtt_manager_plan_windows(uint32_t period_ms);
+
+/**
+ * Keepalive negociado na sessão atual (s)
+ */
+uint16_t mqtt_manager_get_keepalive_s(void);
+
+/**
+ * Fim de janela: se o período não cabe no keepalive, publica a presença
+ * "dormindo" e encerra a sessão sem reconexão automática
+ * @param next_window_ms Tempo até a próxima janela
+ * @return true se a sessão foi encerrada
+ */
+bool mqtt_manager_park(uint32_t next_window_ms);
+
+/**
+ * Antes do deep sleep ou do modo radio_off: publica a presença "dormindo" e
+ * encerra a sessão independente do keepalive (o rádio vai ser desligado)
+ * @return true se a sessão foi encerrada
+ */
+bool mqtt_manager_shutdown(uint32_t next_window_ms);
+
+/**
+ * Início de janela: reconecta se a sessão foi encerrada por mqtt_manager_park
+ */
+void mqtt_manager_unpark(void);
+
+/**
+ * Indica se a sessão usa MQTT 5 (falso se o broker recusou e houve fallback para 3.1.1)
+ */
+bool mqtt_manager_is_v5(void);
+
+/**
+ * Acrescenta "device_id" ao payload somente em MQTT 3.1.1
+ * (em MQTT 5 a identificação segue nas user properties)
+ */
+void mqtt_manager_add_device_id(json_writer_t *w);
+
+/**
+ * Aguarda até todas as publicações aceitas serem concluídas:
+ * filas vazias e todos os msg_ids QoS 1 confirmados (MQTT_EVENT_PUBLISHED)
+ * @param timeout_ms Prazo máximo de espera
+ * @return true se tudo foi entregue antes do prazo
+ */
+bool mqtt_manager_wait_all_published(uint32_t timeout_ms);
 
 #endif // MQTT_MANAGER_H
@@ -1,4 +1,6 @@
 #include "ntp_sync.h"
+#include "connectivity_manager.h"
+#include "timestamp.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -6,6 +8,13 @@
 
 static const char *TAG = "NTP_SYNC";
 
+// Chamado pela task do SNTP a cada sincronização
+static void ntp_sync_notification(struct timeval *tv)
+{
+    timestamp_on_sync();
+    connectivity_manager_on_time_synced();
+}
+
 void ntp_sync_init(void)
 {
     ESP_LOGI(TAG, "Inicializando sincronização NTP...");
@@ -19,6 +28,7 @@ void ntp_sync_init(void)
     esp_sntp_setservername(0, "pool.ntp.org");
     esp_sntp_setservername(1, "time.google.com");
     esp_sntp_setservername(2, "time.cloudflare.com");
+    sntp_set_time_sync_notification_cb(ntp_sync_notification);
     esp_sntp_init();
     
     ESP_LOGI(TAG, "Servidores NTP configurados");
@@ -30,14 +40,9 @@ bool ntp_wait_sync(uint32_t timeout_ms)
     
     time_t now = 0;
     struct tm timeinfo = {0};
-    int retry = 0;
-    const int max_retries = timeout_ms / 500;
     
-    while (sntp_get_sync_status() == SNTP_SYNC_STATUS_RESET && retry < max_retries) {
-        ESP_LOGI(TAG, "Tentativa %d/%d...", retry + 1, max_retries);
-        vTaskDelay(pdMS_TO_TICKS(500));
-        retry++;
-    }
+    connectivity_manager_wait(CONNECTIVITY_TIME_BIT,
+                              timeout_ms == 0 ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms));
     
     time(&now);
     localtime_r(&now, &timeinfo);
@@ -57,11 +62,5 @@ bool ntp_wait_sync(uint32_t timeout_ms)
 
 void ntp_get_time_string(char *buffer, size_t size)
 {
-    time_t now;
-    struct tm timeinfo;
-    
-    time(&now);
-    localtime_r(&now, &timeinfo);
-    
-    strftime(buffer, size, "%Y-%m-%d %H:%M:%S", &timeinfo);
+    timestamp_format(timestamp_now(), buffer, size);
 }
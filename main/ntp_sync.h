@@ -11,12 +11,12 @@ extern "C" {
 /**
  * @brief Inicializa e sincroniza o relógio via NTP
  * 
- * @note Necessário para TLS funcionar corretamente
+ * Não bloqueia: a sincronização sinaliza CONNECTIVITY_TIME_BIT quando chega
  */
 void ntp_sync_init(void);
 
 /**
- * @brief Aguarda a sincronização NTP completar
+ * @brief Aguarda a sincronização NTP completar (espera o evento, sem polling)
  * 
  * @param timeout_ms Timeout em milissegundos (0 = aguarda indefinidamente)
  * @return true se sincronizou, false se timeout
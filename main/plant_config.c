@@ -1,14 +1,22 @@
 #include "plant_config.h"
 #include "esp_log.h"
+#include "esp_attr.h"
 #include "solenoid.h"
+#include "json_parser.h"
+#include "json_writer.h"
+#include "shadow_sync.h"
+#include "system_commands.h"
+#include "config_store.h"
+#include "esp_timer.h"
 #include <string.h>
 #include <stdio.h>
-#include <time.h>
-#include <sys/time.h>
+#include <stddef.h>
 
 static const char *TAG = "PLANT_CONFIG";
 
-static plant_config_t plant_config = {
+// Na RTC: ajustes recebidos continuam valendo após o deep sleep
+// (e na NVS pelo config_store, restaurados após um reset)
+static RTC_DATA_ATTR plant_config_t plant_config = {
     .temperature_min = 18,        // 18°C mínimo
     .temperature_max = 28,        // 28°C máximo
     .humidity_min = 60,           // 60% umidade do ar mínima
@@ -21,6 +29,32 @@ static plant_config_t plant_config = {
     .auto_irrigation = true       // Irrigação automática habilitada
 };
 
+// Campos aceitos em TOPIC_PLANT_CONFIG, resolvidos por hash perfeito
+typedef struct {
+    const char *key;
+    size_t offset;   // Offset do campo em plant_config_t
+    bool is_bool;    // bool ou int
+} config_field_t;
+
+static const config_field_t config_fields[] = {
+    {"temperature_min",      offsetof(plant_config_t, temperature_min),      false},
+    {"temperature_max",      offsetof(plant_config_t, temperature_max),      false},
+    {"humidity_min",         offsetof(plant_config_t, humidity_min),         false},
+    {"humidity_max",         offsetof(plant_config_t, humidity_max),         false},
+    {"soil_moisture_min",    offsetof(plant_config_t, soil_moisture_min),    false},
+    {"soil_moisture_max",    offsetof(plant_config_t, soil_moisture_max),    false},
+    {"uv_min",               offsetof(plant_config_t, uv_min),               false},
+    {"uv_max",               offsetof(plant_config_t, uv_max),               false},
+    {"irrigation_threshold", offsetof(plant_config_t, irrigation_threshold), false},
+    {"auto_irrigation",      offsetof(plant_config_t, auto_irrigation),      true},
+};
+
+// Semente sem colisões para as chaves acima em JSON_PHASH_SLOTS
+#define CONFIG_FIELDS_HASH_SEED 10
+
+static json_phash_t config_fields_hash;
+static bool config_fields_hash_ready = false;
+
 void plant_config_init(void){
 
     ESP_LOGI(TAG, "═══════════════════════════════════════════════");
@@ -36,15 +70,14 @@ void plant_config_init(void){
 
 plant_config_t* plant_config_get(void){return &plant_config;}
 
+bool plant_config_is_dry(int current_moisture){
+    return plant_config.auto_irrigation &&
+           current_moisture < plant_config.soil_moisture_min - plant_config.irrigation_threshold;
+}
+
 bool plant_config_should_irrigate(int current_moisture){
-    if (!plant_config.auto_irrigation) {
-        return false;
-    }
-    
-    // Calcula o limiar de irrigação
-    int threshold = plant_config.soil_moisture_min - plant_config.irrigation_threshold;
-    
-    if (current_moisture < threshold) {
+    if (plant_config_is_dry(current_moisture)) {
+        int threshold = plant_config.soil_moisture_min - plant_config.irrigation_threshold;
         ESP_LOGW(TAG, "   IRRIGAÇÃO NECESSÁRIA!");
         ESP_LOGW(TAG, "   Umidade atual: %d%%", current_moisture);
         ESP_LOGW(TAG, "   Limiar: %d%% (ideal: %d%% - %d%%)", 
@@ -55,205 +88,222 @@ bool plant_config_should_irrigate(int current_moisture){
     return false;
 }
 
-bool plant_config_check_parameters(int temp, int humidity, int soil_moisture,int uv, char *alert_msg){
-    bool all_ok = true;
-    char temp_msg[256] = {0};
-    
-    strcpy(alert_msg, "{\"alerts\":[");
-    
-    // Verifica temperatura
-    if (temp < plant_config.temperature_min) {
-        snprintf(temp_msg, sizeof(temp_msg), 
-                 "{\"type\":\"temp_low\",\"value\":%d,\"min\":%d},", 
-                 temp, plant_config.temperature_min);
-        strcat(alert_msg, temp_msg);
-        all_ok = false;
-    } else if (temp > plant_config.temperature_max) {
-        snprintf(temp_msg, sizeof(temp_msg), 
-                 "{\"type\":\"temp_high\",\"value\":%d,\"max\":%d},", 
-                 temp, plant_config.temperature_max);
-        strcat(alert_msg, temp_msg);
-        all_ok = false;
+// Adiciona um alerta ao array se o valor estiver fora da faixa [min, max]
+static bool plant_config_check_range(json_writer_t *w, const char *low_type, const char *high_type,
+                                     int value, int min, int max){
+    if (value >= min && value <= max) {
+        return true;
     }
     
-    // Verifica umidade do ar
-    if (humidity < plant_config.humidity_min) {
-        snprintf(temp_msg, sizeof(temp_msg), 
-                 "{\"type\":\"humidity_low\",\"value\":%d,\"min\":%d},", 
-                 humidity, plant_config.humidity_min);
-        strcat(alert_msg, temp_msg);
-        all_ok = false;
-    } else if (humidity > plant_config.humidity_max) {
-        snprintf(temp_msg, sizeof(temp_msg), 
-                 "{\"type\":\"humidity_high\",\"value\":%d,\"max\":%d},", 
-                 humidity, plant_config.humidity_max);
-        strcat(alert_msg, temp_msg);
-        all_ok = false;
-    }
+    bool low = value < min;
+    json_writer_begin_object(w, NULL);
+    json_writer_add_string(w, "type", low ? low_type : high_type);
+    json_writer_add_int(w, "value", value);
+    json_writer_add_int(w, low ? "min" : "max", low ? min : max);
+    json_writer_end_object(w);
+    return false;
+}
+
+bool plant_config_check_parameters(int temp, int humidity, int soil_moisture, int uv,
+                                   char *alert_msg, size_t alert_size){
+    bool all_ok = true;
+    json_writer_t w;
     
-    // Verifica umidade do solo
-    if (soil_moisture < plant_config.soil_moisture_min) {
-        snprintf(temp_msg, sizeof(temp_msg), 
-                 "{\"type\":\"soil_low\",\"value\":%d,\"min\":%d},", 
-                 soil_moisture, plant_config.soil_moisture_min);
-        strcat(alert_msg, temp_msg);
-        all_ok = false;
-    } else if (soil_moisture > plant_config.soil_moisture_max) {
-        snprintf(temp_msg, sizeof(temp_msg), 
-                 "{\"type\":\"soil_high\",\"value\":%d,\"max\":%d},", 
-                 soil_moisture, plant_config.soil_moisture_max);
-        strcat(alert_msg, temp_msg);
-        all_ok = false;
-    }
+    json_writer_init(&w, alert_msg, alert_size);
+    json_writer_begin_object(&w, NULL);
+    json_writer_begin_array(&w, "alerts");
     
-    // Verifica UV
-    if (uv < plant_config.uv_min) {
-        snprintf(temp_msg, sizeof(temp_msg), 
-                 "{\"type\":\"uv_low\",\"value\":%d,\"min\":%d},", 
-                 uv, plant_config.uv_min);
-        strcat(alert_msg, temp_msg);
-        all_ok = false;
-    } else if (uv > plant_config.uv_max) {
-        snprintf(temp_msg, sizeof(temp_msg), 
-                 "{\"type\":\"uv_high\",\"value\":%d,\"max\":%d},", 
-                 uv, plant_config.uv_max);
-        strcat(alert_msg, temp_msg);
-        all_ok = false;
-    }
+    all_ok &= plant_config_check_range(&w, "temp_low", "temp_high", temp,
+                                       plant_config.temperature_min, plant_config.temperature_max);
+    all_ok &= plant_config_check_range(&w, "humidity_low", "humidity_high", humidity,
+                                       plant_config.humidity_min, plant_config.humidity_max);
+    all_ok &= plant_config_check_range(&w, "soil_low", "soil_high", soil_moisture,
+                                       plant_config.soil_moisture_min, plant_config.soil_moisture_max);
+    all_ok &= plant_config_check_range(&w, "uv_low", "uv_high", uv,
+                                       plant_config.uv_min, plant_config.uv_max);
     
-    // Remove última vírgula e fecha JSON
-    int len = strlen(alert_msg);
-    if (alert_msg[len-1] == ',') {
-        alert_msg[len-1] = ']';
-        strcat(alert_msg, "}");
-    } else {
-        strcat(alert_msg, "]}");
+    json_writer_end_array(&w);
+    json_writer_end_object(&w);
+    
+    if (json_writer_finish(&w) == 0) {
+        ESP_LOGW(TAG, "Buffer de alertas insuficiente (%d bytes)", (int)alert_size);
     }
     
     return all_ok;
 }
 
-esp_err_t plant_config_update_from_json(const char *json_data){
-    ESP_LOGI(TAG, "Atualizando configuração da planta...");
-    ESP_LOGI(TAG, "JSON: %s", json_data);
-    
-    // Parse simples de JSON
-    int temp_min, temp_max, hum_min, hum_max;
-    int soil_min, soil_max, uv_min, uv_max;
-    int threshold;
-    
-    // Tenta extrair os valores
-    bool updated = false;
-    const char *ptr = NULL;
-    
-    // Verifica auto_irrigation primeiro (booleano)
-    if (strstr(json_data, "\"auto_irrigation\":true") != NULL || 
-        strstr(json_data, "\"auto_irrigation\": true") != NULL) {
-        plant_config.auto_irrigation = true;
-        updated = true;
-        ESP_LOGI(TAG, "auto_irrigation = true");
-    } else if (strstr(json_data, "\"auto_irrigation\":false") != NULL ||
-               strstr(json_data, "\"auto_irrigation\": false") != NULL) {
-        plant_config.auto_irrigation = false;
-        updated = true;
-        ESP_LOGI(TAG, "auto_irrigation = false");
+static bool plant_config_fields_ready(void){
+    if (!config_fields_hash_ready) {
+        config_fields_hash_ready = json_phash_init(&config_fields_hash, config_fields,
+                                                   sizeof(config_fields) / sizeof(config_fields[0]),
+                                                   sizeof(config_fields[0]), CONFIG_FIELDS_HASH_SEED);
+        if (!config_fields_hash_ready) {
+            ESP_LOGE(TAG, "Colisão na tabela hash de campos - ajuste CONFIG_FIELDS_HASH_SEED");
+        }
     }
-    
-    // Temperatura mínima
-    ptr = strstr(json_data, "\"temperature_min\":");
-    if (ptr != NULL && sscanf(ptr, "\"temperature_min\":%d", &temp_min) == 1) {
-        plant_config.temperature_min = temp_min;
-        updated = true;
-        ESP_LOGI(TAG, "temperature_min = %d", temp_min);
+    return config_fields_hash_ready;
+}
+
+// Aplica o par em cfg; retorna o índice do campo em config_fields ou -1
+// (só log de depuração: roda no callback MQTT ao preparar a configuração)
+static int plant_config_set_field_index(plant_config_t *cfg, const char *js,
+                                        const json_token_t *key, const json_token_t *value){
+    if (!plant_config_fields_ready()) {
+        return -1;
     }
     
-    // Temperatura máxima
-    ptr = strstr(json_data, "\"temperature_max\":");
-    if (ptr != NULL && sscanf(ptr, "\"temperature_max\":%d", &temp_max) == 1) {
-        plant_config.temperature_max = temp_max;
-        updated = true;
-        ESP_LOGI(TAG, "temperature_max = %d", temp_max);
+    int field = json_phash_lookup(&config_fields_hash, js, key);
+    if (field < 0) {
+        return -1;
     }
     
-    // Umidade mínima
-    ptr = strstr(json_data, "\"humidity_min\":");
-    if (ptr != NULL && sscanf(ptr, "\"humidity_min\":%d", &hum_min) == 1) {
-        plant_config.humidity_min = hum_min;
-        updated = true;
-        ESP_LOGI(TAG, "humidity_min = %d", hum_min);
-    }
+    const config_field_t *f = &config_fields[field];
+    void *dst = (char *)cfg + f->offset;
     
-    // Umidade máxima
-    ptr = strstr(json_data, "\"humidity_max\":");
-    if (ptr != NULL && sscanf(ptr, "\"humidity_max\":%d", &hum_max) == 1) {
-        plant_config.humidity_max = hum_max;
-        updated = true;
-        ESP_LOGI(TAG, "humidity_max = %d", hum_max);
+    if (f->is_bool) {
+        bool b;
+        if (json_token_to_bool(js, value, &b)) {
+            *(bool *)dst = b;
+            ESP_LOGD(TAG, "%s = %s", f->key, b ? "true" : "false");
+            return field;
+        }
+    } else {
+        int v;
+        if (json_token_to_int(js, value, &v)) {
+            *(int *)dst = v;
+            ESP_LOGD(TAG, "%s = %d", f->key, v);
+            return field;
+        }
     }
+    return -1;
+}
+
+bool plant_config_set_field(plant_config_t *cfg, const char *js,
+                            const json_token_t *key, const json_token_t *value){
+    return plant_config_set_field_index(cfg, js, key, value) >= 0;
+}
+
+int plant_config_stage_fields(const char *js, const json_token_t *tokens, int count,
+                              plant_config_t *staged, uint32_t *mask){
+    int staged_count = 0;
     
-    // Umidade do solo mínima
-    ptr = strstr(json_data, "\"soil_moisture_min\":");
-    if (ptr != NULL && sscanf(ptr, "\"soil_moisture_min\":%d", &soil_min) == 1) {
-        plant_config.soil_moisture_min = soil_min;
-        updated = true;
-        ESP_LOGI(TAG, "soil_moisture_min = %d", soil_min);
+    *staged = plant_config;
+    *mask = 0;
+    if (count < 1 || tokens[0].type != JSON_TOKEN_OBJECT) {
+        return 0;
     }
     
-    // Umidade do solo máxima
-    ptr = strstr(json_data, "\"soil_moisture_max\":");
-    if (ptr != NULL && sscanf(ptr, "\"soil_moisture_max\":%d", &soil_max) == 1) {
-        plant_config.soil_moisture_max = soil_max;
-        updated = true;
-        ESP_LOGI(TAG, "soil_moisture_max = %d", soil_max);
+    // Percorre os pares chave/valor do objeto raiz
+    int i = 1;
+    for (int pair = 0; pair < tokens[0].size / 2 && i + 1 < count; pair++) {
+        int field = plant_config_set_field_index(staged, js, &tokens[i], &tokens[i + 1]);
+        if (field >= 0) {
+            *mask |= 1u << field;
+            staged_count++;
+        }
+        i = json_next(tokens, count, i + 1);
     }
-    
-    // UV mínimo
-    ptr = strstr(json_data, "\"uv_min\":");
-    if (ptr != NULL && sscanf(ptr, "\"uv_min\":%d", &uv_min) == 1) {
-        plant_config.uv_min = uv_min;
-        updated = true;
-        ESP_LOGI(TAG, "uv_min = %d", uv_min);
+    return staged_count;
+}
+
+void plant_config_merge(plant_config_t *dst, const plant_config_t *src, uint32_t mask){
+    for (size_t i = 0; i < sizeof(config_fields) / sizeof(config_fields[0]); i++) {
+        if (mask & (1u << i)) {
+            size_t size = config_fields[i].is_bool ? sizeof(bool) : sizeof(int);
+            memcpy((char *)dst + config_fields[i].offset,
+                   (const char *)src + config_fields[i].offset, size);
+        }
     }
-    
-    // UV máximo
-    ptr = strstr(json_data, "\"uv_max\":");
-    if (ptr != NULL && sscanf(ptr, "\"uv_max\":%d", &uv_max) == 1) {
-        plant_config.uv_max = uv_max;
-        updated = true;
-        ESP_LOGI(TAG, "uv_max = %d", uv_max);
+}
+
+esp_err_t plant_config_apply(const plant_config_t *staged, uint32_t mask){
+    if (mask == 0) {
+        ESP_LOGW(TAG, "Nenhum parâmetro válido encontrado no JSON");
+        return ESP_FAIL;
     }
     
-    // Limiar de irrigação
-    ptr = strstr(json_data, "\"irrigation_threshold\":");
-    if (ptr != NULL && sscanf(ptr, "\"irrigation_threshold\":%d", &threshold) == 1) {
-        plant_config.irrigation_threshold = threshold;
-        updated = true;
-        ESP_LOGI(TAG, "irrigation_threshold = %d", threshold);
+    // Copia só os campos presentes na mensagem (alterações de outras origens são mantidas)
+    plant_config_merge(&plant_config, staged, mask);
+    config_store_mark_dirty(CONFIG_STORE_PLANT);
+    
+    ESP_LOGI(TAG, "Configuração atualizada com sucesso!");
+    plant_config_init(); // Mostra nova configuração
+    shadow_sync_report(false); // Reporta só os campos alterados
+    return ESP_OK;
+}
+
+int plant_config_write_fields(json_writer_t *w, const plant_config_t *since){
+    int written = 0;
+    
+    for (size_t i = 0; i < sizeof(config_fields) / sizeof(config_fields[0]); i++) {
+        const config_field_t *f = &config_fields[i];
+        const void *cur = (const char *)&plant_config + f->offset;
+        const void *old = since != NULL ? (const char *)since + f->offset : NULL;
+        
+        if (f->is_bool) {
+            if (old == NULL || *(const bool *)old != *(const bool *)cur) {
+                json_writer_add_bool(w, f->key, *(const bool *)cur);
+                written++;
+            }
+        } else {
+            if (old == NULL || *(const int *)old != *(const int *)cur) {
+                json_writer_add_int(w, f->key, *(const int *)cur);
+                written++;
+            }
+        }
     }
+    return written;
+}
+
+esp_err_t plant_config_update_from_json(const char *json_data){
+    ESP_LOGI(TAG, "Atualizando configuração da planta...");
+    ESP_LOGI(TAG, "JSON: %s", json_data);
     
-    if (updated) {
-        ESP_LOGI(TAG, "Configuração atualizada com sucesso!");
-        plant_config_init(); // Mostra nova configuração
-        return ESP_OK;
-    } else {
-        ESP_LOGW(TAG, "Nenhum parâmetro válido encontrado no JSON");
+    // Tokenização em uma única passada, sem alocação
+    json_token_t tokens[JSON_MAX_TOKENS];
+    int count = json_parse(json_data, strlen(json_data), tokens, JSON_MAX_TOKENS);
+    if (count < 1 || tokens[0].type != JSON_TOKEN_OBJECT) {
+        ESP_LOGW(TAG, "JSON inválido (erro %d)", count);
         return ESP_FAIL;
     }
+    
+    plant_config_t staged;
+    uint32_t mask;
+    plant_config_stage_fields(json_data, tokens, count, &staged, &mask);
+    return plant_config_apply(&staged, mask);
 }
 
 void plant_config_mqtt_handler(void *handler_args, esp_event_base_t base,int32_t event_id, void *event_data){
     
     esp_mqtt_event_handle_t event = event_data;
     
+    if (event_id == MQTT_EVENT_CONNECTED) {
+        int msg_id = esp_mqtt_client_subscribe(event->client, TOPIC_PLANT_CONFIG, 1);
+        ESP_LOGI(TAG, "Subscribed: %s (msg_id=%d)", TOPIC_PLANT_CONFIG, msg_id);
+        return;
+    }
+    
     if (event_id == MQTT_EVENT_DATA) {
         char topic[128] = {0};
         snprintf(topic, sizeof(topic), "%.*s", event->topic_len, event->topic);
         
         if (strncmp(topic, TOPIC_PLANT_CONFIG, strlen(TOPIC_PLANT_CONFIG)) == 0) {
-            char data[512] = {0};
-            snprintf(data, sizeof(data), "%.*s", event->data_len, event->data);
+            system_command_t cmd = {
+                .type = SYS_CMD_CONFIG_UPDATE,
+                .client = event->client,
+                .received_us = esp_timer_get_time(),
+            };
             
-            plant_config_update_from_json(data);
+            // Valida e prepara os campos aqui; a task de comandos aplica e confirma
+            json_token_t tokens[JSON_MAX_TOKENS];
+            int count = json_parse(event->data, event->data_len, tokens, JSON_MAX_TOKENS);
+            if (count < 1) {
+                ESP_LOGD(TAG, "JSON inválido (erro %d)", count);
+                return;
+            }
+            plant_config_stage_fields(event->data, tokens, count, &cmd.config, &cmd.config_mask);
+            system_commands_copy_id(event->data, tokens, count, &cmd);
+            system_commands_enqueue(&cmd);
         }
     }
 }
@@ -261,34 +311,7 @@ void plant_config_mqtt_handler(void *handler_args, esp_event_base_t base,int32_t
 void plant_config_publish(esp_mqtt_client_handle_t client){
     if (client == NULL) return;
     
-    // Obtém timestamp Unix em segundos e converte para milissegundos
-    time_t now;
-    time(&now);
-    int64_t timestamp_ms = (int64_t)now * 1000;
-    
-    // Obtém horário formatado
-    struct tm timeinfo;
-    localtime_r(&now, &timeinfo);
-    char time_str[64];
-    strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", &timeinfo);
-    
-    char message[768];
-    snprintf(message, sizeof(message),
-        "{\"device_id\":\"ESP32_Client\","
-        "\"temperature_min\":%d,\"temperature_max\":%d,"
-        "\"humidity_min\":%d,\"humidity_max\":%d,"
-        "\"soil_moisture_min\":%d,\"soil_moisture_max\":%d,"
-        "\"uv_min\":%d,\"uv_max\":%d,"
-        "\"irrigation_threshold\":%d,\"auto_irrigation\":%s,"
-        "\"timestamp\":%lld,\"datetime\":\"%s\",\"event\":\"system_init\"}",
-        plant_config.temperature_min, plant_config.temperature_max,
-        plant_config.humidity_min, plant_config.humidity_max,
-        plant_config.soil_moisture_min, plant_config.soil_moisture_max,
-        plant_config.uv_min, plant_config.uv_max,
-        plant_config.irrigation_threshold,
-        plant_config.auto_irrigation ? "true" : "false",
-        timestamp_ms, time_str);
-    
-    esp_mqtt_client_publish(client, TOPIC_PLANT_CONFIG, message, 0, 1, 0);
-    ESP_LOGI(TAG, "Configuração publicada [%s]", time_str);
+    // Documento completo no shadow (reported); atualizações normais enviam só o delta
+    shadow_sync_report(true);
+    ESP_LOGI(TAG, "Configuração publicada no shadow");
 }
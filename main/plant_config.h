@@ -3,7 +3,10 @@
 
 #include "esp_err.h"
 #include "mqtt_client.h"
+#include "json_parser.h"
+#include "json_writer.h"
 #include <stdbool.h>
+#include <stddef.h>
 
 // Tópico para receber configurações
 #define TOPIC_PLANT_CONFIG "esp32/config"
@@ -41,6 +44,52 @@ plant_config_t* plant_config_get(void);
  */
 esp_err_t plant_config_update_from_json(const char *json_data);
 
+/**
+ * @brief Aplica um par chave/valor JSON a uma configuração
+ * @param cfg Configuração de destino
+ * @param js Texto JSON
+ * @param key Token da chave
+ * @param value Token do valor
+ * @return true se a chave é um campo conhecido e o valor é válido
+ */
+bool plant_config_set_field(plant_config_t *cfg, const char *js,
+                            const json_token_t *key, const json_token_t *value);
+
+/**
+ * @brief Prepara uma atualização sem alterar a configuração ativa
+ * @param tokens Documento já tokenizado (objeto raiz com os campos)
+ * @param staged Recebe a configuração atual com os campos do documento aplicados
+ * @param mask Recebe um bit por campo presente (ordem da tabela de campos)
+ * @return Número de campos válidos
+ */
+int plant_config_stage_fields(const char *js, const json_token_t *tokens, int count,
+                              plant_config_t *staged, uint32_t *mask);
+
+/**
+ * @brief Copia de src para dst apenas os campos marcados em mask
+ */
+void plant_config_merge(plant_config_t *dst, const plant_config_t *src, uint32_t mask);
+
+/**
+ * @brief Copia para a configuração ativa os campos marcados em mask
+ * @return ESP_OK ou ESP_FAIL se mask estiver vazia
+ */
+esp_err_t plant_config_apply(const plant_config_t *staged, uint32_t mask);
+
+/**
+ * @brief Escreve os campos da configuração atual como pares JSON
+ * @param w Escritor posicionado dentro de um objeto
+ * @param since Se não NULL, escreve apenas os campos diferentes desta cópia
+ * @return Número de campos escritos
+ */
+int plant_config_write_fields(json_writer_t *w, const plant_config_t *since);
+
+/**
+ * @brief Mesma decisão de plant_config_should_irrigate, sem log (para consultas)
+ * @param current_moisture Umidade atual do solo (%)
+ */
+bool plant_config_is_dry(int current_moisture);
+
 /**
  * @brief Verifica se é necessário irrigar baseado na umidade do solo
  * @param current_moisture Umidade atual do solo (%)
@@ -54,11 +103,12 @@ bool plant_config_should_irrigate(int current_moisture);
  * @param humidity Umidade do ar atual (%)
  * @param soil_moisture Umidade do solo atual (%)
  * @param uv Exposição UV atual (0-100)
- * @param alert_msg Buffer para mensagem de alerta (256 bytes)
+ * @param alert_msg Buffer para o JSON de alertas
+ * @param alert_size Tamanho do buffer (o JSON é truncado para "" se não couber)
  * @return true se tudo está OK, false se há problemas
  */
 bool plant_config_check_parameters(int temp, int humidity, int soil_moisture, 
-                                   int uv, char *alert_msg);
+                                   int uv, char *alert_msg, size_t alert_size);
 
 /**
  * @brief Handler MQTT para receber atualizações de configuração
@@ -67,7 +117,7 @@ void plant_config_mqtt_handler(void *handler_args, esp_event_base_t base,
                                int32_t event_id, void *event_data);
 
 /**
- * @brief Publica configuração atual no MQTT
+ * @brief Publica a configuração completa no shadow (estado reported)
  * @param client Handle do cliente MQTT
  */
 void plant_config_publish(esp_mqtt_client_handle_t client);
@@ -0,0 +1,192 @@
+#include "power_budget.h"
+#include "power_manager.h"
+#include "esp_adc/adc_oneshot.h"
+#include "esp_adc/adc_cali.h"
+#include "esp_adc/adc_cali_scheme.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include <sys/time.h>
+
+static const char *TAG = "POWER_BUDGET";
+
+// Handle ADC compartilhado - declarado externamente
+extern adc_oneshot_unit_handle_t adc1_handle;
+
+// Estado na RTC: filtro e nível continuam após o deep sleep
+static RTC_DATA_ATTR struct {
+    uint16_t filtered_mv;     // 0 = sem leitura ainda
+    power_budget_level_t level;
+    uint16_t trend_mv;        // Tensão no início da janela de tendência
+    int64_t trend_ms;         // Relógio do sistema no início da janela
+    bool charging;
+} rtc_supply;
+
+static adc_cali_handle_t cali_handle = NULL;
+static bool channel_ready = false;
+static int64_t last_read_us = -1;
+static portMUX_TYPE budget_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static int64_t power_budget_now_ms(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+// Nível de log e LEDs seguem a política; a válvula e os períodos consultam na hora
+static void power_budget_apply(const power_budget_policy_t *policy)
+{
+    esp_log_level_set("*", policy->log_verbose ? ESP_LOG_INFO : ESP_LOG_WARN);
+}
+
+esp_err_t power_budget_init(void)
+{
+    ESP_LOGI(TAG, "Inicializando leitura da bateria no GPIO %d", BATTERY_GPIO);
+
+    adc_oneshot_chan_cfg_t config = {
+        .bitwidth = ADC_BITWIDTH_DEFAULT,
+        .atten = ADC_ATTEN_DB_12,
+    };
+    esp_err_t ret = adc_oneshot_config_channel(adc1_handle, ADC_CHANNEL_6, &config);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Falha ao configurar canal da bateria: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    channel_ready = true;
+
+#if ADC_CALI_SCHEME_LINE_FITTING_SUPPORTED
+    // Calibração de fábrica (eFuse): sem ela o erro passa de 100 mV perto de 4 V
+    adc_cali_line_fitting_config_t cali_config = {
+        .unit_id = ADC_UNIT_1,
+        .atten = ADC_ATTEN_DB_12,
+        .bitwidth = ADC_BITWIDTH_DEFAULT,
+    };
+    if (adc_cali_create_scheme_line_fitting(&cali_config, &cali_handle) != ESP_OK) {
+        ESP_LOGW(TAG, "Sem calibração do ADC: conversão linear");
+        cali_handle = NULL;
+    }
+#endif
+
+    power_budget_apply(power_budget_get_policy());
+    power_budget_update();
+    return ESP_OK;
+}
+
+// Média de BATTERY_OVERSAMPLE leituras, em mV na bateria (0 em caso de erro)
+static uint16_t power_budget_read_mv(void)
+{
+    int sum = 0;
+    int count = 0;
+
+    power_manager_lock(POWER_LOCK_ADC);
+    for (int i = 0; i < BATTERY_OVERSAMPLE; i++) {
+        int raw = 0;
+        if (adc_oneshot_read(adc1_handle, ADC_CHANNEL_6, &raw) == ESP_OK) {
+            sum += raw;
+            count++;
+        }
+    }
+    power_manager_unlock(POWER_LOCK_ADC);
+
+    if (count == 0) {
+        return 0;
+    }
+    int raw = sum / count;
+    int pin_mv = 0;
+    if (cali_handle == NULL || adc_cali_raw_to_voltage(cali_handle, raw, &pin_mv) != ESP_OK) {
+        pin_mv = raw * 3300 / 4095;
+    }
+    return (uint16_t)(pin_mv * BATTERY_DIVIDER);
+}
+
+void power_budget_update(void)
+{
+    int64_t now_us = esp_timer_get_time();
+    if (!channel_ready ||
+        (last_read_us >= 0 && now_us - last_read_us < (int64_t)POWER_BUDGET_READ_MIN_MS * 1000)) {
+        return;
+    }
+    last_read_us = now_us;
+
+    uint16_t sample_mv = power_budget_read_mv();
+    if (sample_mv == 0) {
+        ESP_LOGW(TAG, "Falha ao ler a tensão da bateria");
+        return;
+    }
+
+    int64_t now_ms = power_budget_now_ms();
+    power_budget_level_t previous;
+    power_budget_level_t level;
+
+    portENTER_CRITICAL(&budget_mux);
+    rtc_supply.filtered_mv = power_budget_filter_mv(rtc_supply.filtered_mv, sample_mv);
+    uint16_t mv = rtc_supply.filtered_mv;
+    bool present = mv >= POWER_BUDGET_ABSENT_MV;
+
+    // Tendência: compara com o início da janela (nuvens e cargas curtas não contam)
+    if (rtc_supply.trend_ms == 0 || now_ms < rtc_supply.trend_ms) {
+        rtc_supply.trend_mv = mv;
+        rtc_supply.trend_ms = now_ms;
+    } else if (now_ms - rtc_supply.trend_ms >= POWER_BUDGET_TREND_MS) {
+        rtc_supply.charging = present && mv >= rtc_supply.trend_mv + POWER_BUDGET_CHARGE_MV;
+        rtc_supply.trend_mv = mv;
+        rtc_supply.trend_ms = now_ms;
+    }
+
+    previous = rtc_supply.level;
+    level = present ? power_budget_level_for(power_budget_soc_from_mv(mv), previous) : POWER_BUDGET_NORMAL;
+    rtc_supply.level = level;
+    portEXIT_CRITICAL(&budget_mux);
+
+    if (level != previous) {
+        power_budget_apply(power_budget_policy_for(level));
+        ESP_LOGW(TAG, "Alimentação: %s -> %s (%u mV, %u%%)", power_budget_level_name(previous),
+                 power_budget_level_name(level), mv, power_budget_soc_from_mv(mv));
+    } else {
+        ESP_LOGI(TAG, "Bateria: %u mV, %u%%, %s%s", mv, present ? power_budget_soc_from_mv(mv) : 100,
+                 power_budget_level_name(level), rtc_supply.charging ? " (carregando)" : "");
+    }
+}
+
+power_budget_supply_t power_budget_get_supply(void)
+{
+    power_budget_supply_t supply;
+
+    portENTER_CRITICAL(&budget_mux);
+    supply.mv = rtc_supply.filtered_mv;
+    supply.level = rtc_supply.level;
+    supply.charging = rtc_supply.charging;
+    portEXIT_CRITICAL(&budget_mux);
+
+    supply.present = supply.mv >= POWER_BUDGET_ABSENT_MV;
+    supply.soc = supply.present ? power_budget_soc_from_mv(supply.mv) : 100;
+    return supply;
+}
+
+// Sem trava: chamada também de dentro do vprintf dos logs
+const power_budget_policy_t *power_budget_get_policy(void)
+{
+    return power_budget_policy_for(rtc_supply.level);
+}
+
+bool power_budget_allow_valve(bool critical)
+{
+    if (critical || power_budget_get_policy()->manual_valve) {
+        return true;
+    }
+    power_budget_supply_t supply = power_budget_get_supply();
+    ESP_LOGW(TAG, "Abertura manual recusada: bateria na reserva (%u%%)", supply.soc);
+    return false;
+}
+
+void power_budget_write_supply(json_writer_t *w)
+{
+    power_budget_supply_t supply = power_budget_get_supply();
+
+    json_writer_add_int(w, "battery_mv", supply.present ? supply.mv : 0);
+    json_writer_add_int(w, "soc", supply.soc);
+    json_writer_add_bool(w, "charging", supply.charging);
+    json_writer_add_string(w, "supply", supply.present ? power_budget_level_name(supply.level) : "external");
+}
@@ -0,0 +1,72 @@
+#ifndef POWER_BUDGET_H
+#define POWER_BUDGET_H
+
+#include "esp_err.h"
+#include "json_writer.h"
+#include "power_budget_policy.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Orçamento de energia pela carga da bateria (nó solar)
+ *
+ * A tensão da bateria entra no GPIO34 por um divisor 1:2. Cada leitura passa
+ * pela média móvel e vira carga estimada e nível (power_budget_policy.h):
+ *   - save/low/reserve multiplicam a faixa do período adaptativo e o intervalo
+ *     entre envios do deep sleep
+ *   - low/reserve param de piscar os LEDs a cada log; reserve só mostra WARN+
+ *   - reserve recusa aberturas manuais da válvula (irrigação automática segue)
+ * Sem bateria no divisor (leitura < POWER_BUDGET_ABSENT_MV) fica em "normal".
+ */
+
+#define BATTERY_GPIO 34                     // ADC1_CHANNEL_6 - só entrada, livre
+#define BATTERY_DIVIDER 2                   // Divisor 100k/100k: 4,2 V -> 2,1 V no pino
+#define BATTERY_OVERSAMPLE 8                // Leituras somadas por amostra
+#define POWER_BUDGET_READ_MIN_MS 60000      // Intervalo mínimo entre leituras
+#define POWER_BUDGET_TREND_MS (30 * 60 * 1000)   // Janela para detectar carga solar
+#define POWER_BUDGET_CHARGE_MV 20           // Subida na janela que indica carregando
+
+/**
+ * Estado da alimentação
+ */
+typedef struct {
+    bool present;                 // Bateria no divisor
+    uint16_t mv;                  // Tensão filtrada
+    uint8_t soc;                  // Carga estimada (%)
+    bool charging;                // Tensão subindo (painel solar carregando)
+    power_budget_level_t level;
+} power_budget_supply_t;
+
+/**
+ * @brief Configura o canal do ADC e faz a primeira leitura
+ * Chamar depois de criar adc1_handle
+ */
+esp_err_t power_budget_init(void);
+
+/**
+ * @brief Lê a bateria e atualiza o nível (no máximo a cada POWER_BUDGET_READ_MIN_MS)
+ */
+void power_budget_update(void);
+
+/**
+ * @brief Estado atual da alimentação
+ */
+power_budget_supply_t power_budget_get_supply(void);
+
+/**
+ * @brief Política do nível atual
+ */
+const power_budget_policy_t *power_budget_get_policy(void);
+
+/**
+ * @brief Indica se a válvula pode abrir
+ * @param critical true para irrigação automática (solo seco)
+ */
+bool power_budget_allow_valve(bool critical);
+
+/**
+ * @brief Escreve "battery_mv", "soc", "charging" e "supply" (status)
+ */
+void power_budget_write_supply(json_writer_t *w);
+
+#endif // POWER_BUDGET_H
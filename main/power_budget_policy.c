@@ -0,0 +1,83 @@
+#include "power_budget_policy.h"
+
+// Tensão em repouso x carga de uma célula Li-ion (interpolação linear entre pontos)
+static const struct {
+    uint16_t mv;
+    uint8_t soc;
+} soc_curve[] = {
+    {3300, 0},
+    {3500, 5},
+    {3600, 10},
+    {3700, 30},
+    {3750, 45},
+    {3800, 55},
+    {3900, 70},
+    {4000, 80},
+    {4100, 90},
+    {4200, 100},
+};
+
+#define SOC_CURVE_POINTS (sizeof(soc_curve) / sizeof(soc_curve[0]))
+
+// Histerese de 10 pontos: nuvem passando não alterna o nível a cada leitura
+static const power_budget_policy_t policies[POWER_BUDGET_LEVEL_COUNT] = {
+    [POWER_BUDGET_NORMAL]  = {100, 100, 1, 1, true,  true,  true},
+    [POWER_BUDGET_SAVE]    = {40,  50,  2, 2, true,  true,  true},
+    [POWER_BUDGET_LOW]     = {20,  30,  4, 4, false, true,  true},
+    [POWER_BUDGET_RESERVE] = {10,  20,  8, 8, false, false, false},
+};
+
+static const char *const level_names[POWER_BUDGET_LEVEL_COUNT] = {
+    [POWER_BUDGET_NORMAL]  = "normal",
+    [POWER_BUDGET_SAVE]    = "save",
+    [POWER_BUDGET_LOW]     = "low",
+    [POWER_BUDGET_RESERVE] = "reserve",
+};
+
+uint8_t power_budget_soc_from_mv(uint16_t mv)
+{
+    if (mv <= soc_curve[0].mv) {
+        return soc_curve[0].soc;
+    }
+    for (unsigned i = 1; i < SOC_CURVE_POINTS; i++) {
+        if (mv < soc_curve[i].mv) {
+            uint32_t span_mv = soc_curve[i].mv - soc_curve[i - 1].mv;
+            uint32_t span_soc = soc_curve[i].soc - soc_curve[i - 1].soc;
+            return soc_curve[i - 1].soc + (uint8_t)((mv - soc_curve[i - 1].mv) * span_soc / span_mv);
+        }
+    }
+    return soc_curve[SOC_CURVE_POINTS - 1].soc;
+}
+
+uint16_t power_budget_filter_mv(uint16_t filtered_mv, uint16_t sample_mv)
+{
+    if (filtered_mv == 0) {
+        return sample_mv;
+    }
+    int32_t step = ((int32_t)sample_mv - filtered_mv) / (1 << POWER_BUDGET_FILTER_SHIFT);
+    return (uint16_t)(filtered_mv + step);
+}
+
+power_budget_level_t power_budget_level_for(uint8_t soc, power_budget_level_t current)
+{
+    power_budget_level_t level = current < POWER_BUDGET_LEVEL_COUNT ? current : POWER_BUDGET_NORMAL;
+
+    // Desce com a carga abaixo de enter_soc; só sobe com ela em exit_soc ou acima
+    while (level + 1 < POWER_BUDGET_LEVEL_COUNT && soc < policies[level + 1].enter_soc) {
+        level++;
+    }
+    while (level > POWER_BUDGET_NORMAL && soc >= policies[level].exit_soc) {
+        level--;
+    }
+    return level;
+}
+
+const power_budget_policy_t *power_budget_policy_for(power_budget_level_t level)
+{
+    return &policies[level < POWER_BUDGET_LEVEL_COUNT ? level : POWER_BUDGET_NORMAL];
+}
+
+const char *power_budget_level_name(power_budget_level_t level)
+{
+    return level < POWER_BUDGET_LEVEL_COUNT ? level_names[level] : "unknown";
+}
@@ -0,0 +1,61 @@
+#ifndef POWER_BUDGET_POLICY_H
+#define POWER_BUDGET_POLICY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Política do orçamento de energia (C puro, sem ESP-IDF)
+ *
+ * Estimativa de carga a partir da tensão da bateria (1S Li-ion) e níveis com
+ * histerese. Compila também no host: tools/power_budget_sim.py roda estas
+ * funções com curvas de descarga sintéticas.
+ */
+
+#define POWER_BUDGET_ABSENT_MV 2500   // Abaixo disso: sem bateria no divisor (alimentação externa)
+#define POWER_BUDGET_FILTER_SHIFT 3   // Média móvel da tensão (alfa = 1/8): ignora quedas sob carga
+
+typedef enum {
+    POWER_BUDGET_NORMAL,
+    POWER_BUDGET_SAVE,      // Amostragem e envios mais espaçados
+    POWER_BUDGET_LOW,       // Ainda mais espaçados, sem piscar LEDs a cada log
+    POWER_BUDGET_RESERVE,   // Só irrigação automática abre a válvula; logs só WARN+
+    POWER_BUDGET_LEVEL_COUNT
+} power_budget_level_t;
+
+typedef struct {
+    uint8_t enter_soc;        // Entra no nível com carga abaixo disso (%)
+    uint8_t exit_soc;         // Sai para o nível de cima com carga a partir disso (%)
+    uint8_t sampling_scale;   // Multiplica a faixa do período adaptativo
+    uint8_t upload_scale;     // Multiplica DUTY_CYCLE_UPLOAD_EVERY
+    bool log_blink;           // LEDs piscam a cada log
+    bool log_verbose;         // Logs INFO; false = só WARN e ERROR
+    bool manual_valve;        // Aceita abrir a válvula por comando remoto
+} power_budget_policy_t;
+
+/**
+ * @brief Carga estimada (0-100%) pela curva de tensão em repouso
+ */
+uint8_t power_budget_soc_from_mv(uint16_t mv);
+
+/**
+ * @brief Filtra uma nova leitura (mV); filtered_mv 0 = primeira leitura
+ */
+uint16_t power_budget_filter_mv(uint16_t filtered_mv, uint16_t sample_mv);
+
+/**
+ * @brief Próximo nível para a carga atual, com histerese entre níveis vizinhos
+ */
+power_budget_level_t power_budget_level_for(uint8_t soc, power_budget_level_t current);
+
+/**
+ * @brief Política do nível
+ */
+const power_budget_policy_t *power_budget_policy_for(power_budget_level_t level);
+
+/**
+ * @brief Nome do nível ("normal", "save", "low", "reserve")
+ */
+const char *power_budget_level_name(power_budget_level_t level);
+
+#endif // POWER_BUDGET_POLICY_H
@@ -4,37 +4,99 @@
 #include "esp_log.h"
 #include "esp_wifi.h"
 #include "esp_timer.h"
+#include "mqtt_manager.h"
+#include "wifi_manager.h"
+#include "system_commands.h"
+#include "connectivity_manager.h"
+#include "duty_cycle.h"
+#include "soil_watch.h"
+#include "energy_model.h"
+#include "config_store.h"
+#include "esp_attr.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include <string.h>
+#include "freertos/event_groups.h"
 
 static const char *TAG = "POWER_MGR";
 
-// Configuração global
-static power_config_t power_config = {
+// Prazo máximo para as publicações do ciclo serem confirmadas antes do sleep
+#define POWER_DRAIN_TIMEOUT_MS 5000
+
+// Keepalive fixo usado antes do ajuste por período (referência da economia de pings)
+#define POWER_BASELINE_KEEPALIVE_S 120
+
+// Configuração global (na RTC: o modo de deep sleep continua valendo ao acordar)
+static RTC_DATA_ATTR power_config_t power_config = {
     .mode = POWER_MODE_AUTO,
     .enabled = false,
     .sleep_threshold_ms = 600000  // 600 segundos (10 minutos)
 };
 
-// Estatísticas
-static struct {
+// Estatísticas (na RTC para somar os ciclos de deep sleep)
+static RTC_DATA_ATTR struct {
     uint32_t total_sleep_count;
     uint64_t total_sleep_time_ms;
     uint32_t wake_by_timer_count;
+    uint32_t keepalive_pings_saved;  // PINGREQs (acordar o rádio) evitados em relação ao keepalive fixo
+    uint32_t parked_windows;         // Sleeps com a sessão MQTT encerrada
+    uint32_t cycle_timeouts;         // Ciclos fechados por POWER_CYCLE_WAIT_MS sem todos os sensores
+    uint32_t cycle_gather_max_ms;    // Maior espera entre o primeiro e o último sensor do ciclo
+    uint32_t radio_off_windows;      // Sleeps com o WiFi desligado (modo radio_off)
+    uint32_t listen_max_ms;          // Maior janela de escuta antes de desligar o rádio
 } stats = {0};
 
-// Flags de sincronização de publicação dos sensores
+// PINGREQs esperados em um intervalo sem tráfego de saída (um a cada keepalive/2)
+static uint32_t power_manager_expected_pings(uint32_t idle_ms, uint32_t keepalive_s)
+{
+    return keepalive_s > 0 ? idle_ms / (keepalive_s * 500) : 0;
+}
+
+// Locks de PM por rajada: tipo, handle e tempo segurado
+typedef struct {
+    const char *name;
+    esp_pm_lock_type_t type;
+    esp_pm_lock_handle_t handle;   // NULL sem CONFIG_PM_ENABLE: só mede
+    uint32_t depth;                // Retenções aninhadas (uv e soil dividem o ADC)
+    int64_t since_us;
+    power_lock_stats_t stats;
+} power_lock_t;
+
+// CPU_FREQ_MAX também impede o light sleep automático; APB_FREQ_MAX basta para o ADC
+static power_lock_t power_locks[POWER_LOCK_COUNT] = {
+    [POWER_LOCK_DHT11] = {.name = "dht11", .type = ESP_PM_CPU_FREQ_MAX},
+    [POWER_LOCK_TLS]   = {.name = "tls",   .type = ESP_PM_CPU_FREQ_MAX},
+    [POWER_LOCK_ADC]   = {.name = "adc",   .type = ESP_PM_APB_FREQ_MAX},
+};
+static portMUX_TYPE power_locks_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Barreira do ciclo: bit do sensor libera sua task; bit << 4 passa a ela o sleep do ciclo
+#define CYCLE_RELEASE_BIT(mask) (mask)
+#define CYCLE_LEAD_BIT(mask) ((mask) << 4)
+#define CYCLE_ALL_SENSORS ((1 << POWER_SENSOR_COUNT) - 1)
+
+static EventGroupHandle_t cycle_group = NULL;
+static portMUX_TYPE cycle_mux = portMUX_INITIALIZER_UNLOCKED;
 static struct {
-    bool dht11_published;
-    bool uv_published;
-    bool soil_published;
-} publish_flags = {false, false, false};
+    EventBits_t expected;    // Sensores que fecham o ciclo
+    EventBits_t waiting;     // Chegaram e aguardam liberação
+    bool sleeping;           // Um sensor está dormindo pelo ciclo
+    int64_t first_us;        // Chegada do primeiro sensor do ciclo
+} cycle = {.expected = CYCLE_ALL_SENSORS};
+
+static const char *const cycle_sensor_names[POWER_SENSOR_COUNT] = {
+    [POWER_SENSOR_DHT11] = "dht11",
+    [POWER_SENSOR_UV]    = "uv",
+    [POWER_SENSOR_SOIL]  = "soil",
+};
 
 void power_manager_init(void)
 {
     ESP_LOGI(TAG, "Inicializando Power Management...");
     
+    if (cycle_group == NULL) {
+        cycle_group = xEventGroupCreate();
+    }
+    
     // Configura Power Management para permitir light sleep automático
     esp_pm_config_t pm_config = {
         .max_freq_mhz = 240,      // Frequência máxima
@@ -45,6 +107,13 @@ void power_manager_init(void)
     esp_err_t ret = esp_pm_configure(&pm_config);
     if (ret == ESP_OK) {
         ESP_LOGI(TAG, "Power Management configurado (Light Sleep habilitado)");
+        for (int i = 0; i < POWER_LOCK_COUNT; i++) {
+            if (power_locks[i].handle == NULL &&
+                esp_pm_lock_create(power_locks[i].type, 0, power_locks[i].name,
+                                   &power_locks[i].handle) != ESP_OK) {
+                ESP_LOGW(TAG, "Falha ao criar lock de PM %s", power_locks[i].name);
+            }
+        }
     } else {
         ESP_LOGW(TAG, "Falha ao configurar Power Management: %d", ret);
     }
@@ -53,8 +122,7 @@ void power_manager_init(void)
     esp_wifi_set_ps(WIFI_PS_MIN_MODEM);
     
     ESP_LOGI(TAG, "Modo: %s", 
-             power_config.mode == POWER_MODE_AUTO ? "AUTO" :
-             power_config.mode == POWER_MODE_LIGHT_SLEEP ? "LIGHT_SLEEP" : "NORMAL");
+             power_manager_mode_name(power_config.mode));
     ESP_LOGI(TAG, "Sleep threshold: %lu ms", power_config.sleep_threshold_ms);
     ESP_LOGI(TAG, "Estado: %s", power_config.enabled ? "HABILITADO" : "DESABILITADO");
 }
@@ -63,14 +131,70 @@ void power_manager_set_enabled(bool enabled)
 {
     power_config.enabled = enabled;
     ESP_LOGI(TAG, "Power management %s", enabled ? "HABILITADO" : "DESABILITADO");
+    config_store_mark_dirty(CONFIG_STORE_POWER);
 }
 
 void power_manager_set_mode(power_mode_t mode)
 {
     power_config.mode = mode;
-    ESP_LOGI(TAG, "Modo alterado para: %s",
-             mode == POWER_MODE_AUTO ? "AUTO" :
-             mode == POWER_MODE_LIGHT_SLEEP ? "LIGHT_SLEEP" : "NORMAL");
+    ESP_LOGI(TAG, "Modo alterado para: %s", power_manager_mode_name(mode));
+    config_store_mark_dirty(CONFIG_STORE_POWER);
+}
+
+void power_manager_lock(power_lock_id_t id)
+{
+    power_lock_t *lock = &power_locks[id];
+    if (lock->handle != NULL) {
+        esp_pm_lock_acquire(lock->handle);
+    }
+
+    portENTER_CRITICAL(&power_locks_mux);
+    if (lock->depth++ == 0) {
+        lock->since_us = esp_timer_get_time();
+        lock->stats.acquisitions++;
+    }
+    portEXIT_CRITICAL(&power_locks_mux);
+}
+
+void power_manager_unlock(power_lock_id_t id)
+{
+    power_lock_t *lock = &power_locks[id];
+
+    portENTER_CRITICAL(&power_locks_mux);
+    if (lock->depth > 0 && --lock->depth == 0) {
+        uint32_t held_us = (uint32_t)(esp_timer_get_time() - lock->since_us);
+        lock->stats.held_us += held_us;
+        if (held_us > lock->stats.max_us) {
+            lock->stats.max_us = held_us;
+        }
+    }
+    portEXIT_CRITICAL(&power_locks_mux);
+
+    if (lock->handle != NULL) {
+        esp_pm_lock_release(lock->handle);
+    }
+}
+
+power_lock_stats_t power_manager_get_lock_stats(power_lock_id_t id)
+{
+    portENTER_CRITICAL(&power_locks_mux);
+    power_lock_stats_t snapshot = power_locks[id].stats;
+    if (power_locks[id].depth > 0) {
+        snapshot.held_us += esp_timer_get_time() - power_locks[id].since_us;
+    }
+    portEXIT_CRITICAL(&power_locks_mux);
+    return snapshot;
+}
+
+const char *power_manager_mode_name(power_mode_t mode)
+{
+    switch (mode) {
+    case POWER_MODE_LIGHT_SLEEP: return "light_sleep";
+    case POWER_MODE_AUTO:        return "auto";
+    case POWER_MODE_DEEP_SLEEP:  return "deep_sleep";
+    case POWER_MODE_RADIO_OFF:   return "radio_off";
+    default:                     return "normal";
+    }
 }
 
 power_config_t power_manager_get_config(void)
@@ -78,6 +202,14 @@ power_config_t power_manager_get_config(void)
     return power_config;
 }
 
+void power_manager_restore_config(const power_config_t *cfg)
+{
+    if (cfg->mode > POWER_MODE_RADIO_OFF) {
+        return;   // Modo desconhecido: mantém o padrão
+    }
+    power_config = *cfg;
+}
+
 bool power_manager_should_sleep(uint32_t next_read_period_ms)
 {
     if (!power_config.enabled) {
@@ -88,7 +220,8 @@ bool power_manager_should_sleep(uint32_t next_read_period_ms)
         return false;
     }
     
-    if (power_config.mode == POWER_MODE_LIGHT_SLEEP) {
+    if (power_config.mode == POWER_MODE_LIGHT_SLEEP || power_config.mode == POWER_MODE_DEEP_SLEEP ||
+        power_config.mode == POWER_MODE_RADIO_OFF) {
         return true;
     }
     
@@ -96,38 +229,158 @@ bool power_manager_should_sleep(uint32_t next_read_period_ms)
     return next_read_period_ms >= power_config.sleep_threshold_ms;
 }
 
-void power_manager_mark_sensor_published(const char *sensor_name)
+void power_manager_cycle_join(power_sensor_t sensor)
+{
+    portENTER_CRITICAL(&cycle_mux);
+    cycle.expected |= 1 << sensor;
+    portEXIT_CRITICAL(&cycle_mux);
+    ESP_LOGI(TAG, "Ciclo: %s incluído", cycle_sensor_names[sensor]);
+}
+
+void power_manager_cycle_leave(power_sensor_t sensor)
 {
-    if (strcmp(sensor_name, "dht11") == 0) {
-        publish_flags.dht11_published = true;
-        ESP_LOGD(TAG, "DHT11 marcado como publicado");
-    } else if (strcmp(sensor_name, "uv") == 0) {
-        publish_flags.uv_published = true;
-        ESP_LOGD(TAG, "UV marcado como publicado");
-    } else if (strcmp(sensor_name, "soil") == 0) {
-        publish_flags.soil_published = true;
-        ESP_LOGD(TAG, "Soil marcado como publicado");
+    EventBits_t lead = 0;
+
+    portENTER_CRITICAL(&cycle_mux);
+    cycle.expected &= ~(1 << sensor);
+    // Era o único que faltava: o primeiro que aguarda dorme pelo ciclo
+    if (!cycle.sleeping && cycle.waiting != 0 &&
+        (cycle.waiting & cycle.expected) == cycle.expected) {
+        lead = cycle.waiting & -cycle.waiting;
+        cycle.waiting &= ~lead;
+        cycle.sleeping = true;
     }
-    
-    // Log se todos já publicaram
-    if (power_manager_all_sensors_published()) {
-        ESP_LOGI(TAG, "Todos os sensores publicaram - pronto para sleep");
+    portEXIT_CRITICAL(&cycle_mux);
+
+    if (lead != 0) {
+        xEventGroupSetBits(cycle_group, CYCLE_LEAD_BIT(lead));
     }
+    ESP_LOGI(TAG, "Ciclo: %s retirado", cycle_sensor_names[sensor]);
 }
 
-bool power_manager_all_sensors_published(void)
+// Aguarda liberação; retorna true se esta task deve dormir pelo ciclo
+static bool power_manager_cycle_wait(EventBits_t mine)
 {
-    return publish_flags.dht11_published && 
-           publish_flags.uv_published && 
-           publish_flags.soil_published;
+    EventBits_t wait_bits = CYCLE_RELEASE_BIT(mine) | CYCLE_LEAD_BIT(mine);
+    EventBits_t bits = xEventGroupWaitBits(cycle_group, wait_bits, pdTRUE, pdFALSE,
+                                           pdMS_TO_TICKS(POWER_CYCLE_WAIT_MS));
+    if (bits & wait_bits) {
+        return (bits & CYCLE_LEAD_BIT(mine)) != 0;
+    }
+
+    // Prazo esgotado: se ninguém dormiu ainda, fecha o ciclo com quem chegou
+    EventBits_t missing = 0;
+    portENTER_CRITICAL(&cycle_mux);
+    if (!cycle.sleeping && (cycle.waiting & mine)) {
+        missing = cycle.expected & ~cycle.waiting;
+        cycle.waiting &= ~mine;
+        cycle.sleeping = true;
+        stats.cycle_timeouts++;
+    }
+    portEXIT_CRITICAL(&cycle_mux);
+
+    if (missing != 0) {
+        for (int i = 0; i < POWER_SENSOR_COUNT; i++) {
+            if (missing & (1 << i)) {
+                ESP_LOGW(TAG, "Ciclo fechado sem %s após %d ms", cycle_sensor_names[i], POWER_CYCLE_WAIT_MS);
+            }
+        }
+        return true;
+    }
+
+    // Outro sensor já dorme pelo ciclo (ou acabou de liberar esta task)
+    bits = xEventGroupWaitBits(cycle_group, wait_bits, pdTRUE, pdFALSE, portMAX_DELAY);
+    return (bits & CYCLE_LEAD_BIT(mine)) != 0;
 }
 
-void power_manager_reset_publish_flags(void)
+void power_manager_end_cycle(power_sensor_t sensor, uint32_t duration_ms)
 {
-    publish_flags.dht11_published = false;
-    publish_flags.uv_published = false;
-    publish_flags.soil_published = false;
-    ESP_LOGD(TAG, "Flags de publicação resetados");
+    EventBits_t mine = 1 << sensor;
+    bool member = false;
+    bool lead = false;
+    int64_t now_us = esp_timer_get_time();
+    int64_t first_us = now_us;
+
+    if (cycle_group != NULL && power_manager_should_sleep(duration_ms) && duration_ms >= 1000) {
+        portENTER_CRITICAL(&cycle_mux);
+        member = (cycle.expected & mine) != 0;
+        if (member) {
+            if (!cycle.sleeping && cycle.waiting == 0) {
+                cycle.first_us = now_us;
+            }
+            first_us = cycle.first_us;
+            // Último esperado a chegar dorme; atrasado (sleep em andamento) entra no sleep
+            lead = !cycle.sleeping && ((cycle.waiting | mine) & cycle.expected) == cycle.expected;
+            if (lead) {
+                cycle.sleeping = true;
+            } else {
+                cycle.waiting |= mine;
+            }
+        }
+        portEXIT_CRITICAL(&cycle_mux);
+    }
+
+    if (!member) {
+        vTaskDelay(pdMS_TO_TICKS(duration_ms));
+        return;
+    }
+    if (!lead && !power_manager_cycle_wait(mine)) {
+        return;
+    }
+
+    // Janela conta do primeiro sensor: a espera pelos outros sai do sleep
+    uint32_t gather_ms = (esp_timer_get_time() - first_us) / 1000;
+    if (gather_ms > stats.cycle_gather_max_ms) {
+        stats.cycle_gather_max_ms = gather_ms;
+    }
+    ESP_LOGI(TAG, "Ciclo fechado por %s (%lu ms desde o primeiro sensor)",
+             cycle_sensor_names[sensor], gather_ms);
+    power_manager_sleep(duration_ms > gather_ms ? duration_ms - gather_ms : 0);
+
+    // Light sleep: libera quem aguardou (deep sleep não volta aqui)
+    portENTER_CRITICAL(&cycle_mux);
+    EventBits_t release = cycle.waiting;
+    cycle.waiting = 0;
+    cycle.sleeping = false;
+    portEXIT_CRITICAL(&cycle_mux);
+    if (release != 0) {
+        xEventGroupSetBits(cycle_group, CYCLE_RELEASE_BIT(release));
+    }
+}
+
+// Janela de escuta do modo radio_off: cada comando recebido estende a espera
+// (a nuvem manda o próximo logo após o ack). Retorna o tempo gasto (ms)
+static uint32_t power_manager_listen(uint32_t budget_ms)
+{
+    if (!connectivity_manager_is_online()) {
+        return 0;
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    uint32_t max_ms = budget_ms < POWER_LISTEN_MAX_MS ? budget_ms : POWER_LISTEN_MAX_MS;
+    int64_t deadline_us = start_us + (int64_t)max_ms * 1000;
+
+    while (true) {
+        int64_t quiet_us = system_commands_get_stats().last_rx_us;
+        if (quiet_us < start_us) {
+            quiet_us = start_us;
+        }
+        int64_t until_us = quiet_us + (int64_t)POWER_LISTEN_WINDOW_MS * 1000;
+        if (until_us > deadline_us) {
+            until_us = deadline_us;
+        }
+        int64_t now_us = esp_timer_get_time();
+        if (now_us >= until_us) {
+            break;
+        }
+        vTaskDelay(pdMS_TO_TICKS((until_us - now_us) / 1000) + 1);
+    }
+
+    uint32_t listen_ms = (esp_timer_get_time() - start_us) / 1000;
+    if (listen_ms > stats.listen_max_ms) {
+        stats.listen_max_ms = listen_ms;
+    }
+    return listen_ms;
 }
 
 void power_manager_sleep(uint32_t duration_ms)
@@ -138,33 +391,47 @@ void power_manager_sleep(uint32_t duration_ms)
         return;
     }
     
-    // Aguarda até que todos os sensores tenham publicado
-    int wait_count = 0;
-    const int max_wait = 30; // Máximo 15 segundos (30 * 500ms)
-    
-    while (!power_manager_all_sensors_published() && wait_count < max_wait) {
-        ESP_LOGI(TAG, "Aguardando sensores publicarem... (DHT11:%d UV:%d Soil:%d)",
-                 publish_flags.dht11_published,
-                 publish_flags.uv_published,
-                 publish_flags.soil_published);
-        vTaskDelay(pdMS_TO_TICKS(500));
-        wait_count++;
+    // Amostras guardadas na RTC saem junto com as leituras desta janela
+    bool deep = power_config.mode == POWER_MODE_DEEP_SLEEP;
+    if (deep) {
+        duty_cycle_publish_batch();
     }
+    energy_model_publish_if_due();
+    
+    // Dorme assim que as filas esvaziam e todos os PUBACKs chegam
+    int64_t drain_start = esp_timer_get_time();
+    bool drained = mqtt_manager_wait_all_published(POWER_DRAIN_TIMEOUT_MS);
+    uint32_t drain_ms = (esp_timer_get_time() - drain_start) / 1000;
     
-    if (!power_manager_all_sensors_published()) {
-        ESP_LOGW(TAG, "Timeout aguardando sensores - entrando em sleep mesmo assim");
+    if (drained) {
+        ESP_LOGI(TAG, "Publicações confirmadas em %lu ms", drain_ms);
     } else {
-        ESP_LOGI(TAG, "Todos sensores prontos - iniciando sleep");
+        ESP_LOGW(TAG, "Prazo de %d ms esgotado com %lu publicação(ões) pendente(s)",
+                 POWER_DRAIN_TIMEOUT_MS, mqtt_manager_get_outbound_stats().pending);
     }
     
-    // Aguarda um pouco para garantir que as mensagens MQTT foram enviadas
-    vTaskDelay(pdMS_TO_TICKS(1000));
+    // Desconta o tempo gasto aguardando as confirmações
+    uint32_t adjusted_duration_ms = duration_ms > drain_ms ? duration_ms - drain_ms : 0;
     
-    // Reseta flags para o próximo ciclo ANTES de dormir
-    power_manager_reset_publish_flags();
+    if (deep) {
+        // Sem confirmação o lote fica na RTC e vai de novo na próxima janela
+        if (drained) {
+            duty_cycle_ack_batch();
+        }
+        mqtt_manager_shutdown(adjusted_duration_ms);
+        stats.total_sleep_count++;
+        stats.total_sleep_time_ms += adjusted_duration_ms;
+        stats.wake_by_timer_count++;
+        duty_cycle_deep_sleep(adjusted_duration_ms);
+        return;
+    }
     
-    // Ajusta duração para compensar o delay de 1s
-    uint32_t adjusted_duration_ms = duration_ms > 1000 ? duration_ms - 1000 : duration_ms;
+    // Rádio vai desligar: antes, escuta comandos pendentes da nuvem
+    bool radio_off = power_config.mode == POWER_MODE_RADIO_OFF;
+    if (radio_off) {
+        uint32_t listen_ms = power_manager_listen(adjusted_duration_ms);
+        adjusted_duration_ms = adjusted_duration_ms > listen_ms ? adjusted_duration_ms - listen_ms : 0;
+    }
     
     // Calcula tempo de sleep em microssegundos
     uint64_t sleep_time_us = (uint64_t)adjusted_duration_ms * 1000;
@@ -178,23 +445,52 @@ void power_manager_sleep(uint32_t duration_ms)
     // Para receber MQTT, usa vTaskDelay em vez de esp_light_sleep_start
     // O ESP-IDF já gerencia economia com esp_pm_configure
     
+    // Período longo demais para o keepalive: encerra a sessão até a próxima janela
+    // No modo radio_off encerra sempre e desliga o WiFi (reassocia pelo BSSID em cache)
+    bool parked;
+    if (radio_off) {
+        parked = mqtt_manager_shutdown(adjusted_duration_ms);
+        radio_off = wifi_manager_radio_off() == ESP_OK;
+    } else {
+        parked = mqtt_manager_park(adjusted_duration_ms);
+    }
+    
     // Registra início do sleep
     int64_t sleep_start = esp_timer_get_time();
     
     // USA DELAY COM POWER MANAGEMENT AUTOMÁTICO
-    // O WiFi permanece ativo e pode receber MQTT
+    // O WiFi permanece ativo e pode receber MQTT (exceto no modo radio_off)
     vTaskDelay(pdMS_TO_TICKS(adjusted_duration_ms));
     
     // Calcula tempo real em idle
     int64_t sleep_end = esp_timer_get_time();
     uint32_t actual_sleep_ms = (sleep_end - sleep_start) / 1000;
     
+    // Início da janela: a sessão encerrada volta agora, não em um horário aleatório
+    if (radio_off) {
+        wifi_manager_radio_on();
+        stats.radio_off_windows++;
+    }
+    mqtt_manager_unpark();
+    
+    // Pings evitados: keepalive fixo versus o keepalive atual (ou nenhum com a sessão encerrada)
+    uint32_t baseline_pings = power_manager_expected_pings(actual_sleep_ms, POWER_BASELINE_KEEPALIVE_S);
+    uint32_t pings = parked ? 0 : power_manager_expected_pings(actual_sleep_ms,
+                                                               mqtt_manager_get_keepalive_s());
+    if (baseline_pings > pings) {
+        stats.keepalive_pings_saved += baseline_pings - pings;
+    }
+    if (parked) {
+        stats.parked_windows++;
+    }
+    
     // Atualiza estatísticas
     stats.total_sleep_count++;
     stats.total_sleep_time_ms += actual_sleep_ms;
     stats.wake_by_timer_count++; // Com vTaskDelay sempre acorda por timer
     
-    ESP_LOGI(TAG, "Periodo de economia concluido (%lu ms) - WiFi ativo durante todo tempo", actual_sleep_ms);
+    ESP_LOGI(TAG, "Periodo de economia concluido (%lu ms) - %s", actual_sleep_ms,
+             radio_off ? "WiFi desligado" : "WiFi ativo durante todo tempo");
 }
 
 void power_manager_report_stats(void)
@@ -203,12 +499,64 @@ void power_manager_report_stats(void)
     ESP_LOGI(TAG, "     ESTATÍSTICAS DE ECONOMIA DE ENERGIA");
     ESP_LOGI(TAG, "════════════════════════════════════════");
     ESP_LOGI(TAG, "Total de sleeps: %lu", stats.total_sleep_count);
-    ESP_LOGI(TAG, "Tempo total dormindo: %llu ms (%.2f min)", 
+    ESP_LOGI(TAG, "Tempo total dormindo: %llu ms (%llu min)", 
              stats.total_sleep_time_ms, 
-             stats.total_sleep_time_ms / 60000.0);
+             stats.total_sleep_time_ms / 60000);
     ESP_LOGI(TAG, "Wake-ups por timer: %lu", stats.wake_by_timer_count);
     ESP_LOGI(TAG, "Wake-ups por evento: %lu", 
              stats.total_sleep_count - stats.wake_by_timer_count);
+    ESP_LOGI(TAG, "Keepalive MQTT: %u s", mqtt_manager_get_keepalive_s());
+    ESP_LOGI(TAG, "Pings evitados: %lu", stats.keepalive_pings_saved);
+    ESP_LOGI(TAG, "Janelas com sessão encerrada: %lu", stats.parked_windows);
+    ESP_LOGI(TAG, "Ciclos fechados por prazo: %lu  maior espera entre sensores: %lu ms",
+             stats.cycle_timeouts, stats.cycle_gather_max_ms);
+    
+    wifi_manager_stats_t wifi = wifi_manager_get_stats();
+    ESP_LOGI(TAG, "Janelas com rádio desligado: %lu  maior escuta: %lu ms",
+             stats.radio_off_windows, stats.listen_max_ms);
+    ESP_LOGI(TAG, "WiFi: %lu desligamentos, último ligado %lu ms, associação %lu ms (máx %lu ms)",
+             wifi.radio_cycles, wifi.last_radio_on_ms, wifi.last_assoc_ms, wifi.max_assoc_ms);
+    ESP_LOGI(TAG, "BSSID em cache: %lu acertos, %lu falhas", wifi.cache_hits, wifi.cache_misses);
+    ESP_LOGI(TAG, "Associação -> IP: %lu ms (máx %lu ms, %s), concessão reaproveitada %lu vezes, "
+             "volta ao DHCP %lu", wifi.last_ip_ms, wifi.max_ip_ms, wifi_manager_ip_mode_name(),
+             wifi.lease_reused, wifi.dhcp_fallbacks);
+    
+    // Tempo em que cada rajada prendeu a frequência máxima (o resto pode cair para 80 MHz/sleep)
+    uint64_t uptime_us = esp_timer_get_time();
+    uint64_t locked_us = 0;
+    for (int i = 0; i < POWER_LOCK_COUNT; i++) {
+        power_lock_stats_t lock = power_manager_get_lock_stats(i);
+        uint32_t permille = uptime_us > 0 ? (uint32_t)(lock.held_us * 1000 / uptime_us) : 0;
+        locked_us += lock.held_us;
+        ESP_LOGI(TAG, "Lock %s: %lu retenções, %llu ms (%lu.%lu%% do tempo), máx %lu us",
+                 power_locks[i].name, lock.acquisitions, lock.held_us / 1000,
+                 permille / 10, permille % 10, lock.max_us);
+    }
+    if (uptime_us > locked_us) {
+        uint32_t free_permille = (uint32_t)((uptime_us - locked_us) * 1000 / uptime_us);
+        ESP_LOGI(TAG, "Livre para 80 MHz/light sleep (fora destes locks): %lu.%lu%%",
+                 free_permille / 10, free_permille % 10);
+    }
+    
+    energy_report_t energy = energy_model_get_report();
+    ESP_LOGI(TAG, "Consumo estimado: %lu uA médios, %lu.%02lu mAh/dia",
+             energy.avg_ua, energy.mah_per_day_x100 / 100, energy.mah_per_day_x100 % 100);
+    
+    duty_cycle_stats_t duty = duty_cycle_get_stats();
+    if (duty.wakes > 0) {
+        uint32_t permille = duty_cycle_awake_permille();
+        ESP_LOGI(TAG, "Deep sleep: %lu despertares (%lu só amostragem, %lu pelo ULP), %lu lotes enviados",
+                 duty.wakes, duty.sample_wakes, duty.ulp_wakes, duty.uploads);
+        ESP_LOGI(TAG, "Tempo acordado: %lu.%lu%% (%llu ms acordado, %llu ms dormindo)",
+                 permille / 10, permille % 10, duty.awake_ms, duty.asleep_ms);
+        ESP_LOGI(TAG, "Janelas sem conexão: %lu  amostras perdidas: %lu",
+                 duty.failed_windows, duty.samples_lost);
+        soil_watch_report_t watch = soil_watch_get_report();
+        if (watch.valid) {
+            ESP_LOGI(TAG, "ULP no último sleep: %u leitura(s) do solo, faixa %u..%u%s",
+                     watch.samples, watch.min_raw, watch.max_raw, watch.woke ? ", acordou pelo limiar" : "");
+        }
+    }
     
     if (stats.total_sleep_count > 0) {
         uint32_t avg_sleep_ms = stats.total_sleep_time_ms / stats.total_sleep_count;
@@ -216,8 +564,7 @@ void power_manager_report_stats(void)
     }
     
     ESP_LOGI(TAG, "Modo atual: %s", 
-             power_config.mode == POWER_MODE_AUTO ? "AUTO" :
-             power_config.mode == POWER_MODE_LIGHT_SLEEP ? "LIGHT_SLEEP" : "NORMAL");
+             power_manager_mode_name(power_config.mode));
     ESP_LOGI(TAG, "Estado: %s", power_config.enabled ? "HABILITADO" : "DESABILITADO");
     ESP_LOGI(TAG, "════════════════════════════════════════");
 }
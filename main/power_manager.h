@@ -10,7 +10,9 @@
 typedef enum {
     POWER_MODE_NORMAL,      // Modo normal (sem economia)
     POWER_MODE_LIGHT_SLEEP, // Light sleep (WiFi ativo, acorda por timer/MQTT)
-    POWER_MODE_AUTO         // Automático (decide baseado no período de leitura)
+    POWER_MODE_AUTO,        // Automático (decide baseado no período de leitura)
+    POWER_MODE_DEEP_SLEEP,  // Deep sleep entre janelas (duty_cycle: estado na RTC, sem MQTT entre janelas)
+    POWER_MODE_RADIO_OFF    // Light sleep com o WiFi desligado entre janelas (escuta comandos no fim de cada janela)
 } power_mode_t;
 
 /**
@@ -23,7 +25,46 @@ typedef struct {
 } power_config_t;
 
 /**
- * Inicializa o power management
+ * Sensores que dividem o ciclo de sleep
+ */
+typedef enum {
+    POWER_SENSOR_DHT11,
+    POWER_SENSOR_UV,
+    POWER_SENSOR_SOIL,
+    POWER_SENSOR_COUNT
+} power_sensor_t;
+
+// Prazo para os sensores esperados chegarem ao fim do ciclo (DHT11 com 3 tentativas,
+// irrigação automática de 10 s); depois o ciclo fecha com quem chegou
+#define POWER_CYCLE_WAIT_MS 20000
+
+// Modo radio_off: fica online até passar POWER_LISTEN_WINDOW_MS sem comandos
+// (no máximo POWER_LISTEN_MAX_MS) antes de desligar o rádio
+#define POWER_LISTEN_WINDOW_MS 5000
+#define POWER_LISTEN_MAX_MS 15000
+
+/**
+ * Locks de PM em torno de rajadas sensíveis a tempo
+ * Fora deles a CPU cai para min_freq_mhz e o idle entra em light sleep automático
+ */
+typedef enum {
+    POWER_LOCK_DHT11,   // Decodificação do DHT11 (temporização por ets_delay_us)
+    POWER_LOCK_TLS,     // Handshake TLS (criptografia assimétrica)
+    POWER_LOCK_ADC,     // Leituras do ADC (clock do SAR vem do APB)
+    POWER_LOCK_COUNT
+} power_lock_id_t;
+
+/**
+ * Retenção de um lock desde o boot
+ */
+typedef struct {
+    uint32_t acquisitions;   // Retenções (aninhadas contam uma vez)
+    uint64_t held_us;        // Tempo total segurado
+    uint32_t max_us;         // Maior retenção
+} power_lock_stats_t;
+
+/**
+ * Inicializa o power management (após o WiFi, antes do MQTT)
  */
 void power_manager_init(void);
 
@@ -42,9 +83,16 @@ void power_manager_set_mode(power_mode_t mode);
  */
 power_config_t power_manager_get_config(void);
 
+/**
+ * Substitui a configuração pela salva na NVS (boot, antes de power_manager_init)
+ */
+void power_manager_restore_config(const power_config_t *cfg);
+
 /**
  * Entra em sleep por um período (ms)
  * Retorna quando acordar (por timer ou evento externo)
+ * Em POWER_MODE_DEEP_SLEEP não retorna: o despertar reinicia pelo app_main
+ * As tasks dos sensores usam power_manager_end_cycle, que chama esta uma vez por ciclo
  */
 void power_manager_sleep(uint32_t duration_ms);
 
@@ -54,20 +102,35 @@ void power_manager_sleep(uint32_t duration_ms);
 bool power_manager_should_sleep(uint32_t next_read_period_ms);
 
 /**
- * Marca que um sensor publicou seus dados
- * @param sensor_name Nome do sensor ("dht11", "uv", "soil")
+ * Inclui/retira o sensor do conjunto esperado a cada ciclo (todos começam incluídos)
+ * Retirar o último que faltava fecha o ciclo na hora
+ */
+void power_manager_cycle_join(power_sensor_t sensor);
+void power_manager_cycle_leave(power_sensor_t sensor);
+
+/**
+ * Fim do ciclo do sensor: bloqueia até a próxima janela
+ * Com economia de energia é uma barreira: o último sensor esperado a chegar dorme
+ * por todos (power_manager_sleep) e libera os outros ao acordar; quem chega durante
+ * o sleep entra nele. Sem economia, ou fora do conjunto esperado, é um vTaskDelay
+ */
+void power_manager_end_cycle(power_sensor_t sensor, uint32_t duration_ms);
+
+/**
+ * Segura/libera um lock de PM (aninhável; sem PM só mede o tempo)
  */
-void power_manager_mark_sensor_published(const char *sensor_name);
+void power_manager_lock(power_lock_id_t id);
+void power_manager_unlock(power_lock_id_t id);
 
 /**
- * Verifica se todos os sensores já publicaram neste ciclo
+ * Obtém a retenção de um lock (inclui a retenção em andamento)
  */
-bool power_manager_all_sensors_published(void);
+power_lock_stats_t power_manager_get_lock_stats(power_lock_id_t id);
 
 /**
- * Reseta os flags de publicação para o próximo ciclo
+ * Nome do modo ("normal", "light_sleep", "auto", "deep_sleep", "radio_off")
  */
-void power_manager_reset_publish_flags(void);
+const char *power_manager_mode_name(power_mode_t mode);
 
 /**
  * Reporta estatísticas de economia de energia
@@ -0,0 +1,226 @@
+#include "sampling_governor.h"
+#include "system_commands.h"
+#include "plant_config.h"
+#include "solenoid.h"
+#include "mqtt_manager.h"
+#include "day_night_control.h"
+#include "power_budget.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include <stdlib.h>
+#include <sys/time.h>
+
+static const char *TAG = "SAMPLING_GOV";
+
+// Limiares por sensor, na unidade do valor (°C ou %)
+typedef struct {
+    const char *name;
+    int fast_delta;       // Variação entre leituras que reduz o período
+    int flat_delta_x16;   // Média da variação (x16) abaixo disso = estável
+    int near_margin;      // Distância de um limite da planta que reduz o período
+} sampling_params_t;
+
+static const sampling_params_t sampling_params[SAMPLING_SENSOR_COUNT] = {
+    [SAMPLING_DHT11] = {"dht11", 2,  8, 2},
+    [SAMPLING_UV]    = {"uv",    10, 32, 5},
+    [SAMPLING_SOIL]  = {"soil",  5,  16, 5},
+};
+
+// Estado por sensor (na RTC: filtros e períodos continuam após o deep sleep)
+typedef struct {
+    uint32_t period_ms;
+    int64_t last_ms;       // Relógio do sistema na última leitura (0 = nunca)
+    int last_value;
+    int32_t delta_x16;     // Média móvel de |variação| (x16, alfa = 1/4)
+    bool has_value;
+} sampling_state_t;
+
+static RTC_DATA_ATTR sampling_state_t sensors[SAMPLING_SENSOR_COUNT];
+static RTC_DATA_ATTR bool governor_ready = false;
+static RTC_DATA_ATTR uint32_t planned_window_ms = 0;   // Último valor entregue ao mqtt_manager
+static portMUX_TYPE governor_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Relógio de parede: segue no deep sleep (esp_timer recomeça a cada boot)
+static int64_t sampling_governor_now_ms(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+// Faixa efetiva: o período base sempre cabe nela; bateria baixa multiplica a faixa
+static void sampling_governor_range(uint32_t *lo, uint32_t *hi)
+{
+    uint32_t scale = power_budget_get_policy()->sampling_scale;
+    system_config_t cfg = system_commands_get_config();
+    uint32_t base = (uint32_t)system_commands_get_read_period_ms();
+    *lo = (uint32_t)cfg.period_min_minutes * 60000;
+    *hi = (uint32_t)cfg.period_max_minutes * 60000;
+    if (*lo > base) {
+        *lo = base;
+    }
+    if (*hi < base) {
+        *hi = base;
+    }
+    *lo *= scale;
+    *hi *= scale;
+}
+
+static bool sampling_governor_active(sampling_sensor_t sensor)
+{
+    return !(sensor == SAMPLING_UV && is_night_time());
+}
+
+// Janela = menor período entre os sensores ativos; o keepalive acompanha
+static uint32_t sampling_governor_min_period(void)
+{
+    uint32_t window = UINT32_MAX;
+    for (int i = 0; i < SAMPLING_SENSOR_COUNT; i++) {
+        if (sampling_governor_active(i) && sensors[i].period_ms < window) {
+            window = sensors[i].period_ms;
+        }
+    }
+    return window;
+}
+
+static void sampling_governor_plan(void)
+{
+    uint32_t window = sampling_governor_min_period();
+    if (window != planned_window_ms) {
+        planned_window_ms = window;
+        mqtt_manager_plan_windows(window);
+    }
+}
+
+void sampling_governor_reset(void)
+{
+    uint32_t base = (uint32_t)system_commands_get_read_period_ms();
+
+    portENTER_CRITICAL(&governor_mux);
+    for (int i = 0; i < SAMPLING_SENSOR_COUNT; i++) {
+        sensors[i].period_ms = base;
+    }
+    governor_ready = true;
+    planned_window_ms = base;
+    portEXIT_CRITICAL(&governor_mux);
+
+    mqtt_manager_plan_windows(base);
+    ESP_LOGI(TAG, "Períodos reiniciados em %lu s", (unsigned long)(base / 1000));
+}
+
+static void sampling_governor_ensure_ready(void)
+{
+    if (!governor_ready) {
+        sampling_governor_reset();
+    }
+}
+
+bool sampling_governor_is_due(sampling_sensor_t sensor)
+{
+    sampling_governor_ensure_ready();
+    if (!sampling_governor_active(sensor)) {
+        return false;
+    }
+
+    int64_t now_ms = sampling_governor_now_ms();
+    portENTER_CRITICAL(&governor_mux);
+    const sampling_state_t *st = &sensors[sensor];
+    // Meia janela de folga: as tasks acordam juntas, com alguns ms de diferença
+    bool due = st->last_ms == 0 || now_ms < st->last_ms ||
+               now_ms - st->last_ms + sampling_governor_min_period() / 2 >= st->period_ms;
+    portEXIT_CRITICAL(&governor_mux);
+    return due;
+}
+
+// Valor perto de um limite da planta (ou fora da faixa)
+static bool sampling_governor_near(sampling_sensor_t sensor, int value)
+{
+    const plant_config_t *plant = plant_config_get();
+    int margin = sampling_params[sensor].near_margin;
+
+    switch (sensor) {
+    case SAMPLING_DHT11:
+        return value <= plant->temperature_min + margin || value >= plant->temperature_max - margin;
+    case SAMPLING_UV:
+        return value <= plant->uv_min + margin || value >= plant->uv_max - margin;
+    case SAMPLING_SOIL:
+        return value <= plant->soil_moisture_min - plant->irrigation_threshold + margin;
+    default:
+        return false;
+    }
+}
+
+void sampling_governor_update(sampling_sensor_t sensor, int value)
+{
+    sampling_governor_ensure_ready();
+
+    const sampling_params_t *params = &sampling_params[sensor];
+    uint32_t lo, hi;
+    sampling_governor_range(&lo, &hi);
+    bool near = sampling_governor_near(sensor, value);
+    bool irrigating = sensor == SAMPLING_SOIL &&
+                      (solenoid_get_state() || plant_config_is_dry(value));
+    bool night = is_night_time();
+    int64_t now_ms = sampling_governor_now_ms();
+
+    portENTER_CRITICAL(&governor_mux);
+    sampling_state_t *st = &sensors[sensor];
+    int delta = st->has_value ? abs(value - st->last_value) : 0;
+    st->delta_x16 += (delta * 16 - st->delta_x16) / 4;
+    bool fast = st->has_value && delta >= params->fast_delta;
+    bool flat = st->has_value && st->delta_x16 < params->flat_delta_x16;
+
+    uint32_t previous = st->period_ms;
+    uint32_t period = previous;
+    if (irrigating) {
+        period = lo;
+    } else if (fast || near) {
+        period /= 2;
+    } else if (flat || night) {
+        period += period / 2;
+    }
+    if (period < lo) {
+        period = lo;
+    } else if (period > hi) {
+        period = hi;
+    }
+
+    st->period_ms = period;
+    st->last_ms = now_ms;
+    st->last_value = value;
+    st->has_value = true;
+    portEXIT_CRITICAL(&governor_mux);
+
+    if (period != previous) {
+        ESP_LOGI(TAG, "%s: período %lu -> %lu s (%s)", params->name,
+                 (unsigned long)(previous / 1000), (unsigned long)(period / 1000),
+                 irrigating ? "irrigação" : fast ? "variação rápida" : near ? "perto do limite" :
+                 night ? "noite" : "estável");
+    }
+    sampling_governor_plan();
+}
+
+uint32_t sampling_governor_get_period_ms(sampling_sensor_t sensor)
+{
+    sampling_governor_ensure_ready();
+    return sensors[sensor].period_ms;
+}
+
+uint32_t sampling_governor_window_ms(void)
+{
+    sampling_governor_ensure_ready();
+    portENTER_CRITICAL(&governor_mux);
+    uint32_t window = sampling_governor_min_period();
+    portEXIT_CRITICAL(&governor_mux);
+    return window;
+}
+
+void sampling_governor_write_periods(json_writer_t *w)
+{
+    json_writer_begin_array(w, "period_s");
+    for (int i = 0; i < SAMPLING_SENSOR_COUNT; i++) {
+        json_writer_add_int(w, NULL, sampling_governor_get_period_ms(i) / 1000);
+    }
+    json_writer_end_array(w);
+}
@@ -0,0 +1,62 @@
+#ifndef SAMPLING_GOVERNOR_H
+#define SAMPLING_GOVERNOR_H
+
+#include "json_writer.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Período de amostragem adaptativo por sensor
+ *
+ * Cada sensor tem seu período entre period_min_minutes e period_max_minutes
+ * (system_config; read_period_minutes é o ponto de partida e sempre fica na faixa):
+ *   - cai pela metade com variação rápida, valor perto de um limite da planta
+ *     ou irrigação em andamento (solo vai direto ao mínimo)
+ *   - cresce 50% com valores estáveis (média móvel da variação) ou à noite
+ *     (UV não é lido à noite)
+ *
+ * As tasks dormem juntas pela janela (menor período entre os sensores ativos)
+ * e só leem os sensores vencidos; com todos estáveis a janela cresce e o
+ * dispositivo acorda menos. O estado fica na RTC (filtros continuam após o deep sleep).
+ */
+
+typedef enum {
+    SAMPLING_DHT11,   // Temperatura (°C); umidade vem na mesma leitura
+    SAMPLING_UV,      // UV (% da escala do ADC)
+    SAMPLING_SOIL,    // Umidade do solo (%)
+    SAMPLING_SENSOR_COUNT
+} sampling_sensor_t;
+
+/**
+ * @brief Volta todos os sensores ao período base (read_period_minutes)
+ * Chamar quando o período base ou a faixa mudar
+ */
+void sampling_governor_reset(void);
+
+/**
+ * @brief Indica se o sensor deve ser lido nesta janela
+ */
+bool sampling_governor_is_due(sampling_sensor_t sensor);
+
+/**
+ * @brief Registra uma leitura e ajusta o período do sensor
+ * @param value °C (DHT11) ou % (UV, solo)
+ */
+void sampling_governor_update(sampling_sensor_t sensor, int value);
+
+/**
+ * @brief Período atual do sensor (ms)
+ */
+uint32_t sampling_governor_get_period_ms(sampling_sensor_t sensor);
+
+/**
+ * @brief Espera entre janelas: menor período entre os sensores ativos (ms)
+ */
+uint32_t sampling_governor_window_ms(void);
+
+/**
+ * @brief Escreve "period_s":[dht11,uv,solo] (status)
+ */
+void sampling_governor_write_periods(json_writer_t *w);
+
+#endif // SAMPLING_GOVERNOR_H
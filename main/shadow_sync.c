@@ -0,0 +1,320 @@
+#include "shadow_sync.h"
+#include "plant_config.h"
+#include "system_commands.h"
+#include "mqtt_manager.h"
+#include "json_parser.h"
+#include "json_writer.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "SHADOW_SYNC";
+
+// Tópicos montados em shadow_sync_init (vida estática para mqtt_manager_publish)
+static char topic_update[SHADOW_TOPIC_MAX_LEN];
+static char topic_delta[SHADOW_TOPIC_MAX_LEN];
+static char topic_get[SHADOW_TOPIC_MAX_LEN];
+static char topic_get_accepted[SHADOW_TOPIC_MAX_LEN];
+static char topic_get_rejected[SHADOW_TOPIC_MAX_LEN];
+
+static SemaphoreHandle_t shadow_mutex = NULL;
+
+// Último estado reportado ao shadow (base para enviar só as diferenças)
+static plant_config_t reported_plant;
+static system_config_t reported_system;
+static bool reported_valid = false;
+
+// Tokens e buffer em memória estática: get/accepted não cabe na pilha da task MQTT
+static json_token_t tokens[SHADOW_MAX_TOKENS];
+static char report_buf[SHADOW_REPORT_MAX];
+
+static shadow_sync_stats_t stats = {0};
+
+esp_err_t shadow_sync_init(const char *thing_name)
+{
+    int n = snprintf(topic_update, sizeof(topic_update), "$aws/things/%s/shadow/update", thing_name);
+    if (n < 0 || n + (int)strlen("/delta") >= SHADOW_TOPIC_MAX_LEN) {
+        ESP_LOGE(TAG, "Nome do thing muito longo: %s", thing_name);
+        topic_update[0] = '\0';
+        return ESP_ERR_INVALID_SIZE;
+    }
+    snprintf(topic_delta, sizeof(topic_delta), "$aws/things/%s/shadow/update/delta", thing_name);
+    snprintf(topic_get, sizeof(topic_get), "$aws/things/%s/shadow/get", thing_name);
+    snprintf(topic_get_accepted, sizeof(topic_get_accepted), "$aws/things/%s/shadow/get/accepted", thing_name);
+    snprintf(topic_get_rejected, sizeof(topic_get_rejected), "$aws/things/%s/shadow/get/rejected", thing_name);
+
+    if (shadow_mutex == NULL) {
+        shadow_mutex = xSemaphoreCreateMutex();
+    }
+
+    ESP_LOGI(TAG, "Shadow: %s", topic_update);
+    return ESP_OK;
+}
+
+void shadow_sync_subscribe(esp_mqtt_client_handle_t client)
+{
+    if (client == NULL || topic_update[0] == '\0') {
+        return;
+    }
+
+    esp_mqtt_client_subscribe(client, topic_delta, 1);
+    esp_mqtt_client_subscribe(client, topic_get_accepted, 1);
+    esp_mqtt_client_subscribe(client, topic_get_rejected, 1);
+
+    // Resposta em get/accepted (ou get/rejected se o shadow não existir)
+    esp_err_t pub = mqtt_manager_publish(topic_get, "{}", 2);
+    ESP_LOGI(TAG, "Pedido do documento do shadow: %s", esp_err_to_name(pub));
+}
+
+esp_err_t shadow_sync_report(bool full)
+{
+    if (shadow_mutex == NULL || topic_update[0] == '\0') {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(shadow_mutex, portMAX_DELAY);
+
+    bool send_all = full || !reported_valid;
+    json_writer_t w;
+    json_writer_init(&w, report_buf, sizeof(report_buf));
+    json_writer_begin_object(&w, NULL);
+    json_writer_begin_object(&w, "state");
+    json_writer_begin_object(&w, "reported");
+    int written = plant_config_write_fields(&w, send_all ? NULL : &reported_plant);
+    written += system_commands_write_fields(&w, send_all ? NULL : &reported_system);
+    json_writer_end_object(&w);
+    json_writer_end_object(&w);
+    json_writer_end_object(&w);
+    size_t len = json_writer_finish(&w);
+
+    esp_err_t err = ESP_OK;
+    if (written == 0) {
+        stats.reports_skipped++;
+    } else if (len == 0) {
+        ESP_LOGE(TAG, "Report excede o buffer de %d bytes", (int)sizeof(report_buf));
+        err = ESP_ERR_INVALID_SIZE;
+    } else {
+        err = mqtt_manager_publish(topic_update, report_buf, len);
+        if (err == ESP_OK) {
+            reported_plant = *plant_config_get();
+            reported_system = system_commands_get_config();
+            reported_valid = true;
+            stats.reports++;
+            stats.fields_reported += written;
+            ESP_LOGI(TAG, "Reported: %d campo(s), %d bytes", written, (int)len);
+        } else {
+            ESP_LOGW(TAG, "Falha ao publicar reported: %s", esp_err_to_name(err));
+        }
+    }
+
+    xSemaphoreGive(shadow_mutex);
+    return err;
+}
+
+// "version" do shadow (pode passar do limite de json_token_to_int)
+static bool shadow_sync_token_to_u32(const char *js, const json_token_t *tok, uint32_t *out)
+{
+    if (tok->type != JSON_TOKEN_PRIMITIVE || tok->end == tok->start) {
+        return false;
+    }
+
+    uint32_t value = 0;
+    for (size_t i = tok->start; i < tok->end; i++) {
+        if (js[i] < '0' || js[i] > '9' || value > (UINT32_MAX - 9) / 10) {
+            return false;
+        }
+        value = value * 10 + (uint32_t)(js[i] - '0');
+    }
+    *out = value;
+    return true;
+}
+
+// Carrega os pares de um objeto do shadow nas cópias plant/sys
+static int shadow_sync_load(const char *js, int count, int obj,
+                            plant_config_t *plant, system_config_t *sys)
+{
+    int loaded = 0;
+    int i = obj + 1;
+
+    for (int pair = 0; pair < tokens[obj].size / 2 && i + 1 < count; pair++) {
+        if (plant_config_set_field(plant, js, &tokens[i], &tokens[i + 1]) ||
+            system_commands_set_field(sys, js, &tokens[i], &tokens[i + 1])) {
+            loaded++;
+        }
+        i = json_next(tokens, count, i + 1);
+    }
+    return loaded;
+}
+
+// Prepara os campos desejados como CONFIG_UPDATE: a task de comandos aplica,
+// passa pelo limite/debounce de configuração e reporta o resultado ao shadow
+static int shadow_sync_stage(const char *js, int count, int obj, system_command_t *cmd)
+{
+    *cmd = (system_command_t){
+        .type = SYS_CMD_CONFIG_UPDATE,
+        .arg = -1,
+        .client = NULL,   // Sem ack em esp32/ack: a confirmação é o reported
+        .received_us = esp_timer_get_time(),
+    };
+    return plant_config_stage_fields(js, &tokens[obj], count - obj, &cmd->config, &cmd->config_mask) +
+           system_commands_stage_fields(js, &tokens[obj], count - obj, &cmd->system, &cmd->system_mask);
+}
+
+static int shadow_sync_parse(const char *js, size_t len)
+{
+    int count = json_parse(js, len, tokens, SHADOW_MAX_TOKENS);
+    if (count == JSON_ERR_NOMEM) {
+        stats.oversize++;
+        ESP_LOGE(TAG, "Documento do shadow excede %d tokens (%d bytes), descartado",
+                 SHADOW_MAX_TOKENS, (int)len);
+        return -1;
+    }
+    if (count < 1 || tokens[0].type != JSON_TOKEN_OBJECT) {
+        ESP_LOGW(TAG, "Documento do shadow inválido (%d)", count);
+        return -1;
+    }
+    return count;
+}
+
+static bool shadow_sync_read_version(const char *js, int count, uint32_t *version)
+{
+    int idx = json_object_find(js, tokens, count, 0, "version");
+    return idx >= 0 && shadow_sync_token_to_u32(js, &tokens[idx], version);
+}
+
+// Retorna o número de campos preparados em cmd (0 = nada a aplicar)
+static int shadow_sync_handle_delta(const char *js, size_t len, system_command_t *cmd)
+{
+    int count = shadow_sync_parse(js, len);
+    if (count < 0) {
+        return 0;
+    }
+
+    uint32_t version;
+    if (!shadow_sync_read_version(js, count, &version)) {
+        ESP_LOGW(TAG, "Delta sem versão, ignorado");
+        return 0;
+    }
+    if (version <= stats.version) {
+        // Entrega repetida (QoS 1) ou fora de ordem
+        stats.deltas_stale++;
+        ESP_LOGW(TAG, "Delta v%lu ignorado (atual: v%lu)",
+                 (unsigned long)version, (unsigned long)stats.version);
+        return 0;
+    }
+
+    int state = json_object_find(js, tokens, count, 0, "state");
+    int staged = state >= 0 ? shadow_sync_stage(js, count, state, cmd) : 0;
+
+    stats.version = version;
+    stats.deltas_applied++;
+    ESP_LOGI(TAG, "Delta v%lu: %d campo(s) preparado(s)", (unsigned long)version, staged);
+    return staged;
+}
+
+static int shadow_sync_handle_get_accepted(const char *js, size_t len, system_command_t *cmd)
+{
+    int count = shadow_sync_parse(js, len);
+    if (count < 0) {
+        // Sem o reported da nuvem: o próximo report envia o estado completo
+        reported_valid = false;
+        return 0;
+    }
+
+    uint32_t version = 0;
+    shadow_sync_read_version(js, count, &version);
+
+    int state = json_object_find(js, tokens, count, 0, "state");
+    int reported = json_object_find(js, tokens, count, state, "reported");
+    int delta = json_object_find(js, tokens, count, state, "delta");
+
+    // Carrega o que a nuvem já conhece para reportar só as diferenças
+    if (reported >= 0) {
+        reported_plant = *plant_config_get();
+        reported_system = system_commands_get_config();
+        reported_valid = shadow_sync_load(js, count, reported, &reported_plant, &reported_system) > 0;
+    }
+
+    int staged = delta >= 0 ? shadow_sync_stage(js, count, delta, cmd) : 0;
+    if (version > stats.version) {
+        stats.version = version;
+    }
+    ESP_LOGI(TAG, "Shadow v%lu carregado: %d campo(s) desejado(s) preparado(s)",
+             (unsigned long)version, staged);
+    return staged;
+}
+
+static bool shadow_sync_topic_is(const esp_mqtt_event_handle_t event, const char *topic)
+{
+    size_t len = strlen(topic);
+    return event->topic_len == (int)len && strncmp(event->topic, topic, len) == 0;
+}
+
+void shadow_sync_mqtt_handler(void *handler_args, esp_event_base_t base,
+                              int32_t event_id, void *event_data)
+{
+    esp_mqtt_event_handle_t event = event_data;
+
+    // A cada conexão: assina de novo e pede o documento (pode ter mudado offline)
+    if (event_id == MQTT_EVENT_CONNECTED) {
+        shadow_sync_subscribe(event->client);
+        return;
+    }
+
+    if (event_id != MQTT_EVENT_DATA || shadow_mutex == NULL || event->topic_len == 0) {
+        return;
+    }
+
+    bool is_delta = shadow_sync_topic_is(event, topic_delta);
+    bool is_accepted = shadow_sync_topic_is(event, topic_get_accepted);
+    bool is_rejected = shadow_sync_topic_is(event, topic_get_rejected);
+    if (!is_delta && !is_accepted && !is_rejected) {
+        return;
+    }
+
+    // Maior que o buffer do cliente: chega em partes (só a primeira traz o tópico)
+    bool oversize = event->data_len != event->total_data_len;
+    if (oversize) {
+        ESP_LOGE(TAG, "Documento do shadow com %d bytes excede o buffer MQTT de %d bytes, descartado",
+                 event->total_data_len, MQTT_RX_BUFFER_SIZE);
+    }
+
+    system_command_t cmd;
+    int staged = 0;
+
+    xSemaphoreTake(shadow_mutex, portMAX_DELAY);
+    if (is_rejected) {
+        // Shadow ainda não existe: cria com o estado completo
+        ESP_LOGW(TAG, "Shadow inexistente, reportando estado completo");
+        reported_valid = false;
+    } else if (oversize) {
+        // Desejados perdidos; get/accepted ao menos corrige o reported com o estado completo
+        stats.oversize++;
+        if (is_accepted) {
+            reported_valid = false;
+        }
+    } else if (is_delta) {
+        staged = shadow_sync_handle_delta(event->data, event->data_len, &cmd);
+    } else {
+        staged = shadow_sync_handle_get_accepted(event->data, event->data_len, &cmd);
+    }
+    xSemaphoreGive(shadow_mutex);
+
+    if (staged > 0) {
+        // A task de comandos aplica e confirma no reported (limpa o delta na nuvem)
+        if (!system_commands_enqueue(&cmd)) {
+            ESP_LOGW(TAG, "Campos desejados recusados pela fila de comandos");
+        }
+    } else if (!is_delta) {
+        // Documento novo ou sem desejados: atualiza o reported com o estado atual
+        shadow_sync_report(false);
+    }
+}
+
+shadow_sync_stats_t shadow_sync_get_stats(void)
+{
+    return stats;
+}
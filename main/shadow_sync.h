@@ -0,0 +1,69 @@
+#ifndef SHADOW_SYNC_H
+#define SHADOW_SYNC_H
+
+#include "esp_err.h"
+#include "esp_event.h"
+#include "mqtt_client.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Sincronização de plant_config_t e system_config_t via Device Shadow (AWS IoT)
+ *
+ * Tópicos (prefixo $aws/things/<thing>/shadow):
+ *   /update           -> estado "reported" (somente campos alterados)
+ *   /update/delta     <- diferenças desired x reported, com "version"
+ *   /get              -> pedido do documento completo na conexão
+ *   /get/accepted     <- documento completo (reported + delta)
+ *   /get/rejected     <- shadow inexistente: reporta tudo
+ *
+ * /update/accepted não é assinado: o dispositivo não processa o eco
+ * das próprias atualizações.
+ */
+
+#define SHADOW_TOPIC_MAX_LEN 128   // Tamanho máximo de cada tópico do shadow
+#define SHADOW_MAX_TOKENS 320      // Tokens para get/accepted: state + metadata dos 14 campos ~220
+#define SHADOW_REPORT_MAX 512      // Buffer do documento reported
+
+// Estatísticas da sincronização
+typedef struct {
+    uint32_t version;          // Última versão do shadow aplicada
+    uint32_t deltas_applied;   // Documentos delta aplicados
+    uint32_t deltas_stale;     // Deltas ignorados (versão antiga ou repetida)
+    uint32_t reports;          // Documentos reported publicados
+    uint32_t fields_reported;  // Total de campos enviados nos reports
+    uint32_t reports_skipped;  // Reports sem nenhuma alteração (não enviados)
+    uint32_t oversize;         // Documentos maiores que MQTT_RX_BUFFER_SIZE ou SHADOW_MAX_TOKENS
+} shadow_sync_stats_t;
+
+/**
+ * @brief Monta os tópicos do shadow para o thing informado
+ * @param thing_name Nome do thing no AWS IoT (client ID)
+ */
+esp_err_t shadow_sync_init(const char *thing_name);
+
+/**
+ * @brief Assina delta/get e pede o documento atual do shadow
+ * Chamada pelo próprio shadow_sync_mqtt_handler a cada MQTT_EVENT_CONNECTED
+ */
+void shadow_sync_subscribe(esp_mqtt_client_handle_t client);
+
+/**
+ * @brief Publica o estado reported
+ * @param full true envia todos os campos; false só os alterados desde o último report
+ * @return ESP_OK (inclusive quando não há nada a enviar) ou erro da publicação
+ */
+esp_err_t shadow_sync_report(bool full);
+
+/**
+ * @brief Handler MQTT para os tópicos de resposta do shadow
+ */
+void shadow_sync_mqtt_handler(void *handler_args, esp_event_base_t base,
+                              int32_t event_id, void *event_data);
+
+/**
+ * @brief Obtém estatísticas da sincronização
+ */
+shadow_sync_stats_t shadow_sync_get_stats(void);
+
+#endif // SHADOW_SYNC_H
@@ -3,15 +3,21 @@
 #include "solenoid.h"
 #include "system_commands.h"
 #include "power_manager.h"
+#include "sampling_governor.h"
+#include "power_budget.h"
+#include "json_writer.h"
+#include "mqtt_manager.h"
+#include "connectivity_manager.h"
+#include "timestamp.h"
 #include "esp_adc/adc_oneshot.h"
 #include "esp_log.h"
+#include "esp_attr.h"
 #include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include <stdio.h>
 
 static const char *TAG = "SOIL_MOISTURE";
-extern bool mqtt_connected;
 
 // Handle ADC compartilhado - declarado externamente
 extern adc_oneshot_unit_handle_t adc1_handle;
@@ -40,7 +46,9 @@ esp_err_t soil_moisture_read(int *value)
     // Lê o valor do ADC (0-4095)
     // Valores altos = solo seco, valores baixos = solo úmido
     int raw_value = 0;
+    power_manager_lock(POWER_LOCK_ADC);
     esp_err_t ret = adc_oneshot_read(adc1_handle, ADC_CHANNEL_5, &raw_value);
+    power_manager_unlock(POWER_LOCK_ADC);
     if (ret == ESP_OK) {
         *value = raw_value;
     }
@@ -53,33 +61,44 @@ void soil_moisture_task(void *pvParameters)
     esp_mqtt_client_handle_t client = (esp_mqtt_client_handle_t)pvParameters;
     int moisture_value = 0;
     char message[256];
-    int counter = 0;
+    static RTC_DATA_ATTR int counter = 0;   // Continua após o deep sleep
     
     ESP_LOGI(TAG, "Task do sensor de umidade do solo iniciada");
     
-    // Aguarda inicialização
-    vTaskDelay(pdMS_TO_TICKS(5000));
-    
     while (1) {
-        if (mqtt_connected && client != NULL) {
+        // Bloqueia até haver sessão MQTT (sem polling)
+        connectivity_manager_wait(CONNECTIVITY_MQTT_BIT, portMAX_DELAY);
+        
+        // Bateria lida junto do solo (mesmo ADC); o nível vale para a próxima janela
+        power_budget_update();
+        
+        // Só lê com o período deste sensor vencido
+        if (client != NULL && sampling_governor_is_due(SAMPLING_SOIL)) {
             esp_err_t res = soil_moisture_read(&moisture_value);
             
             if (res == ESP_OK) {
-                int64_t timestamp_ms = esp_timer_get_time() / 1000;
+                timestamp_t ts = timestamp_now();
                 
                 // Converte para porcentagem aproximada (0-100%)
                 // 4095 (seco) -> 0%, 0 (úmido) -> 100%
                 int moisture_percent = 100 - ((moisture_value * 100) / 4095);
                 
-                snprintf(message, sizeof(message),
-                    "{\"device_id\":\"ESP32_Client\",\"moisture_raw\":%d,\"moisture_percent\":%d,\"counter\":%d,\"timestamp\":%lld}",
-                    moisture_value, moisture_percent, counter, timestamp_ms);
+                json_writer_t w;
+                json_writer_init(&w, message, sizeof(message));
+                json_writer_begin_object(&w, NULL);
+                mqtt_manager_add_device_id(&w);
+                json_writer_add_int(&w, "moisture_raw", moisture_value);
+                json_writer_add_int(&w, "moisture_percent", moisture_percent);
+                json_writer_add_int(&w, "counter", counter);
+                json_writer_add_int(&w, "seq", mqtt_manager_next_seq(TOPIC_SOIL_MOISTURE));
+                timestamp_add_json(&w, ts);
+                json_writer_end_object(&w);
+                size_t len = json_writer_finish(&w);
                 
-                int msg_id = esp_mqtt_client_publish(client, TOPIC_SOIL_MOISTURE, message, 0, 1, 0);
-                ESP_LOGI(TAG, "Publicado [msg_id=%d]: %s", msg_id, message);
+                esp_err_t pub = len > 0 ? mqtt_manager_publish(TOPIC_SOIL_MOISTURE, message, len) : ESP_ERR_INVALID_SIZE;
+                ESP_LOGI(TAG, "Publicado [%s]: %s", esp_err_to_name(pub), message);
                 
-                // Marca que publicou dados
-                power_manager_mark_sensor_published("soil");
+                sampling_governor_update(SAMPLING_SOIL, moisture_percent);
                 
                 // Verifica se precisa irrigar automaticamente
                 if (plant_config_should_irrigate(moisture_percent)) {
@@ -87,13 +106,19 @@ void soil_moisture_task(void *pvParameters)
                     
                     // Publica alerta no MQTT
                     char alert_msg[256];
-                    snprintf(alert_msg, sizeof(alert_msg),
-                        "{\"device_id\":\"ESP32_Client\",\"type\":\"auto_irrigation\","
-                        "\"moisture\":%d,\"threshold\":%d,\"timestamp\":%lld}",
-                        moisture_percent, 
-                        plant_config_get()->soil_moisture_min - plant_config_get()->irrigation_threshold,
-                        timestamp_ms);
-                    esp_mqtt_client_publish(client, TOPIC_ALERTS, alert_msg, 0, 1, 0);
+                    json_writer_init(&w, alert_msg, sizeof(alert_msg));
+                    json_writer_begin_object(&w, NULL);
+                    mqtt_manager_add_device_id(&w);
+                    json_writer_add_string(&w, "type", "auto_irrigation");
+                    json_writer_add_int(&w, "moisture", moisture_percent);
+                    json_writer_add_int(&w, "threshold",
+                        plant_config_get()->soil_moisture_min - plant_config_get()->irrigation_threshold);
+                    timestamp_add_json(&w, ts);
+                    json_writer_end_object(&w);
+                    len = json_writer_finish(&w);
+                    if (len > 0) {
+                        mqtt_manager_publish(TOPIC_ALERTS, alert_msg, len);
+                    }
                     
                     // Liga o solenoide
                     solenoid_control(true);
@@ -109,18 +134,12 @@ void soil_moisture_task(void *pvParameters)
                 ESP_LOGW(TAG, "Falha ao ler sensor de umidade: %d", res);
             }
             counter++;
-        } else {
-            ESP_LOGW(TAG, "MQTT não conectado, aguardando...");
         }
         
-        // Usa período configurável com power management
-        int delay_ms = system_commands_get_read_period_ms();
+        // Aguarda a próxima janela com power management
+        int delay_ms = sampling_governor_window_ms();
         
-        if (power_manager_should_sleep(delay_ms)) {
-            power_manager_sleep(delay_ms);
-        } else {
-            vTaskDelay(pdMS_TO_TICKS(delay_ms));
-        }
+        power_manager_end_cycle(POWER_SENSOR_SOIL, delay_ms);
     }
 }
 
@@ -136,14 +155,24 @@ void soil_moisture_force_publish(esp_mqtt_client_handle_t client)
     
     if (res == ESP_OK) {
         char message[256];
-        int64_t timestamp_ms = esp_timer_get_time() / 1000;
+        timestamp_t ts = timestamp_now();
         int moisture_percent = 100 - ((moisture_value * 100) / 4095);
         
-        snprintf(message, sizeof(message),
-            "{\"device_id\":\"ESP32_Client\",\"moisture_raw\":%d,\"moisture_percent\":%d,\"forced\":true,\"timestamp\":%lld}",
-            moisture_value, moisture_percent, timestamp_ms);
+        json_writer_t w;
+        json_writer_init(&w, message, sizeof(message));
+        json_writer_begin_object(&w, NULL);
+        mqtt_manager_add_device_id(&w);
+        json_writer_add_int(&w, "moisture_raw", moisture_value);
+        json_writer_add_int(&w, "moisture_percent", moisture_percent);
+        json_writer_add_bool(&w, "forced", true);
+        json_writer_add_int(&w, "seq", mqtt_manager_next_seq(TOPIC_SOIL_MOISTURE));
+        timestamp_add_json(&w, ts);
+        json_writer_end_object(&w);
+        size_t len = json_writer_finish(&w);
         
-        esp_mqtt_client_publish(client, TOPIC_SOIL_MOISTURE, message, 0, 1, 0);
+        if (len > 0) {
+            mqtt_manager_publish(TOPIC_SOIL_MOISTURE, message, len);
+        }
         ESP_LOGI(TAG, "Umidade do solo forçada: %d%% (%d raw)", moisture_percent, moisture_value);
     } else {
         ESP_LOGW(TAG, "Falha ao ler sensor de umidade do solo");
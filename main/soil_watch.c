@@ -0,0 +1,114 @@
+#include "soil_watch.h"
+#include "soil_watch_model.h"
+#include "plant_config.h"
+#include "esp_sleep.h"
+#include "esp_log.h"
+
+#if CONFIG_ULP_COPROC_ENABLED
+#include "ulp.h"
+#include "ulp_adc.h"
+#include "ulp_main.h"
+#include "esp_adc/adc_oneshot.h"
+
+// Handle ADC compartilhado - declarado externamente
+extern adc_oneshot_unit_handle_t adc1_handle;
+
+// Programa do ULP gerado por ulp_embed_binary (main/CMakeLists.txt)
+extern const uint8_t ulp_main_bin_start[] asm("_binary_ulp_main_bin_start");
+extern const uint8_t ulp_main_bin_end[]   asm("_binary_ulp_main_bin_end");
+#endif
+
+static const char *TAG = "SOIL_WATCH";
+
+static soil_watch_report_t report = {0};
+
+bool soil_watch_start(void)
+{
+#if CONFIG_ULP_COPROC_ENABLED
+    esp_err_t ret = ulp_load_binary(0, ulp_main_bin_start,
+                                    (ulp_main_bin_end - ulp_main_bin_start) / sizeof(uint32_t));
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Falha ao carregar o programa do ULP: %s", esp_err_to_name(ret));
+        return false;
+    }
+
+    // O ULP assume o ADC1: o driver oneshot sai de cena até o próximo boot
+    if (adc1_handle != NULL) {
+        adc_oneshot_del_unit(adc1_handle);
+        adc1_handle = NULL;
+    }
+    ulp_adc_cfg_t adc_cfg = {
+        .adc_n = ADC_UNIT_1,
+        .channel = ADC_CHANNEL_5,
+        .width = ADC_BITWIDTH_DEFAULT,
+        .atten = ADC_ATTEN_DB_12,
+        .ulp_mode = ADC_ULP_MODE_FSM,
+    };
+    ret = ulp_adc_init(&adc_cfg);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Falha ao passar o ADC ao ULP: %s", esp_err_to_name(ret));
+        return false;
+    }
+
+    // Limiares na RTC slow memory, mesma conta de plant_config_should_irrigate
+    plant_config_t *plant = plant_config_get();
+    soil_watch_thresholds_t thr = soil_watch_thresholds_for(
+        plant->soil_moisture_min - plant->irrigation_threshold, plant->auto_irrigation);
+    soil_watch_state_t state;
+    soil_watch_reset(&state);
+
+    ulp_dry_raw = thr.dry_raw;
+    ulp_rearm_raw = thr.rearm_raw;
+    ulp_debounce = thr.debounce;
+    ulp_armed = state.armed;
+    ulp_over = state.over;
+    ulp_last_raw = state.last_raw;
+    ulp_min_raw = state.min_raw;
+    ulp_max_raw = state.max_raw;
+    ulp_samples = state.samples;
+
+    ulp_set_wakeup_period(0, (uint32_t)SOIL_WATCH_PERIOD_MS * 1000);
+    ret = ulp_run(&ulp_entry - RTC_SLOW_MEM);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Falha ao iniciar o ULP: %s", esp_err_to_name(ret));
+        return false;
+    }
+    esp_sleep_enable_ulp_wakeup();
+
+    if (thr.dry_raw == SOIL_WATCH_DISABLED_RAW) {
+        ESP_LOGI(TAG, "ULP lendo o solo a cada %d s (irrigação automática desligada)",
+                 SOIL_WATCH_PERIOD_MS / 1000);
+    } else {
+        ESP_LOGI(TAG, "ULP vigiando o solo a cada %d s (seco acima de %u, rearma até %u)",
+                 SOIL_WATCH_PERIOD_MS / 1000, thr.dry_raw, thr.rearm_raw);
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void soil_watch_collect(void)
+{
+#if CONFIG_ULP_COPROC_ENABLED
+    report.valid = true;
+    report.woke = esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_ULP;
+    report.samples = ulp_samples & UINT16_MAX;
+    report.last_raw = ulp_last_raw & UINT16_MAX;
+    report.min_raw = ulp_min_raw & UINT16_MAX;
+    report.max_raw = ulp_max_raw & UINT16_MAX;
+
+    if (report.woke) {
+        ESP_LOGW(TAG, "Solo cruzou o limiar no deep sleep (leitura %u após %u leitura(s) do ULP)",
+                 report.last_raw, report.samples);
+    } else if (report.samples > 0) {
+        ESP_LOGI(TAG, "ULP: %u leitura(s), última %u, faixa %u..%u",
+                 report.samples, report.last_raw, report.min_raw, report.max_raw);
+    }
+#endif
+}
+
+soil_watch_report_t soil_watch_get_report(void)
+{
+    return report;
+}
@@ -0,0 +1,48 @@
+#ifndef SOIL_WATCH_H
+#define SOIL_WATCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Vigia do solo pelo coprocessador ULP durante o deep sleep
+ *
+ * Antes de cada deep sleep o programa ulp/soil_watch.S é carregado com o
+ * limiar de irrigação de plant_config_get() e passa a ler a umidade a cada
+ * SOIL_WATCH_PERIOD_MS com os núcleos desligados. Os núcleos só acordam quando
+ * o solo cruza o limiar (ESP_SLEEP_WAKEUP_ULP) ou no timer do próximo envio;
+ * sem despertares só de amostragem. Requer CONFIG_ULP_COPROC_ENABLED.
+ */
+
+#define SOIL_WATCH_PERIOD_MS 30000   // Intervalo entre leituras do ULP
+
+/**
+ * Resultado da vigia no último deep sleep
+ */
+typedef struct {
+    bool valid;          // Dormiu com a vigia ativa
+    bool woke;           // Acordou porque o solo cruzou o limiar
+    uint16_t samples;    // Leituras do ULP
+    uint16_t last_raw;   // Última leitura (ADC 0-4095)
+    uint16_t min_raw;
+    uint16_t max_raw;
+} soil_watch_report_t;
+
+/**
+ * @brief Carrega o programa do ULP com o limiar atual e habilita o despertar por ele
+ * Libera o ADC1 para o ULP: chamar imediatamente antes de esp_deep_sleep_start
+ * @return true se o ULP ficou vigiando
+ */
+bool soil_watch_start(void);
+
+/**
+ * @brief Recolhe as leituras do ULP ao acordar de um deep sleep com a vigia ativa
+ */
+void soil_watch_collect(void);
+
+/**
+ * @brief Resultado do último deep sleep (valid = false sem vigia)
+ */
+soil_watch_report_t soil_watch_get_report(void);
+
+#endif // SOIL_WATCH_H
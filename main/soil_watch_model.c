@@ -0,0 +1,72 @@
+#include "soil_watch_model.h"
+
+#define SOIL_WATCH_FULL_SCALE 4095
+
+soil_watch_thresholds_t soil_watch_thresholds_for(int threshold_percent, bool enabled)
+{
+    soil_watch_thresholds_t thr = {
+        .dry_raw = SOIL_WATCH_DISABLED_RAW,
+        .rearm_raw = SOIL_WATCH_DISABLED_RAW,
+        .debounce = SOIL_WATCH_DEBOUNCE,
+    };
+
+    // Com limiar 0% ou menos nenhuma leitura pede irrigação
+    if (!enabled || threshold_percent <= 0) {
+        return thr;
+    }
+    // Acima de 100% tudo pede irrigação; só a leitura 0 fica de fora (raw > dry_raw)
+    if (threshold_percent > 100) {
+        thr.dry_raw = 0;
+        thr.rearm_raw = 0;
+        return thr;
+    }
+
+    // Seco quando 100 - raw*100/4095 < limiar, ou seja raw*100/4095 >= 101 - limiar:
+    // o menor raw seco é ceil((101 - limiar) * 4095 / 100)
+    uint32_t first_dry = ((uint32_t)(101 - threshold_percent) * SOIL_WATCH_FULL_SCALE + 99) / 100;
+    thr.dry_raw = (uint16_t)(first_dry - 1);
+    thr.rearm_raw = thr.dry_raw > SOIL_WATCH_HYSTERESIS_RAW ? thr.dry_raw - SOIL_WATCH_HYSTERESIS_RAW : 0;
+    return thr;
+}
+
+void soil_watch_reset(soil_watch_state_t *state)
+{
+    state->armed = 0;
+    state->over = 0;
+    state->last_raw = 0;
+    state->min_raw = 0xFFFF;
+    state->max_raw = 0;
+    state->samples = 0;
+}
+
+bool soil_watch_step(const soil_watch_thresholds_t *thr, soil_watch_state_t *state, uint16_t raw)
+{
+    state->last_raw = raw;
+    state->samples++;
+    if (raw < state->min_raw) {
+        state->min_raw = raw;
+    }
+    if (raw > state->max_raw) {
+        state->max_raw = raw;
+    }
+
+    // Úmido: zera a contagem e rearma abaixo da histerese
+    if (raw <= thr->dry_raw) {
+        state->over = 0;
+        if (raw <= thr->rearm_raw) {
+            state->armed = 1;
+        }
+        return false;
+    }
+
+    // Seco sem ter visto o solo úmido: já era assim ao dormir
+    if (!state->armed) {
+        return false;
+    }
+    state->over++;
+    if (state->over < thr->debounce) {
+        return false;
+    }
+    state->armed = 0;
+    return true;
+}
@@ -0,0 +1,60 @@
+#ifndef SOIL_WATCH_MODEL_H
+#define SOIL_WATCH_MODEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Lógica da vigia do solo no ULP (C puro, sem ESP-IDF)
+ *
+ * Espelha instrução por instrução ulp/soil_watch.S: qualquer mudança em um vai
+ * para o outro. Compila também no host: tools/soil_watch_sim.py roda estas
+ * funções com curvas de secagem e ruído sintéticos.
+ *
+ * Acorda só ao cruzar o limiar: precisa ver o solo úmido (abaixo de rearm_raw)
+ * antes de contar leituras secas; adormecer com o solo já seco não acorda.
+ */
+
+#define SOIL_WATCH_DISABLED_RAW 0xFFFF   // dry_raw que nunca é cruzado (irrigação automática desligada)
+#define SOIL_WATCH_HYSTERESIS_RAW 123    // ~3% abaixo do limiar para rearmar (acima do ruído do ADC)
+#define SOIL_WATCH_DEBOUNCE 3            // Leituras secas seguidas para acordar
+
+/**
+ * Limiares carregados na RTC slow memory antes do deep sleep
+ */
+typedef struct {
+    uint16_t dry_raw;     // Leitura acima disso = solo seco (ADC alto = seco)
+    uint16_t rearm_raw;   // Leitura até aqui rearma a vigia
+    uint16_t debounce;    // Leituras secas seguidas para acordar
+} soil_watch_thresholds_t;
+
+/**
+ * Estado da vigia (variáveis do programa do ULP)
+ */
+typedef struct {
+    uint16_t armed;       // Viu o solo úmido desde o último despertar
+    uint16_t over;        // Leituras secas seguidas com a vigia armada
+    uint16_t last_raw;
+    uint16_t min_raw;     // Começa em 0xFFFF
+    uint16_t max_raw;
+    uint16_t samples;     // Leituras feitas (16 bits, como no ULP)
+} soil_watch_state_t;
+
+/**
+ * @brief Limiares para o limiar de irrigação em % (o mesmo de plant_config_should_irrigate)
+ * @param enabled false devolve dry_raw = SOIL_WATCH_DISABLED_RAW
+ */
+soil_watch_thresholds_t soil_watch_thresholds_for(int threshold_percent, bool enabled);
+
+/**
+ * @brief Estado inicial (ao carregar o programa do ULP)
+ */
+void soil_watch_reset(soil_watch_state_t *state);
+
+/**
+ * @brief Processa uma leitura média do ADC
+ * @return true se o ULP acorda os núcleos nesta leitura
+ */
+bool soil_watch_step(const soil_watch_thresholds_t *thr, soil_watch_state_t *state, uint16_t raw);
+
+#endif // SOIL_WATCH_MODEL_H
@@ -1,10 +1,19 @@
 #include "solenoid.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
+#include "json_parser.h"
+#include "json_writer.h"
+#include "mqtt_manager.h"
+#include "system_commands.h"
+#include "energy_model.h"
+#include "timestamp.h"
+#include "esp_timer.h"
 #include <string.h>
 
 static const char *TAG = "SOLENOID";
 static bool solenoid_state = false;
+static int64_t last_change_us = 0;
+static uint32_t dwell_rejected = 0;
 
 esp_err_t solenoid_init(void)
 {
@@ -23,13 +32,49 @@ esp_err_t solenoid_init(void)
 
 esp_err_t solenoid_set_state(bool state)
 {
+    int64_t now_us = esp_timer_get_time();
+    bool changed = solenoid_state != state;
+    
+    if (changed && state && last_change_us != 0 &&
+        now_us - last_change_us < (int64_t)SOLENOID_MIN_DWELL_MS * 1000) {
+        dwell_rejected++;
+        ESP_LOGW(TAG, "Reabertura recusada: fechada há %lld ms (mínimo %d ms)",
+                 (long long)((now_us - last_change_us) / 1000), SOLENOID_MIN_DWELL_MS);
+        return ESP_ERR_INVALID_STATE;
+    }
+    
     gpio_set_level(SOLENOID_GPIO, state ? 1 : 0);
     solenoid_state = state;
+    if (changed) {
+        last_change_us = now_us;
+        energy_model_valve_on(state);
+    }
     
     ESP_LOGI(TAG, "Solenoide: %s", state ? "LIGADO" : "DESLIGADO");
+    
+    // Evento da válvula: QoS 1, passa à frente da telemetria
+    if (changed) {
+        char event[96];
+        json_writer_t w;
+        json_writer_init(&w, event, sizeof(event));
+        json_writer_begin_object(&w, NULL);
+        mqtt_manager_add_device_id(&w);
+        json_writer_add_bool(&w, "state", state);
+        timestamp_add_json(&w, timestamp_now());
+        json_writer_end_object(&w);
+        size_t len = json_writer_finish(&w);
+        if (len > 0) {
+            mqtt_manager_publish(TOPIC_VALVE_EVENTS, event, len);
+        }
+    }
     return ESP_OK;
 }
 
+uint32_t solenoid_get_dwell_rejected(void)
+{
+    return dwell_rejected;
+}
+
 bool solenoid_get_state(void)
 {
     return solenoid_state;
@@ -44,6 +89,13 @@ void solenoid_mqtt_handler(void *handler_args, esp_event_base_t base, int32_t ev
 {
     esp_mqtt_event_handle_t event = event_data;
     
+    // Sessão limpa: assina de novo a cada conexão
+    if (event_id == MQTT_EVENT_CONNECTED) {
+        int msg_id = esp_mqtt_client_subscribe(event->client, TOPIC_SOLENOID, 1);
+        ESP_LOGI(TAG, "Subscribed: %s (msg_id=%d)", TOPIC_SOLENOID, msg_id);
+        return;
+    }
+    
     // Verifica se é um evento de dados
     if (event_id == MQTT_EVENT_DATA) {
         // Extrai o tópico
@@ -52,43 +104,37 @@ void solenoid_mqtt_handler(void *handler_args, esp_event_base_t base, int32_t ev
         
         // Verifica se é o tópico do solenoide
         if (strncmp(topic, TOPIC_SOLENOID, strlen(TOPIC_SOLENOID)) == 0) {
-            ESP_LOGI(TAG, "═══════════════════════════════════════");
-            ESP_LOGI(TAG, "Comando recebido no tópico: %s", topic);
-            ESP_LOGI(TAG, "═══════════════════════════════════════");
-            
-            // Extrai os dados
+            // Extrai os dados (logs só de depuração: roda no callback MQTT)
             char data[256] = {0};
             snprintf(data, sizeof(data), "%.*s", event->data_len, event->data);
             
-            ESP_LOGI(TAG, "JSON recebido: %s", data);
+            ESP_LOGD(TAG, "Comando recebido em %s: %s", topic, data);
             
-            // Parse simples do JSON (sem biblioteca cJSON para evitar dependências)
-            // Procura por "state":true ou "state":false
-            bool new_state = false;
+            // Tokenizador próprio (sem cJSON e sem alocação)
+            json_token_t tokens[JSON_MAX_TOKENS];
+            int count = json_parse(data, strlen(data), tokens, JSON_MAX_TOKENS);
             
-            if (strstr(data, "\"state\":true") != NULL || 
-                strstr(data, "\"state\":\"on\"") != NULL ||
-                strstr(data, "\"state\":1") != NULL ||
-                strstr(data, "\"estado\":true") != NULL ||
-                strstr(data, "\"estado\":\"ligado\"") != NULL) {
-                new_state = true;
-            } else if (strstr(data, "\"state\":false") != NULL ||
-                       strstr(data, "\"state\":\"off\"") != NULL ||
-                       strstr(data, "\"state\":0") != NULL ||
-                       strstr(data, "\"estado\":false") != NULL ||
-                       strstr(data, "\"estado\":\"desligado\"") != NULL) {
-                new_state = false;
-            } else {
-                ESP_LOGW(TAG, "Formato de comando não reconhecido");
-                ESP_LOGW(TAG, "Use: {\"state\":true} ou {\"state\":false}");
-                return;
+            int value = json_object_find(data, tokens, count, 0, "state");
+            if (value < 0) {
+                value = json_object_find(data, tokens, count, 0, "estado");
             }
             
-            // Aplica o novo estado
-            solenoid_set_state(new_state);
-            ESP_LOGI(TAG, "Comando processado com sucesso!");
-            
-            ESP_LOGI(TAG, "═══════════════════════════════════════");
+            // Acionamento vai para a task de comandos, que confirma em TOPIC_ACK
+            // (formato inválido também é confirmado, com result "error")
+            system_command_t cmd = {
+                .type = SYS_CMD_SOLENOID_SET,
+                .arg = -1,
+                .client = event->client,
+                .received_us = esp_timer_get_time(),
+            };
+            bool new_state = false;
+            if (count > 0 && value >= 0 && json_token_to_bool(data, &tokens[value], &new_state)) {
+                cmd.arg = new_state ? 1 : 0;
+            }
+            if (count > 0) {
+                system_commands_copy_id(data, tokens, count, &cmd);
+            }
+            system_commands_enqueue(&cmd);
         }
     }
 }
@@ -8,6 +8,11 @@
 // Configurações do solenoide
 #define SOLENOID_GPIO 26  // GPIO digital - Lado direito da placa
 #define TOPIC_SOLENOID "esp32/solenoid"
+#define TOPIC_VALVE_EVENTS "esp32/valve"  // Publica cada mudança de estado
+
+// Tempo mínimo fechada antes de reabrir (protege a bobina de acionamentos em rajada).
+// Fechar é sempre aceito para a válvula nunca ficar presa aberta
+#define SOLENOID_MIN_DWELL_MS 5000
 
 /**
  * @brief Inicializa o solenoide
@@ -18,10 +23,15 @@ esp_err_t solenoid_init(void);
 /**
  * @brief Define o estado do solenoide
  * @param state true para ligar, false para desligar
- * @return ESP_OK em caso de sucesso
+ * @return ESP_OK ou ESP_ERR_INVALID_STATE se reabrir antes de SOLENOID_MIN_DWELL_MS
  */
 esp_err_t solenoid_set_state(bool state);
 
+/**
+ * @brief Aberturas recusadas por SOLENOID_MIN_DWELL_MS
+ */
+uint32_t solenoid_get_dwell_rejected(void);
+
 /**
  * @brief Controla o solenoide (wrapper para set_state)
  * @param state true para ligar, false para desligar
@@ -4,22 +4,138 @@
 #include "uv_sensor.h"
 #include "soil_moisture.h"
 #include "plant_config.h"
-#include "ntp_sync.h"
 #include "power_manager.h"
+#include "mqtt_manager.h"
+#include "json_parser.h"
+#include "json_writer.h"
+#include "shadow_sync.h"
+#include "tls_transport.h"
+#include "connectivity_manager.h"
+#include "wifi_manager.h"
+#include "duty_cycle.h"
+#include "sampling_governor.h"
+#include "power_budget.h"
+#include "energy_model.h"
+#include "config_store.h"
+#include "timestamp.h"
+#include "esp_attr.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include <string.h>
-#include <time.h>
 
 static const char *TAG = "SYS_CMD";
 
-// Configuração global do sistema
-static system_config_t system_config = {
+// Fila entre o callback MQTT e a task de comandos
+static QueueHandle_t command_queue = NULL;
+static uint32_t dropped_commands = 0;
+static uint32_t rate_limited_commands = 0;
+static uint32_t coalesced_commands = 0;
+static int64_t last_rx_us = 0;   // Janela de escuta do modo radio_off
+static bool status_announced = false;   // Status inicial já publicado neste boot
+
+// Token bucket por classe de comando (usado só na task do cliente MQTT)
+typedef enum {
+    COMMAND_CLASS_VALVE,
+    COMMAND_CLASS_CONFIG,
+    COMMAND_CLASS_OTHER,
+    COMMAND_CLASS_COUNT
+} command_class_t;
+
+typedef struct {
+    uint32_t burst;
+    uint32_t refill_ms;
+    uint32_t milli_tokens;   // Tokens x 1000 (reposição fracionária)
+    int64_t last_us;
+} command_bucket_t;
+
+static command_bucket_t buckets[COMMAND_CLASS_COUNT] = {
+    [COMMAND_CLASS_VALVE]  = {SYSTEM_COMMANDS_VALVE_BURST,  SYSTEM_COMMANDS_VALVE_REFILL_MS},
+    [COMMAND_CLASS_CONFIG] = {SYSTEM_COMMANDS_CONFIG_BURST, SYSTEM_COMMANDS_CONFIG_REFILL_MS},
+    [COMMAND_CLASS_OTHER]  = {SYSTEM_COMMANDS_OTHER_BURST,  SYSTEM_COMMANDS_OTHER_REFILL_MS},
+};
+
+// Configuração aguardando o fim da rajada
+static system_command_t pending_config;
+static bool config_pending = false;
+static int64_t config_first_us = 0;
+static SemaphoreHandle_t config_mutex = NULL;
+static esp_timer_handle_t config_timer = NULL;
+
+// Nomes de comando resolvidos por hash perfeito
+typedef struct {
+    const char *key;
+    system_command_type_t type;
+} command_name_t;
+
+static const command_name_t command_names[] = {
+    {"solenoid_on",     SYS_CMD_SOLENOID_ON},
+    {"solenoid_off",    SYS_CMD_SOLENOID_OFF},
+    {"publish_all",     SYS_CMD_PUBLISH_ALL},
+    {"set_read_period", SYS_CMD_SET_READ_PERIOD},
+    {"get_status",      SYS_CMD_GET_STATUS},
+    {"restart",         SYS_CMD_RESTART},
+    {"power_save_on",   SYS_CMD_POWER_SAVE_ON},
+    {"power_save_off",  SYS_CMD_POWER_SAVE_OFF},
+    {"set_power_mode",  SYS_CMD_SET_POWER_MODE},
+    {"power_stats",     SYS_CMD_POWER_STATS},
+};
+
+// Semente sem colisões para os nomes acima em JSON_PHASH_SLOTS
+#define COMMAND_NAMES_HASH_SEED 6
+
+static json_phash_t command_hash;
+static bool command_hash_ready = false;
+
+// Configuração global do sistema (na RTC: mantida entre ciclos de deep sleep)
+static RTC_DATA_ATTR system_config_t system_config = {
     .read_period_minutes = 1,  // Padrão: 1 minuto
+    .period_min_minutes = 1,   // Período adaptativo: 1 a 15 minutos
+    .period_max_minutes = 15,
     .solenoid_enabled = true   // Padrão: habilitado
 };
 
+// Campos aceitos em system_commands_set_field (bit = posição na tabela)
+static const char *const system_fields[] = {
+    "read_period_minutes",
+    "period_min_minutes",
+    "period_max_minutes",
+    "solenoid_enabled",
+};
+
+enum {
+    SYSTEM_FIELD_READ_PERIOD = 1u << 0,
+    SYSTEM_FIELD_PERIOD_MIN  = 1u << 1,
+    SYSTEM_FIELD_PERIOD_MAX  = 1u << 2,
+    SYSTEM_FIELD_SOLENOID    = 1u << 3,
+};
+
+static void system_commands_task(void *pvParameters);
+static void system_commands_flush_config(void *arg);
+
 void system_commands_init(void)
 {
+    if (command_queue == NULL) {
+        config_mutex = xSemaphoreCreateMutex();
+        const esp_timer_create_args_t config_timer_args = {
+            .callback = system_commands_flush_config,
+            .name = "cfg_debounce",
+        };
+        ESP_ERROR_CHECK(esp_timer_create(&config_timer_args, &config_timer));
+
+        command_queue = xQueueCreate(SYSTEM_COMMANDS_QUEUE_LEN, sizeof(system_command_t));
+        if (command_queue == NULL) {
+            ESP_LOGE(TAG, "Falha ao criar fila de comandos");
+            return;
+        }
+        // Core 1 junto do DHT11: publish_all lê o sensor
+        xTaskCreatePinnedToCore(system_commands_task, "cmd_task", SYSTEM_COMMANDS_TASK_STACK,
+                                NULL, SYSTEM_COMMANDS_TASK_PRIORITY, NULL, 1);
+    }
+
     ESP_LOGI(TAG, "Módulo de comandos do sistema inicializado");
     ESP_LOGI(TAG, "Período de leitura padrão: %d minutos", system_config.read_period_minutes);
     ESP_LOGI(TAG, "Tópico de comandos: %s", TOPIC_SYSTEM_COMMANDS);
@@ -42,6 +158,157 @@ void system_commands_set_read_period_minutes(int minutes)
     
     system_config.read_period_minutes = minutes;
     ESP_LOGI(TAG, "Período de leitura atualizado: %d minutos", minutes);
+    sampling_governor_reset();
+    config_store_mark_dirty(CONFIG_STORE_SYSTEM);
+}
+
+// Limites do período adaptativo; fora de 1-1440 min é recusado
+static bool system_commands_set_period_bound(system_config_t *cfg, int *field, int minutes)
+{
+    if (minutes < 1 || minutes > 1440) {
+        ESP_LOGW(TAG, "Limite de período fora de 1-1440 minutos: %d", minutes);
+        return false;
+    }
+    *field = minutes;
+    if (cfg == NULL) {
+        ESP_LOGI(TAG, "Faixa do período adaptativo: %d-%d minutos",
+                 system_config.period_min_minutes, system_config.period_max_minutes);
+        sampling_governor_reset();
+        config_store_mark_dirty(CONFIG_STORE_SYSTEM);
+    }
+    return true;
+}
+
+system_config_t system_commands_get_config(void)
+{
+    return system_config;
+}
+
+void system_commands_restore_config(const system_config_t *cfg)
+{
+    if (cfg->read_period_minutes >= 1 && cfg->read_period_minutes <= 1440) {
+        system_config.read_period_minutes = cfg->read_period_minutes;
+    }
+    if (cfg->period_min_minutes >= 1 && cfg->period_min_minutes <= 1440) {
+        system_config.period_min_minutes = cfg->period_min_minutes;
+    }
+    if (cfg->period_max_minutes >= 1 && cfg->period_max_minutes <= 1440) {
+        system_config.period_max_minutes = cfg->period_max_minutes;
+    }
+    system_config.solenoid_enabled = cfg->solenoid_enabled;
+}
+
+bool system_commands_set_field(system_config_t *cfg, const char *js,
+                               const json_token_t *key, const json_token_t *value)
+{
+    if (json_token_equals(js, key, "read_period_minutes")) {
+        int minutes;
+        if (json_token_to_int(js, value, &minutes)) {
+            if (cfg == NULL) {
+                system_commands_set_read_period_minutes(minutes);
+            } else {
+                cfg->read_period_minutes = minutes;
+            }
+            return true;
+        }
+    } else if (json_token_equals(js, key, "period_min_minutes") ||
+               json_token_equals(js, key, "period_max_minutes")) {
+        int minutes;
+        if (json_token_to_int(js, value, &minutes)) {
+            system_config_t *target = cfg != NULL ? cfg : &system_config;
+            int *field = json_token_equals(js, key, "period_min_minutes") ?
+                         &target->period_min_minutes : &target->period_max_minutes;
+            return system_commands_set_period_bound(cfg, field, minutes);
+        }
+    } else if (json_token_equals(js, key, "solenoid_enabled")) {
+        bool enabled;
+        if (json_token_to_bool(js, value, &enabled)) {
+            (cfg != NULL ? cfg : &system_config)->solenoid_enabled = enabled;
+            if (cfg == NULL) {
+                config_store_mark_dirty(CONFIG_STORE_SYSTEM);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+int system_commands_stage_fields(const char *js, const json_token_t *tokens, int count,
+                                 system_config_t *staged, uint32_t *mask)
+{
+    int staged_count = 0;
+
+    *staged = system_config;
+    *mask = 0;
+    if (count < 1 || tokens[0].type != JSON_TOKEN_OBJECT) {
+        return 0;
+    }
+
+    // Percorre os pares chave/valor do objeto raiz
+    int i = 1;
+    for (int pair = 0; pair < tokens[0].size / 2 && i + 1 < count; pair++) {
+        for (size_t f = 0; f < sizeof(system_fields) / sizeof(system_fields[0]); f++) {
+            if (json_token_equals(js, &tokens[i], system_fields[f])) {
+                if (system_commands_set_field(staged, js, &tokens[i], &tokens[i + 1])) {
+                    *mask |= 1u << f;
+                    staged_count++;
+                }
+                break;
+            }
+        }
+        i = json_next(tokens, count, i + 1);
+    }
+    return staged_count;
+}
+
+static void system_commands_merge_fields(system_config_t *dst, const system_config_t *src, uint32_t mask)
+{
+    if (mask & SYSTEM_FIELD_READ_PERIOD) dst->read_period_minutes = src->read_period_minutes;
+    if (mask & SYSTEM_FIELD_PERIOD_MIN)  dst->period_min_minutes = src->period_min_minutes;
+    if (mask & SYSTEM_FIELD_PERIOD_MAX)  dst->period_max_minutes = src->period_max_minutes;
+    if (mask & SYSTEM_FIELD_SOLENOID)    dst->solenoid_enabled = src->solenoid_enabled;
+}
+
+// Copia para a configuração ativa os campos preparados (valores já validados)
+static void system_commands_apply_fields(const system_config_t *staged, uint32_t mask)
+{
+    if (mask & SYSTEM_FIELD_READ_PERIOD) {
+        system_commands_set_read_period_minutes(staged->read_period_minutes);
+    }
+    if (mask & (SYSTEM_FIELD_PERIOD_MIN | SYSTEM_FIELD_PERIOD_MAX)) {
+        system_commands_merge_fields(&system_config, staged,
+                                     mask & (SYSTEM_FIELD_PERIOD_MIN | SYSTEM_FIELD_PERIOD_MAX));
+        ESP_LOGI(TAG, "Faixa do período adaptativo: %d-%d minutos",
+                 system_config.period_min_minutes, system_config.period_max_minutes);
+        sampling_governor_reset();
+    }
+    if (mask & SYSTEM_FIELD_SOLENOID) {
+        system_config.solenoid_enabled = staged->solenoid_enabled;
+    }
+    config_store_mark_dirty(CONFIG_STORE_SYSTEM);
+}
+
+int system_commands_write_fields(json_writer_t *w, const system_config_t *since)
+{
+    int written = 0;
+
+    if (since == NULL || since->read_period_minutes != system_config.read_period_minutes) {
+        json_writer_add_int(w, "read_period_minutes", system_config.read_period_minutes);
+        written++;
+    }
+    if (since == NULL || since->period_min_minutes != system_config.period_min_minutes) {
+        json_writer_add_int(w, "period_min_minutes", system_config.period_min_minutes);
+        written++;
+    }
+    if (since == NULL || since->period_max_minutes != system_config.period_max_minutes) {
+        json_writer_add_int(w, "period_max_minutes", system_config.period_max_minutes);
+        written++;
+    }
+    if (since == NULL || since->solenoid_enabled != system_config.solenoid_enabled) {
+        json_writer_add_bool(w, "solenoid_enabled", system_config.solenoid_enabled);
+        written++;
+    }
+    return written;
 }
 
 void system_commands_publish_all_data(esp_mqtt_client_handle_t client)
@@ -54,19 +321,30 @@ void system_commands_publish_all_data(esp_mqtt_client_handle_t client)
     ESP_LOGI(TAG, "Publicando todos os dados dos sensores...");
     
     // Publica DHT11
-    float temperature, humidity;
-    if (dht11_read_data(&temperature, &humidity)) {
+    int16_t temperature = 0, humidity = 0;
+    if (dht11_sensor_read(&humidity, &temperature) == ESP_OK) {
         char dht_payload[256];
-        time_t now = time(NULL);
-        char time_str[64];
-        ntp_get_time_string(time_str, sizeof(time_str));
+        timestamp_t ts = timestamp_now();
+        char time_str[32];
+        bool dated = timestamp_format(ts, time_str, sizeof(time_str));
         
-        snprintf(dht_payload, sizeof(dht_payload),
-                "{\"temperature\":%.1f,\"humidity\":%.1f,\"timestamp\":%lld,\"datetime\":\"%s\"}",
-                temperature, humidity, (long long)(now * 1000), time_str);
+        json_writer_t w;
+        json_writer_init(&w, dht_payload, sizeof(dht_payload));
+        json_writer_begin_object(&w, NULL);
+        json_writer_add_int(&w, "temperature", temperature);
+        json_writer_add_int(&w, "humidity", humidity);
+        json_writer_add_int(&w, "seq", mqtt_manager_next_seq(TOPIC_DHT11_FORCED));
+        timestamp_add_json(&w, ts);
+        if (dated) {
+            json_writer_add_string(&w, "datetime", time_str);
+        }
+        json_writer_end_object(&w);
+        size_t len = json_writer_finish(&w);
         
-        esp_mqtt_client_publish(client, "esp32/sensor/dht11", dht_payload, 0, 1, 0);
-        ESP_LOGI(TAG, "DHT11: T=%.1f°C, H=%.1f%%", temperature, humidity);
+        if (len > 0) {
+            mqtt_manager_publish(TOPIC_DHT11_FORCED, dht_payload, len);
+        }
+        ESP_LOGI(TAG, "DHT11: T=%d°C, H=%d%%", temperature, humidity);
     }
     
     // Publica UV (força leitura)
@@ -88,163 +366,589 @@ void system_commands_publish_status(esp_mqtt_client_handle_t client)
         return;
     }
     
-    char status_payload[512];
-    time_t now = time(NULL);
-    char time_str[64];
-    ntp_get_time_string(time_str, sizeof(time_str));
+    char status_payload[MQTT_OUTBOUND_MAX_PAYLOAD];
+    timestamp_t ts = timestamp_now();
+    char time_str[32];
+    bool dated = timestamp_format(ts, time_str, sizeof(time_str));
     
     power_config_t power_cfg = power_manager_get_config();
-    const char *power_mode_str = power_cfg.mode == POWER_MODE_AUTO ? "auto" :
-                                  power_cfg.mode == POWER_MODE_LIGHT_SLEEP ? "light_sleep" : "normal";
+    mqtt_callback_stats_t cb_stats = mqtt_manager_get_callback_stats();
+    mqtt_outbound_stats_t out_stats = mqtt_manager_get_outbound_stats();
+    json_parser_stats_t json_stats = json_parser_get_stats();
+    shadow_sync_stats_t shadow_stats = shadow_sync_get_stats();
+    tls_transport_stats_t tls_stats = tls_transport_get_stats();
+    connectivity_stats_t conn_stats = connectivity_manager_get_stats();
+    wifi_manager_stats_t wifi_stats = wifi_manager_get_stats();
+    
+    json_writer_t w;
+    json_writer_init(&w, status_payload, sizeof(status_payload));
+    json_writer_begin_object(&w, NULL);
+    json_writer_add_string(&w, "status", "online");
+    json_writer_add_int(&w, "read_period_minutes", system_config.read_period_minutes);
+    json_writer_add_bool(&w, "solenoid_state", solenoid_get_state());
+    json_writer_add_bool(&w, "solenoid_enabled", system_config.solenoid_enabled);
+    json_writer_add_bool(&w, "power_save_enabled", power_cfg.enabled);
+    json_writer_add_string(&w, "power_save_mode", power_manager_mode_name(power_cfg.mode));
+    json_writer_add_fixed(&w, "awake_pct", duty_cycle_awake_permille(), 1);
+    sampling_governor_write_periods(&w);
+    power_budget_write_supply(&w);
+    json_writer_add_int(&w, "cmd_dropped", dropped_commands);
+    json_writer_add_int(&w, "cmd_limited", rate_limited_commands + solenoid_get_dwell_rejected());
+    json_writer_add_int(&w, "cmd_coalesced", coalesced_commands);
+    json_writer_add_int(&w, "mqtt_cb_max_us", cb_stats.max_us);
+    json_writer_add_int(&w, "mqtt_cb_over_budget", cb_stats.over_budget);
+    json_writer_add_int(&w, "json_parse_max_us", json_stats.max_us);
+    json_writer_add_int(&w, "shadow_version", shadow_stats.version);
+    json_writer_add_int(&w, "shadow_oversize", shadow_stats.oversize);
+    json_writer_add_int(&w, "tls_handshake_ms", tls_stats.last_ms);
+    json_writer_add_int(&w, "tls_full_ms", tls_stats.full_last_ms);
+    json_writer_add_int(&w, "tls_resumed", tls_stats.resumed);
+    json_writer_add_int(&w, "wifi_retries", conn_stats.wifi_attempts);
+    json_writer_add_int(&w, "wifi_assoc_ms", wifi_stats.last_assoc_ms);
+    json_writer_add_int(&w, "radio_on_ms", wifi_stats.last_radio_on_ms);
+    json_writer_add_int(&w, "mqtt_retries", conn_stats.mqtt_attempts);
+    json_writer_add_int(&w, "offline_s", conn_stats.offline_ms / 1000);
+    json_writer_add_int(&w, "tx_dropped", out_stats.dropped_full + out_stats.dropped_outbox +
+                                          out_stats.dropped_offline);
+    json_writer_add_int(&w, "outbox_peak_bytes", out_stats.outbox_peak);
+    json_writer_add_int(&w, "ack_max_ms", out_stats.ack_max_ms);
+    json_writer_add_int(&w, "uptime_seconds", esp_timer_get_time() / 1000000);
+    timestamp_add_json(&w, ts);
+    if (dated) {
+        json_writer_add_string(&w, "datetime", time_str);
+    }
+    json_writer_end_object(&w);
+    size_t len = json_writer_finish(&w);
     
-    snprintf(status_payload, sizeof(status_payload),
-            "{"
-            "\"status\":\"online\","
-            "\"read_period_minutes\":%d,"
-            "\"solenoid_state\":%s,"
-            "\"solenoid_enabled\":%s,"
-            "\"power_save_enabled\":%s,"
-            "\"power_save_mode\":\"%s\","
-            "\"uptime_seconds\":%lld,"
-            "\"timestamp\":%lld,"
-            "\"datetime\":\"%s\""
-            "}",
-            system_config.read_period_minutes,
-            solenoid_get_state() ? "true" : "false",
-            system_config.solenoid_enabled ? "true" : "false",
-            power_cfg.enabled ? "true" : "false",
-            power_mode_str,
-            (long long)(now),
-            (long long)(now * 1000),
-            time_str);
+    if (len == 0) {
+        ESP_LOGE(TAG, "Status excede o buffer de %d bytes", (int)sizeof(status_payload));
+        return;
+    }
     
-    esp_mqtt_client_publish(client, "esp32/status", status_payload, 0, 1, 0);
+    mqtt_manager_publish(TOPIC_STATUS, status_payload, len);
     ESP_LOGI(TAG, "Status do sistema publicado");
 }
 
+static const char *system_commands_name(system_command_type_t type)
+{
+    switch (type) {
+    case SYS_CMD_SOLENOID_ON:     return "solenoid_on";
+    case SYS_CMD_SOLENOID_OFF:    return "solenoid_off";
+    case SYS_CMD_PUBLISH_ALL:     return "publish_all";
+    case SYS_CMD_SET_READ_PERIOD: return "set_read_period";
+    case SYS_CMD_GET_STATUS:      return "get_status";
+    case SYS_CMD_RESTART:         return "restart";
+    case SYS_CMD_POWER_SAVE_ON:   return "power_save_on";
+    case SYS_CMD_POWER_SAVE_OFF:  return "power_save_off";
+    case SYS_CMD_SET_POWER_MODE:  return "set_power_mode";
+    case SYS_CMD_POWER_STATS:     return "power_stats";
+    case SYS_CMD_SOLENOID_SET:    return "solenoid_set";
+    case SYS_CMD_CONFIG_UPDATE:   return "config_update";
+    default:                      return "unknown";
+    }
+}
+
+// Ack assíncrono publicado pela task de comandos após a execução
+// Tempos em µs relativos à recepção; rx_ms é o horário Unix da recepção
+static void system_commands_publish_ack(const system_command_t *cmd, const char *result,
+                                        int64_t dispatch_us, int64_t actuated_us)
+{
+    if (cmd->client == NULL) {
+        return;
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    int64_t rx_ms = timestamp_now_ms() - (now_us - cmd->received_us) / 1000;
+
+    char ack[256];
+    json_writer_t w;
+    json_writer_init(&w, ack, sizeof(ack));
+    json_writer_begin_object(&w, NULL);
+    if (cmd->id[0] != '\0') {
+        json_writer_add_string(&w, "id", cmd->id);
+    }
+    json_writer_add_string(&w, "ack", system_commands_name(cmd->type));
+    json_writer_add_string(&w, "result", result);
+    json_writer_add_int(&w, "rx_ms", rx_ms);
+    json_writer_add_int(&w, "dispatch_us", dispatch_us - cmd->received_us);
+    json_writer_add_int(&w, "actuate_us", actuated_us - cmd->received_us);
+    json_writer_add_int(&w, "done_us", now_us - cmd->received_us);
+    json_writer_end_object(&w);
+    size_t len = json_writer_finish(&w);
+
+    if (len > 0) {
+        mqtt_manager_publish(TOPIC_ACK, ack, len);
+    }
+}
+
+// Campos do sistema (vindos do shadow) primeiro; plant_config_apply reporta ao shadow no fim
+static esp_err_t system_commands_apply_config_update(const system_command_t *cmd)
+{
+    if (cmd->system_mask == 0) {
+        return plant_config_apply(&cmd->config, cmd->config_mask);
+    }
+
+    system_commands_apply_fields(&cmd->system, cmd->system_mask);
+    if (cmd->config_mask != 0) {
+        return plant_config_apply(&cmd->config, cmd->config_mask);
+    }
+    shadow_sync_report(false);
+    return ESP_OK;
+}
+
+static void system_commands_execute(const system_command_t *cmd, int64_t dispatch_us)
+{
+    esp_mqtt_client_handle_t client = cmd->client;
+    const char *result = "ok";
+    int64_t actuated_us = 0;   // Instante em que o efeito foi aplicado (0 = ao concluir)
+
+    switch (cmd->type) {
+    // ========== COMANDO: Ligar Solenoide ==========
+    case SYS_CMD_SOLENOID_ON:
+        ESP_LOGI(TAG, "Comando: LIGAR SOLENOIDE");
+        if (!power_budget_allow_valve(false)) {
+            result = "reserve";
+            break;
+        }
+        if (solenoid_set_state(true) != ESP_OK) {
+            result = "dwell";
+            break;
+        }
+        actuated_us = esp_timer_get_time();
+        system_config.solenoid_enabled = true;
+        config_store_mark_dirty(CONFIG_STORE_SYSTEM);
+        shadow_sync_report(false);
+        system_commands_publish_status(client);
+        break;
+
+    // ========== COMANDO: Desligar Solenoide ==========
+    case SYS_CMD_SOLENOID_OFF:
+        ESP_LOGI(TAG, "Comando: DESLIGAR SOLENOIDE");
+        solenoid_set_state(false);
+        actuated_us = esp_timer_get_time();
+        system_config.solenoid_enabled = false;
+        config_store_mark_dirty(CONFIG_STORE_SYSTEM);
+        shadow_sync_report(false);
+        system_commands_publish_status(client);
+        break;
+
+    // ========== COMANDO: Publicar Todos os Dados ==========
+    case SYS_CMD_PUBLISH_ALL:
+        ESP_LOGI(TAG, "Comando: PUBLICAR TODOS OS DADOS");
+        system_commands_publish_all_data(client);
+        break;
+
+    // ========== COMANDO: Alterar Período de Leitura ==========
+    case SYS_CMD_SET_READ_PERIOD:
+        if (cmd->arg >= 0) {
+            ESP_LOGI(TAG, "Comando: ALTERAR PERÍODO DE LEITURA");
+            ESP_LOGI(TAG, "Novo período: %d minutos", cmd->arg);
+            system_commands_set_read_period_minutes(cmd->arg);
+            actuated_us = esp_timer_get_time();
+            shadow_sync_report(false);
+            system_commands_publish_status(client);
+        } else {
+            ESP_LOGW(TAG, "Campo 'minutes' não encontrado");
+            result = "error";
+        }
+        break;
+
+    // ========== COMANDO: Solicitar Status ==========
+    case SYS_CMD_GET_STATUS:
+        ESP_LOGI(TAG, "Comando: SOLICITAR STATUS");
+        system_commands_publish_status(client);
+        break;
+
+    // ========== COMANDO: Reiniciar ESP32 ==========
+    case SYS_CMD_RESTART:
+        ESP_LOGI(TAG, "Comando: REINICIAR ESP32");
+        ESP_LOGW(TAG, "Reiniciando em 3 segundos...");
+        {
+            static const char restart_msg[] = "{\"message\":\"Restarting ESP32 in 3 seconds...\"}";
+            mqtt_manager_publish(TOPIC_STATUS, restart_msg, sizeof(restart_msg) - 1);
+        }
+        // Não há retorno após esp_restart: confirma antes
+        system_commands_publish_ack(cmd, "ok", dispatch_us, esp_timer_get_time());
+        // Bloqueia apenas a task de comandos; o cliente MQTT continua enviando o ack
+        vTaskDelay(pdMS_TO_TICKS(3000));
+        config_store_flush();   // Alterações ainda no debounce não se perdem
+        esp_restart();
+        break;
+
+    // ========== COMANDO: Habilitar Economia de Energia ==========
+    case SYS_CMD_POWER_SAVE_ON:
+        ESP_LOGI(TAG, "Comando: HABILITAR ECONOMIA DE ENERGIA");
+        power_manager_set_enabled(true);
+        system_commands_publish_status(client);
+        break;
+
+    // ========== COMANDO: Desabilitar Economia de Energia ==========
+    case SYS_CMD_POWER_SAVE_OFF:
+        ESP_LOGI(TAG, "Comando: DESABILITAR ECONOMIA DE ENERGIA");
+        power_manager_set_enabled(false);
+        system_commands_publish_status(client);
+        break;
+
+    // ========== COMANDO: Alterar Modo de Economia ==========
+    case SYS_CMD_SET_POWER_MODE:
+        ESP_LOGI(TAG, "Comando: ALTERAR MODO DE ECONOMIA");
+        if (cmd->arg >= 0) {
+            power_manager_set_mode((power_mode_t)cmd->arg);
+        } else {
+            ESP_LOGW(TAG, "Modo inválido. Use: auto, light_sleep, radio_off, deep_sleep ou normal");
+            result = "error";
+        }
+        system_commands_publish_status(client);
+        break;
+
+    // ========== COMANDO: Estatísticas de Energia ==========
+    case SYS_CMD_POWER_STATS:
+        ESP_LOGI(TAG, "Comando: ESTATÍSTICAS DE ENERGIA");
+        power_manager_report_stats();
+        if (energy_model_publish() != ESP_OK) {
+            result = "error";
+        }
+        break;
+
+    // ========== MENSAGEM: TOPIC_SOLENOID ==========
+    case SYS_CMD_SOLENOID_SET:
+        if (cmd->arg >= 0) {
+            if (cmd->arg != 0 && !power_budget_allow_valve(false)) {
+                result = "reserve";
+                break;
+            }
+            if (solenoid_set_state(cmd->arg != 0) != ESP_OK) {
+                result = "dwell";
+                break;
+            }
+            actuated_us = esp_timer_get_time();
+            ESP_LOGI(TAG, "Solenoide: comando processado com sucesso!");
+        } else {
+            ESP_LOGW(TAG, "Formato de comando não reconhecido");
+            ESP_LOGW(TAG, "Use: {\"state\":true} ou {\"state\":false}");
+            result = "error";
+        }
+        break;
+
+    // ========== MENSAGEM: TOPIC_PLANT_CONFIG / delta do shadow ==========
+    case SYS_CMD_CONFIG_UPDATE:
+        result = system_commands_apply_config_update(cmd) == ESP_OK ? "ok" : "error";
+        actuated_us = esp_timer_get_time();
+        break;
+
+    // ========== COMANDO DESCONHECIDO ==========
+    default:
+        ESP_LOGW(TAG, "Comando não reconhecido");
+        ESP_LOGI(TAG, "Comandos disponíveis:");
+        ESP_LOGI(TAG, "  - {\"command\":\"solenoid_on\"}");
+        ESP_LOGI(TAG, "  - {\"command\":\"solenoid_off\"}");
+        ESP_LOGI(TAG, "  - {\"command\":\"publish_all\"}");
+        ESP_LOGI(TAG, "  - {\"command\":\"set_read_period\",\"minutes\":10}");
+        ESP_LOGI(TAG, "  - {\"command\":\"get_status\"}");
+        ESP_LOGI(TAG, "  - {\"command\":\"power_save_on\"}");
+        ESP_LOGI(TAG, "  - {\"command\":\"power_save_off\"}");
+        ESP_LOGI(TAG, "  - {\"command\":\"set_power_mode\",\"mode\":\"auto|light_sleep|radio_off|deep_sleep|normal\"}");
+        ESP_LOGI(TAG, "  - {\"command\":\"power_stats\"}");
+        ESP_LOGI(TAG, "  - {\"command\":\"restart\"}");
+        result = "error";
+        break;
+    }
+
+    system_commands_publish_ack(cmd, result, dispatch_us,
+                                actuated_us != 0 ? actuated_us : esp_timer_get_time());
+}
+
+static void system_commands_task(void *pvParameters)
+{
+    system_command_t cmd;
+
+    ESP_LOGI(TAG, "Task de comandos iniciada no Core %d", xPortGetCoreID());
+
+    while (1) {
+        if (xQueueReceive(command_queue, &cmd, portMAX_DELAY) == pdTRUE) {
+            int64_t dispatch_us = esp_timer_get_time();
+            ESP_LOGI(TAG, "═══════════════════════════════════════");
+            ESP_LOGI(TAG, "Executando comando: %s (na fila há %lld ms)",
+                     system_commands_name(cmd.type),
+                     (long long)((dispatch_us - cmd.received_us) / 1000));
+
+            system_commands_execute(&cmd, dispatch_us);
+
+            ESP_LOGI(TAG, "═══════════════════════════════════════");
+        }
+    }
+}
+
+void system_commands_copy_id(const char *js, const json_token_t *tokens, int count,
+                             system_command_t *cmd)
+{
+    cmd->id[0] = '\0';
+
+    int id = json_object_find(js, tokens, count, 0, "id");
+    if (id < 0 || (tokens[id].type != JSON_TOKEN_STRING && tokens[id].type != JSON_TOKEN_PRIMITIVE)) {
+        return;
+    }
+
+    size_t len = tokens[id].end - tokens[id].start;
+    if (len >= sizeof(cmd->id)) {
+        len = sizeof(cmd->id) - 1;
+    }
+    memcpy(cmd->id, js + tokens[id].start, len);
+    cmd->id[len] = '\0';
+}
+
+static command_class_t system_commands_class(system_command_type_t type)
+{
+    switch (type) {
+    case SYS_CMD_SOLENOID_ON:
+    case SYS_CMD_SOLENOID_OFF:
+    case SYS_CMD_SOLENOID_SET:
+        return COMMAND_CLASS_VALVE;
+    case SYS_CMD_CONFIG_UPDATE:
+    case SYS_CMD_SET_READ_PERIOD:
+        return COMMAND_CLASS_CONFIG;
+    default:
+        return COMMAND_CLASS_OTHER;
+    }
+}
+
+static bool system_commands_take_token(command_class_t cls)
+{
+    command_bucket_t *b = &buckets[cls];
+    int64_t now_us = esp_timer_get_time();
+
+    if (b->last_us == 0) {
+        b->milli_tokens = b->burst * 1000;
+    } else {
+        uint64_t refill = (uint64_t)(now_us - b->last_us) / b->refill_ms;   // µs / ms = tokens x 1000
+        b->milli_tokens = refill >= b->burst * 1000 - b->milli_tokens ?
+                          b->burst * 1000 : b->milli_tokens + (uint32_t)refill;
+    }
+    b->last_us = now_us;
+
+    if (b->milli_tokens < 1000) {
+        return false;
+    }
+    b->milli_tokens -= 1000;
+    return true;
+}
+
+// Fim da rajada: uma única aplicação entra na fila
+static void system_commands_flush_config(void *arg)
+{
+    system_command_t cmd;
+
+    xSemaphoreTake(config_mutex, portMAX_DELAY);
+    if (!config_pending) {
+        xSemaphoreGive(config_mutex);
+        return;
+    }
+    cmd = pending_config;
+    config_pending = false;
+    xSemaphoreGive(config_mutex);
+
+    if (xQueueSend(command_queue, &cmd, 0) != pdTRUE) {
+        dropped_commands++;
+        ESP_LOGW(TAG, "Fila de comandos cheia, configuração descartada");
+    }
+}
+
+// Comando recusado pelo limite da sua classe
+static void system_commands_reject_rate_limited(const system_command_t *cmd)
+{
+    rate_limited_commands++;
+    ESP_LOGD(TAG, "Limite de %s atingido, comando recusado (total: %lu)",
+             system_commands_name(cmd->type), rate_limited_commands);
+    int64_t now_us = esp_timer_get_time();
+    system_commands_publish_ack(cmd, "rate_limited", now_us, now_us);
+}
+
+// Incorpora a mensagem à configuração pendente e reinicia o debounce.
+// A mensagem anterior recebe ack "coalesced": seus campos saem junto com esta.
+// Só a mensagem que abre a janela de debounce consome token: as mescladas não
+// geram aplicação extra e não podem ser recusadas no meio da rajada
+static bool system_commands_coalesce_config(const system_command_t *cmd)
+{
+    system_command_t superseded;
+    bool has_superseded = false;
+    int64_t now_us = esp_timer_get_time();
+
+    xSemaphoreTake(config_mutex, portMAX_DELAY);
+    if (!config_pending && !system_commands_take_token(system_commands_class(cmd->type))) {
+        xSemaphoreGive(config_mutex);
+        system_commands_reject_rate_limited(cmd);
+        return false;
+    }
+    if (config_pending) {
+        superseded = pending_config;
+        has_superseded = true;
+        coalesced_commands++;
+
+        plant_config_merge(&pending_config.config, &cmd->config, cmd->config_mask);
+        pending_config.config_mask |= cmd->config_mask;
+        system_commands_merge_fields(&pending_config.system, &cmd->system, cmd->system_mask);
+        pending_config.system_mask |= cmd->system_mask;
+        memcpy(pending_config.id, cmd->id, sizeof(pending_config.id));
+        pending_config.received_us = cmd->received_us;
+        pending_config.client = cmd->client;
+    } else {
+        pending_config = *cmd;
+        config_pending = true;
+        config_first_us = now_us;
+    }
+
+    // Rajada contínua ainda aplica a cada DEBOUNCE_MAX
+    int64_t delay_us = (int64_t)SYSTEM_COMMANDS_CONFIG_DEBOUNCE_MS * 1000;
+    int64_t remaining_us = (int64_t)SYSTEM_COMMANDS_CONFIG_DEBOUNCE_MAX_MS * 1000 -
+                           (now_us - config_first_us);
+    if (remaining_us < delay_us) {
+        delay_us = remaining_us > 0 ? remaining_us : 0;
+    }
+    esp_timer_stop(config_timer);
+    esp_timer_start_once(config_timer, delay_us);
+    xSemaphoreGive(config_mutex);
+
+    if (has_superseded) {
+        system_commands_publish_ack(&superseded, "coalesced", now_us, now_us);
+    }
+    return true;
+}
+
+bool system_commands_enqueue(const system_command_t *cmd)
+{
+    if (command_queue == NULL || cmd == NULL) {
+        return false;
+    }
+    last_rx_us = cmd->received_us;
+
+    // Configuração mescla antes do limite (consome token só ao abrir a janela)
+    if (cmd->type == SYS_CMD_CONFIG_UPDATE) {
+        return system_commands_coalesce_config(cmd);
+    }
+
+    if (!system_commands_take_token(system_commands_class(cmd->type))) {
+        system_commands_reject_rate_limited(cmd);
+        return false;
+    }
+
+    // Timeout zero: o callback MQTT nunca bloqueia esperando a task
+    if (xQueueSend(command_queue, cmd, 0) != pdTRUE) {
+        dropped_commands++;
+        ESP_LOGD(TAG, "Fila de comandos cheia, comando descartado (total: %lu)", dropped_commands);
+        return false;
+    }
+
+    return true;
+}
+
+system_commands_stats_t system_commands_get_stats(void)
+{
+    system_commands_stats_t stats = {
+        .dropped = dropped_commands,
+        .rate_limited = rate_limited_commands,
+        .coalesced = coalesced_commands,
+        .dwell_rejected = solenoid_get_dwell_rejected(),
+        .last_rx_us = last_rx_us,
+    };
+    return stats;
+}
+
+uint32_t system_commands_get_dropped_count(void)
+{
+    return dropped_commands;
+}
+
+// Interpreta o payload em um system_command_t sem executar nada
+static void system_commands_parse(const char *data, size_t len, system_command_t *cmd)
+{
+    cmd->type = SYS_CMD_UNKNOWN;
+    cmd->arg = -1;
+    cmd->id[0] = '\0';
+
+    if (!command_hash_ready) {
+        command_hash_ready = json_phash_init(&command_hash, command_names,
+                                             sizeof(command_names) / sizeof(command_names[0]),
+                                             sizeof(command_names[0]), COMMAND_NAMES_HASH_SEED);
+        if (!command_hash_ready) {
+            ESP_LOGE(TAG, "Colisão na tabela hash de comandos - ajuste COMMAND_NAMES_HASH_SEED");
+            return;
+        }
+    }
+
+    json_token_t tokens[JSON_MAX_TOKENS];
+    int count = json_parse(data, len, tokens, JSON_MAX_TOKENS);
+    if (count < 1) {
+        ESP_LOGD(TAG, "JSON inválido (erro %d)", count);
+        return;
+    }
+
+    system_commands_copy_id(data, tokens, count, cmd);
+
+    int name = json_object_find(data, tokens, count, 0, "command");
+    if (name < 0 || tokens[name].type != JSON_TOKEN_STRING) {
+        return;
+    }
+
+    int index = json_phash_lookup(&command_hash, data, &tokens[name]);
+    if (index < 0) {
+        return;
+    }
+    cmd->type = command_names[index].type;
+
+    if (cmd->type == SYS_CMD_SET_READ_PERIOD) {
+        int minutes_tok = json_object_find(data, tokens, count, 0, "minutes");
+        int minutes = 0;
+        if (minutes_tok >= 0 && json_token_to_int(data, &tokens[minutes_tok], &minutes)) {
+            cmd->arg = minutes;
+        }
+    } else if (cmd->type == SYS_CMD_SET_POWER_MODE) {
+        int mode_tok = json_object_find(data, tokens, count, 0, "mode");
+        if (mode_tok >= 0) {
+            if (json_token_equals(data, &tokens[mode_tok], "auto")) {
+                cmd->arg = POWER_MODE_AUTO;
+            } else if (json_token_equals(data, &tokens[mode_tok], "light_sleep")) {
+                cmd->arg = POWER_MODE_LIGHT_SLEEP;
+            } else if (json_token_equals(data, &tokens[mode_tok], "radio_off")) {
+                cmd->arg = POWER_MODE_RADIO_OFF;
+            } else if (json_token_equals(data, &tokens[mode_tok], "deep_sleep")) {
+                cmd->arg = POWER_MODE_DEEP_SLEEP;
+            } else if (json_token_equals(data, &tokens[mode_tok], "normal")) {
+                cmd->arg = POWER_MODE_NORMAL;
+            }
+        }
+    }
+}
+
 void system_commands_mqtt_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data)
 {
     esp_mqtt_event_handle_t event = event_data;
     
-    if (event_id == MQTT_EVENT_DATA) {
-        char topic[128] = {0};
-        snprintf(topic, sizeof(topic), "%.*s", event->topic_len, event->topic);
+    if (event_id == MQTT_EVENT_CONNECTED) {
+        int msg_id = esp_mqtt_client_subscribe(event->client, TOPIC_SYSTEM_COMMANDS, 1);
+        ESP_LOGI(TAG, "Subscribed: %s (msg_id=%d)", TOPIC_SYSTEM_COMMANDS, msg_id);
         
+        // Status inicial só na primeira conexão do boot (depois fica o retido)
+        if (!status_announced) {
+            status_announced = true;
+            system_commands_publish_status(event->client);
+        }
+        return;
+    }
+    
+    if (event_id == MQTT_EVENT_DATA) {
         // Verifica se é o tópico de comandos
-        if (strncmp(topic, TOPIC_SYSTEM_COMMANDS, strlen(TOPIC_SYSTEM_COMMANDS)) == 0) {
-            ESP_LOGI(TAG, "═══════════════════════════════════════");
-            ESP_LOGI(TAG, "Comando recebido: %s", topic);
-            
-            char data[512] = {0};
-            snprintf(data, sizeof(data), "%.*s", event->data_len, event->data);
-            ESP_LOGI(TAG, "Payload: %s", data);
-            
-            // Cliente MQTT do evento
-            esp_mqtt_client_handle_t client = event->client;
+        if (event->topic_len >= (int)strlen(TOPIC_SYSTEM_COMMANDS) &&
+            strncmp(event->topic, TOPIC_SYSTEM_COMMANDS, strlen(TOPIC_SYSTEM_COMMANDS)) == 0) {
+            system_command_t cmd = {
+                .client = event->client,
+                .received_us = esp_timer_get_time(),
+            };
+            // Tokeniza direto do buffer do evento, sem cópia
+            system_commands_parse(event->data, event->data_len, &cmd);
             
-            // ========== COMANDO: Ligar Solenoide ==========
-            if (strstr(data, "\"command\":\"solenoid_on\"") != NULL) {
-                ESP_LOGI(TAG, "Comando: LIGAR SOLENOIDE");
-                solenoid_set_state(true);
-                system_config.solenoid_enabled = true;
-                system_commands_publish_status(client);
+            if (system_commands_enqueue(&cmd)) {
+                ESP_LOGD(TAG, "Comando enfileirado: %s", system_commands_name(cmd.type));
             }
-            // ========== COMANDO: Desligar Solenoide ==========
-            else if (strstr(data, "\"command\":\"solenoid_off\"") != NULL) {
-                ESP_LOGI(TAG, "Comando: DESLIGAR SOLENOIDE");
-                solenoid_set_state(false);
-                system_config.solenoid_enabled = false;
-                system_commands_publish_status(client);
-            }
-            // ========== COMANDO: Publicar Todos os Dados ==========
-            else if (strstr(data, "\"command\":\"publish_all\"") != NULL) {
-                ESP_LOGI(TAG, "Comando: PUBLICAR TODOS OS DADOS");
-                system_commands_publish_all_data(client);
-            }
-            // ========== COMANDO: Alterar Período de Leitura ==========
-            else if (strstr(data, "\"command\":\"set_read_period\"") != NULL) {
-                // Parse do campo "minutes"
-                char *minutes_str = strstr(data, "\"minutes\":");
-                if (minutes_str != NULL) {
-                    int minutes = 0;
-                    sscanf(minutes_str, "\"minutes\":%d", &minutes);
-                    
-                    ESP_LOGI(TAG, "Comando: ALTERAR PERÍODO DE LEITURA");
-                    ESP_LOGI(TAG, "Novo período: %d minutos", minutes);
-                    
-                    system_commands_set_read_period_minutes(minutes);
-                    system_commands_publish_status(client);
-                } else {
-                    ESP_LOGW(TAG, "Campo 'minutes' não encontrado");
-                }
-            }
-            // ========== COMANDO: Solicitar Status ==========
-            else if (strstr(data, "\"command\":\"get_status\"") != NULL) {
-                ESP_LOGI(TAG, "Comando: SOLICITAR STATUS");
-                system_commands_publish_status(client);
-            }
-            // ========== COMANDO: Reiniciar ESP32 ==========
-            else if (strstr(data, "\"command\":\"restart\"") != NULL) {
-                ESP_LOGI(TAG, "Comando: REINICIAR ESP32");
-                ESP_LOGW(TAG, "Reiniciando em 3 segundos...");
-                
-                char ack[128];
-                snprintf(ack, sizeof(ack), "{\"message\":\"Restarting ESP32 in 3 seconds...\"}");
-                esp_mqtt_client_publish(client, "esp32/status", ack, 0, 1, 0);
-                
-                vTaskDelay(pdMS_TO_TICKS(3000));
-                esp_restart();
-            }
-            // ========== COMANDO: Habilitar Economia de Energia ==========
-            else if (strstr(data, "\"command\":\"power_save_on\"") != NULL) {
-                ESP_LOGI(TAG, "Comando: HABILITAR ECONOMIA DE ENERGIA");
-                power_manager_set_enabled(true);
-                system_commands_publish_status(client);
-            }
-            // ========== COMANDO: Desabilitar Economia de Energia ==========
-            else if (strstr(data, "\"command\":\"power_save_off\"") != NULL) {
-                ESP_LOGI(TAG, "Comando: DESABILITAR ECONOMIA DE ENERGIA");
-                power_manager_set_enabled(false);
-                system_commands_publish_status(client);
-            }
-            // ========== COMANDO: Alterar Modo de Economia ==========
-            else if (strstr(data, "\"command\":\"set_power_mode\"") != NULL) {
-                ESP_LOGI(TAG, "Comando: ALTERAR MODO DE ECONOMIA");
-                
-                if (strstr(data, "\"mode\":\"auto\"") != NULL) {
-                    power_manager_set_mode(POWER_MODE_AUTO);
-                } else if (strstr(data, "\"mode\":\"light_sleep\"") != NULL) {
-                    power_manager_set_mode(POWER_MODE_LIGHT_SLEEP);
-                } else if (strstr(data, "\"mode\":\"normal\"") != NULL) {
-                    power_manager_set_mode(POWER_MODE_NORMAL);
-                } else {
-                    ESP_LOGW(TAG, "Modo inválido. Use: auto, light_sleep ou normal");
-                }
-                
-                system_commands_publish_status(client);
-            }
-            // ========== COMANDO: Estatísticas de Energia ==========
-            else if (strstr(data, "\"command\":\"power_stats\"") != NULL) {
-                ESP_LOGI(TAG, "Comando: ESTATÍSTICAS DE ENERGIA");
-                power_manager_report_stats();
-            }
-            // ========== COMANDO DESCONHECIDO ==========
-            else {
-                ESP_LOGW(TAG, "Comando não reconhecido");
-                ESP_LOGI(TAG, "Comandos disponíveis:");
-                ESP_LOGI(TAG, "  - {\"command\":\"solenoid_on\"}");
-                ESP_LOGI(TAG, "  - {\"command\":\"solenoid_off\"}");
-                ESP_LOGI(TAG, "  - {\"command\":\"publish_all\"}");
-                ESP_LOGI(TAG, "  - {\"command\":\"set_read_period\",\"minutes\":10}");
-                ESP_LOGI(TAG, "  - {\"command\":\"get_status\"}");
-                ESP_LOGI(TAG, "  - {\"command\":\"power_save_on\"}");
-                ESP_LOGI(TAG, "  - {\"command\":\"power_save_off\"}");
-                ESP_LOGI(TAG, "  - {\"command\":\"set_power_mode\",\"mode\":\"auto|light_sleep|normal\"}");
-                ESP_LOGI(TAG, "  - {\"command\":\"power_stats\"}");
-                ESP_LOGI(TAG, "  - {\"command\":\"restart\"}");
-            }
-            
-            ESP_LOGI(TAG, "═══════════════════════════════════════");
         }
     }
 }
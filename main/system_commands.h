@@ -3,25 +3,121 @@
 
 #include "mqtt_client.h"
 #include "esp_event.h"
+#include "json_parser.h"
+#include "json_writer.h"
+#include "plant_config.h"
 
 // Tópico para comandos do sistema
 #define TOPIC_SYSTEM_COMMANDS "esp32/commands"
+#define TOPIC_STATUS "esp32/status"
+#define TOPIC_ACK "esp32/ack"   // Confirmação de cada comando (com o "id" recebido)
+
+// Fila de comandos processados fora da task do cliente MQTT
+#define SYSTEM_COMMANDS_QUEUE_LEN 8
+#define SYSTEM_COMMANDS_TASK_STACK 4096
+#define SYSTEM_COMMANDS_TASK_PRIORITY 5
+#define SYSTEM_COMMANDS_ID_MAX 24   // Tamanho máximo do "id" de correlação (com '\0')
+
+// Limite por classe de comando (token bucket): rajada e tempo de reposição de um token
+#define SYSTEM_COMMANDS_VALVE_BURST 3
+#define SYSTEM_COMMANDS_VALVE_REFILL_MS 2000
+#define SYSTEM_COMMANDS_CONFIG_BURST 5
+#define SYSTEM_COMMANDS_CONFIG_REFILL_MS 1000
+#define SYSTEM_COMMANDS_OTHER_BURST 4
+#define SYSTEM_COMMANDS_OTHER_REFILL_MS 1000
+
+// Rajada de mensagens de configuração vira uma única aplicação:
+// aplica após DEBOUNCE sem mensagens novas, ou no máximo DEBOUNCE_MAX após a primeira
+#define SYSTEM_COMMANDS_CONFIG_DEBOUNCE_MS 500
+#define SYSTEM_COMMANDS_CONFIG_DEBOUNCE_MAX_MS 2000
 
 /**
  * Estrutura de configuração do sistema
  */
 typedef struct {
     int read_period_minutes;  // Período de leitura em minutos
+    int period_min_minutes;   // Faixa do período adaptativo (sampling_governor)
+    int period_max_minutes;
     bool solenoid_enabled;    // Solenoide habilitado ou não
 } system_config_t;
 
+/**
+ * Comandos reconhecidos em TOPIC_SYSTEM_COMMANDS
+ */
+typedef enum {
+    SYS_CMD_UNKNOWN,
+    SYS_CMD_SOLENOID_ON,
+    SYS_CMD_SOLENOID_OFF,
+    SYS_CMD_PUBLISH_ALL,
+    SYS_CMD_SET_READ_PERIOD,
+    SYS_CMD_GET_STATUS,
+    SYS_CMD_RESTART,
+    SYS_CMD_POWER_SAVE_ON,
+    SYS_CMD_POWER_SAVE_OFF,
+    SYS_CMD_SET_POWER_MODE,
+    SYS_CMD_POWER_STATS,
+    SYS_CMD_SOLENOID_SET,    // TOPIC_SOLENOID: arg = 0/1
+    SYS_CMD_CONFIG_UPDATE    // TOPIC_PLANT_CONFIG: campos em config/config_mask
+} system_command_type_t;
+
+/**
+ * Comando já interpretado, enviado do callback MQTT para a task de comandos
+ */
+typedef struct {
+    system_command_type_t type;
+    int arg;                          // minutes (SET_READ_PERIOD), power_mode_t (SET_POWER_MODE) ou estado (SOLENOID_SET), -1 se ausente
+    esp_mqtt_client_handle_t client;  // Cliente para publicar o ack
+    int64_t received_us;              // Instante de recepção (esp_timer)
+    char id[SYSTEM_COMMANDS_ID_MAX];  // "id" de correlação ("" se ausente)
+    plant_config_t config;            // CONFIG_UPDATE: valores preparados
+    uint32_t config_mask;             // CONFIG_UPDATE: campos presentes
+    system_config_t system;           // CONFIG_UPDATE (shadow): campos do sistema preparados
+    uint32_t system_mask;             // CONFIG_UPDATE (shadow): campos do sistema presentes
+} system_command_t;
+
+/**
+ * Contadores de proteção contra rajadas de comandos
+ */
+typedef struct {
+    uint32_t dropped;        // Fila cheia
+    uint32_t rate_limited;   // Recusados pelo token bucket da classe
+    uint32_t coalesced;      // Configurações incorporadas a uma aplicação posterior
+    uint32_t dwell_rejected; // Aberturas da válvula antes de SOLENOID_MIN_DWELL_MS
+    int64_t last_rx_us;      // Recepção do último comando (esp_timer), 0 se nenhum
+} system_commands_stats_t;
+
 /**
  * Inicializa o módulo de comandos do sistema
  */
 void system_commands_init(void);
 
+/**
+ * Copia o campo "id" (string ou número) do objeto raiz para cmd->id
+ */
+void system_commands_copy_id(const char *js, const json_token_t *tokens, int count,
+                             system_command_t *cmd);
+
+/**
+ * Coloca um comando na fila da task de comandos (não bloqueia)
+ * Aplica o limite da classe do comando; CONFIG_UPDATE é agrupado antes de entrar na fila.
+ * Comandos recusados recebem ack "rate_limited"
+ * @return true se aceito, false se recusado ou com a fila cheia
+ */
+bool system_commands_enqueue(const system_command_t *cmd);
+
+/**
+ * Contadores de descarte, limite e agrupamento
+ */
+system_commands_stats_t system_commands_get_stats(void);
+
+/**
+ * Número de comandos descartados por fila cheia
+ */
+uint32_t system_commands_get_dropped_count(void);
+
 /**
  * Handler MQTT para processar comandos do sistema
+ * Apenas interpreta o payload e enfileira; a execução ocorre na task de comandos
  */
 void system_commands_mqtt_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data);
 
@@ -40,6 +136,44 @@ int system_commands_get_read_period_ms(void);
  */
 void system_commands_set_read_period_minutes(int minutes);
 
+/**
+ * Obtém uma cópia da configuração do sistema
+ */
+system_config_t system_commands_get_config(void);
+
+/**
+ * Substitui a configuração do sistema pela salva na NVS (boot, antes das tasks)
+ * Valores fora dos limites mantêm o padrão
+ */
+void system_commands_restore_config(const system_config_t *cfg);
+
+/**
+ * Aplica um par chave/valor JSON (read_period_minutes, period_min_minutes,
+ * period_max_minutes, solenoid_enabled)
+ * @param cfg Configuração de destino, ou NULL para a configuração ativa
+ *            (o período passa pelos limites de set_read_period)
+ * @return true se a chave é conhecida e o valor é válido
+ */
+bool system_commands_set_field(system_config_t *cfg, const char *js,
+                               const json_token_t *key, const json_token_t *value);
+
+/**
+ * @brief Prepara campos do sistema sem alterar a configuração ativa
+ * @param tokens Documento já tokenizado (objeto raiz com os campos)
+ * @param staged Recebe a configuração atual com os campos do documento aplicados
+ * @param mask Recebe um bit por campo presente (ordem de system_commands_set_field)
+ * @return Número de campos válidos
+ */
+int system_commands_stage_fields(const char *js, const json_token_t *tokens, int count,
+                                 system_config_t *staged, uint32_t *mask);
+
+/**
+ * Escreve os campos da configuração atual como pares JSON
+ * @param since Se não NULL, escreve apenas os campos diferentes desta cópia
+ * @return Número de campos escritos
+ */
+int system_commands_write_fields(json_writer_t *w, const system_config_t *since);
+
 /**
  * Publica status do sistema
  */
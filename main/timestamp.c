@@ -0,0 +1,115 @@
+#include "timestamp.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include <sys/time.h>
+#include <time.h>
+
+static const char *TAG = "TIMESTAMP";
+
+// Na RTC: sobrevive ao deep sleep e a resets por software (zerado ao ligar)
+static RTC_DATA_ATTR struct {
+    int64_t last_ms;        // Último horário entregue
+    int64_t last_sync_ms;   // Horário da última sincronização do SNTP (0 = nunca)
+} rtc_clock;
+
+static int64_t offset_ms = 0;   // Época - esp_timer
+static bool epoch = false;      // offset_ms aponta para uma data (não só uptime)
+static portMUX_TYPE clock_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static int64_t timestamp_system_ms(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+void timestamp_init(void)
+{
+    int64_t uptime_ms = esp_timer_get_time() / 1000;
+    int64_t system_ms = timestamp_system_ms();
+
+    if (system_ms >= TIMESTAMP_VALID_AFTER_MS) {
+        // Relógio mantido pela RTC (deep sleep, restart)
+        offset_ms = system_ms - uptime_ms;
+        epoch = true;
+    } else if (rtc_clock.last_ms >= TIMESTAMP_VALID_AFTER_MS) {
+        // Relógio perdido: continua do último horário conhecido, nunca para trás
+        offset_ms = rtc_clock.last_ms - uptime_ms;
+        epoch = true;
+        struct timeval tv = {
+            .tv_sec = rtc_clock.last_ms / 1000,
+            .tv_usec = (rtc_clock.last_ms % 1000) * 1000,
+        };
+        settimeofday(&tv, NULL);
+        ESP_LOGW(TAG, "Relógio perdido: continuando do último horário conhecido");
+    } else {
+        offset_ms = 0;   // Só uptime até o SNTP
+        epoch = false;
+    }
+
+    timestamp_t ts = timestamp_now();
+    ESP_LOGI(TAG, "Horário %s", ts.synced ? "sincronizado" : epoch ? "sem sincronização recente" : "desconhecido (uptime)");
+}
+
+void timestamp_on_sync(void)
+{
+    int64_t system_ms = timestamp_system_ms();
+    int64_t new_offset_ms = system_ms - esp_timer_get_time() / 1000;
+
+    portENTER_CRITICAL(&clock_mux);
+    int64_t step_ms = epoch ? new_offset_ms - offset_ms : 0;
+    offset_ms = new_offset_ms;
+    epoch = true;
+    rtc_clock.last_sync_ms = system_ms;
+    portEXIT_CRITICAL(&clock_mux);
+
+    if (step_ms != 0) {
+        ESP_LOGI(TAG, "Sincronizado (correção de %lld ms)", (long long)step_ms);
+    }
+}
+
+timestamp_t timestamp_now(void)
+{
+    int64_t uptime_ms = esp_timer_get_time() / 1000;
+    timestamp_t ts;
+
+    portENTER_CRITICAL(&clock_mux);
+    ts.ms = offset_ms + uptime_ms;
+    ts.synced = rtc_clock.last_sync_ms != 0 && ts.ms - rtc_clock.last_sync_ms < TIMESTAMP_SYNC_MAX_AGE_MS;
+    if (epoch) {
+        rtc_clock.last_ms = ts.ms;
+    }
+    portEXIT_CRITICAL(&clock_mux);
+    return ts;
+}
+
+int64_t timestamp_now_ms(void)
+{
+    return timestamp_now().ms;
+}
+
+void timestamp_add_json(json_writer_t *w, timestamp_t ts)
+{
+    json_writer_add_int(w, "timestamp", ts.ms);
+    if (!ts.synced) {
+        json_writer_add_bool(w, "unsynced", true);
+    }
+}
+
+bool timestamp_format(timestamp_t ts, char *buf, size_t size)
+{
+    if (ts.ms < TIMESTAMP_VALID_AFTER_MS) {
+        if (size > 0) {
+            buf[0] = '\0';
+        }
+        return false;
+    }
+
+    time_t seconds = (time_t)(ts.ms / 1000);
+    struct tm timeinfo;
+    localtime_r(&seconds, &timeinfo);
+    strftime(buf, size, "%Y-%m-%d %H:%M:%S", &timeinfo);
+    return true;
+}
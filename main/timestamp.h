@@ -0,0 +1,62 @@
+#ifndef TIMESTAMP_H
+#define TIMESTAMP_H
+
+#include "json_writer.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Horário único para os payloads (ms desde a época Unix)
+ *
+ * Um offset em cache somado ao esp_timer: sem syscall nem localtime_r no
+ * caminho das leituras. O offset é refeito a cada sincronização do SNTP e o
+ * último horário conhecido fica na RTC (deep sleep e resets por software).
+ *
+ * Sem nenhuma sincronização o horário continua do último conhecido, ou do boot
+ * (uptime) se não houver nenhum, e as amostras saem com "unsynced": true.
+ * O relógio da RTC (oscilador RC) deriva no deep sleep: sem sincronizar por
+ * TIMESTAMP_SYNC_MAX_AGE_MS o horário volta a ser tratado como não sincronizado.
+ */
+
+#define TIMESTAMP_VALID_AFTER_MS 1704067200000LL   // 2024-01-01: antes disso o relógio não foi acertado
+#define TIMESTAMP_SYNC_MAX_AGE_MS (24LL * 3600 * 1000)
+
+typedef struct {
+    int64_t ms;    // ms desde 1970 (ou desde o boot, sem horário conhecido)
+    bool synced;   // Relógio acertado pelo SNTP há menos de TIMESTAMP_SYNC_MAX_AGE_MS
+} timestamp_t;
+
+/**
+ * @brief Calcula o offset a partir do relógio do sistema e do estado na RTC
+ * Primeira coisa do app_main (antes das amostras do despertar de deep sleep)
+ */
+void timestamp_init(void);
+
+/**
+ * @brief Chamada a cada sincronização do SNTP (refaz o offset)
+ */
+void timestamp_on_sync(void);
+
+/**
+ * @brief Horário atual; barato o bastante para cada leitura
+ */
+timestamp_t timestamp_now(void);
+
+/**
+ * @brief Atalho para timestamp_now().ms
+ */
+int64_t timestamp_now_ms(void);
+
+/**
+ * @brief Escreve "timestamp" e, sem sincronização, "unsynced": true
+ */
+void timestamp_add_json(json_writer_t *w, timestamp_t ts);
+
+/**
+ * @brief Formata em hora local "AAAA-MM-DD HH:MM:SS" (só para logs e status)
+ * @return false (buf = "") se o horário não é uma data (ms desde o boot)
+ */
+bool timestamp_format(timestamp_t ts, char *buf, size_t size);
+
+#endif // TIMESTAMP_H
@@ -0,0 +1,296 @@
+// Leitura do master secret da sessão negociada (detecção de retomada)
+#define MBEDTLS_ALLOW_PRIVATE_ACCESS
+
+#include "tls_transport.h"
+#include "power_manager.h"
+#include "energy_model.h"
+#include "sdkconfig.h"
+#include "esp_tls.h"
+#include "esp_crc.h"
+#include "mbedtls/ssl.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include <string.h>
+#include <sys/select.h>
+#include <sys/time.h>
+
+static const char *TAG = "TLS_TRANSPORT";
+
+typedef struct {
+    esp_tls_t *tls;
+    esp_tls_cfg_t cfg;
+} tls_transport_ctx_t;
+
+// Um único cliente MQTT: contexto estático
+static tls_transport_ctx_t tls_ctx;
+
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+static esp_tls_client_session_t *saved_session = NULL;
+static uint32_t saved_fingerprint = 0;   // CRC do master secret da sessão salva
+#endif
+
+// Falhas seguidas oferecendo a sessão antes de descartá-la
+// (servidor que recusa o ticket cai no handshake completo sozinho;
+// falhas isoladas costumam ser de rede)
+#define TLS_SESSION_MAX_FAILURES 2
+static int session_failures = 0;
+
+// Sobrevive ao deep sleep (zerado só no power-on)
+static RTC_DATA_ATTR tls_transport_stats_t stats;
+
+// Identifica a sessão da conexão. No TLS 1.2 a sessão retomada reaproveita o
+// master secret da oferecida; num handshake completo ele é novo. Só um CRC é
+// guardado, não o segredo. (mbedtls_ssl_get_session não serve: exporta uma vez só)
+static uint32_t tls_transport_fingerprint(esp_tls_t *tls)
+{
+    mbedtls_ssl_context *ssl = esp_tls_get_ssl_context(tls);
+    if (ssl == NULL || ssl->MBEDTLS_PRIVATE(session) == NULL) {
+        return 0;
+    }
+    const unsigned char *master = ssl->MBEDTLS_PRIVATE(session)->MBEDTLS_PRIVATE(master);
+    return esp_crc32_le(0, master, sizeof(ssl->MBEDTLS_PRIVATE(session)->MBEDTLS_PRIVATE(master)));
+}
+
+// Guarda a sessão mais recente (tickets TLS 1.3 chegam após o handshake)
+static void tls_transport_save_session(esp_tls_t *tls)
+{
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    esp_tls_client_session_t *session = esp_tls_get_client_session(tls);
+    if (session != NULL) {
+        esp_tls_free_client_session(saved_session);
+        saved_session = session;
+        saved_fingerprint = tls_transport_fingerprint(tls);
+    }
+#else
+    (void)tls;
+#endif
+}
+
+void tls_transport_forget_session(void)
+{
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    esp_tls_free_client_session(saved_session);
+    saved_session = NULL;
+#endif
+    session_failures = 0;
+}
+
+bool tls_transport_has_session(void)
+{
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    return saved_session != NULL;
+#else
+    return false;
+#endif
+}
+
+static void tls_transport_account(bool resumed, uint32_t elapsed_ms)
+{
+    stats.handshakes++;
+    stats.last_ms = elapsed_ms;
+    if (resumed) {
+        stats.resumed++;
+        stats.resumed_last_ms = elapsed_ms;
+        if (elapsed_ms > stats.resumed_max_ms) {
+            stats.resumed_max_ms = elapsed_ms;
+        }
+    } else {
+        stats.full_last_ms = elapsed_ms;
+        if (elapsed_ms > stats.full_max_ms) {
+            stats.full_max_ms = elapsed_ms;
+        }
+    }
+}
+
+static int tls_transport_connect(esp_transport_handle_t t, const char *host, int port, int timeout_ms)
+{
+    tls_transport_ctx_t *ctx = esp_transport_get_context_data(t);
+
+    ctx->tls = esp_tls_init();
+    if (ctx->tls == NULL) {
+        return ERR_TCP_TRANSPORT_NO_MEM;
+    }
+
+    bool offered = tls_transport_has_session();
+    uint32_t offered_fingerprint = 0;
+    ctx->cfg.timeout_ms = timeout_ms;
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    ctx->cfg.client_session = saved_session;
+    offered_fingerprint = saved_fingerprint;
+#endif
+
+    // Handshake na frequência máxima: menos tempo com o rádio ligado esperando a CPU
+    power_manager_lock(POWER_LOCK_TLS);
+    int64_t start_us = esp_timer_get_time();
+    int ret = esp_tls_conn_new_sync(host, strlen(host), port, &ctx->cfg, ctx->tls);
+    uint32_t elapsed_ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+    power_manager_unlock(POWER_LOCK_TLS);
+
+    if (ret <= 0) {
+        stats.failures++;
+        ESP_LOGE(TAG, "Falha no handshake com %s:%d após %lu ms", host, port,
+                 (unsigned long)elapsed_ms);
+        if (offered && ++session_failures >= TLS_SESSION_MAX_FAILURES) {
+            ESP_LOGW(TAG, "Descartando sessão salva");
+            tls_transport_forget_session();
+        }
+        esp_tls_conn_destroy(ctx->tls);
+        ctx->tls = NULL;
+        return ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+    }
+
+    // Ticket oferecido não garante retomada: o servidor pode recusá-lo e fazer o handshake completo
+    bool resumed = offered && offered_fingerprint != 0 &&
+                   tls_transport_fingerprint(ctx->tls) == offered_fingerprint;
+    if (offered && !resumed) {
+        stats.rejected++;
+    }
+
+    session_failures = 0;
+    tls_transport_account(resumed, elapsed_ms);
+    if (resumed) {
+        energy_model_add_traffic(ENERGY_TLS_RESUMED_TX_BYTES, ENERGY_TLS_RESUMED_RX_BYTES);
+    } else {
+        energy_model_add_traffic(ENERGY_TLS_FULL_TX_BYTES, ENERGY_TLS_FULL_RX_BYTES);
+    }
+    tls_transport_save_session(ctx->tls);
+    ESP_LOGI(TAG, "Handshake %s em %lu ms", resumed ? "retomado" :
+             offered ? "completo (sessão recusada)" : "completo", (unsigned long)elapsed_ms);
+    return 0;
+}
+
+static int tls_transport_poll(esp_transport_handle_t t, int timeout_ms, bool for_read)
+{
+    tls_transport_ctx_t *ctx = esp_transport_get_context_data(t);
+    int sockfd;
+
+    if (ctx->tls == NULL || esp_tls_get_conn_sockfd(ctx->tls, &sockfd) != ESP_OK) {
+        return -1;
+    }
+    // Dados já decifrados no buffer do mbedTLS não aparecem no socket
+    if (for_read && esp_tls_get_bytes_avail(ctx->tls) > 0) {
+        return 1;
+    }
+
+    fd_set fds;
+    fd_set errfds;
+    FD_ZERO(&fds);
+    FD_ZERO(&errfds);
+    FD_SET(sockfd, &fds);
+    FD_SET(sockfd, &errfds);
+    struct timeval timeout = {
+        .tv_sec = timeout_ms / 1000,
+        .tv_usec = (timeout_ms % 1000) * 1000,
+    };
+
+    int ret = select(sockfd + 1, for_read ? &fds : NULL, for_read ? NULL : &fds, &errfds,
+                     timeout_ms >= 0 ? &timeout : NULL);
+    if (ret > 0 && FD_ISSET(sockfd, &errfds)) {
+        return -1;
+    }
+    return ret;
+}
+
+static int tls_transport_poll_read(esp_transport_handle_t t, int timeout_ms)
+{
+    return tls_transport_poll(t, timeout_ms, true);
+}
+
+static int tls_transport_poll_write(esp_transport_handle_t t, int timeout_ms)
+{
+    return tls_transport_poll(t, timeout_ms, false);
+}
+
+static int tls_transport_read(esp_transport_handle_t t, char *buffer, int len, int timeout_ms)
+{
+    tls_transport_ctx_t *ctx = esp_transport_get_context_data(t);
+
+    int poll = tls_transport_poll_read(t, timeout_ms);
+    if (poll <= 0) {
+        return poll;
+    }
+
+    int ret = esp_tls_conn_read(ctx->tls, buffer, len);
+    if (ret == ESP_TLS_ERR_SSL_WANT_READ || ret == ESP_TLS_ERR_SSL_TIMEOUT) {
+        return ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT;
+    }
+    if (ret == 0) {
+        return ERR_TCP_TRANSPORT_CONNECTION_CLOSED_BY_FIN;
+    }
+    if (ret < 0) {
+        ESP_LOGE(TAG, "Erro de leitura TLS: -0x%x", -ret);
+    } else {
+        energy_model_add_traffic(0, ret);
+    }
+    return ret;
+}
+
+static int tls_transport_write(esp_transport_handle_t t, const char *buffer, int len, int timeout_ms)
+{
+    tls_transport_ctx_t *ctx = esp_transport_get_context_data(t);
+
+    int poll = tls_transport_poll_write(t, timeout_ms);
+    if (poll <= 0) {
+        return poll;
+    }
+
+    int ret = esp_tls_conn_write(ctx->tls, buffer, len);
+    if (ret < 0) {
+        ESP_LOGE(TAG, "Erro de escrita TLS: -0x%x", -ret);
+    } else {
+        energy_model_add_traffic(ret, 0);
+    }
+    return ret;
+}
+
+static int tls_transport_close(esp_transport_handle_t t)
+{
+    tls_transport_ctx_t *ctx = esp_transport_get_context_data(t);
+
+    if (ctx->tls != NULL) {
+        tls_transport_save_session(ctx->tls);
+        esp_tls_conn_destroy(ctx->tls);
+        ctx->tls = NULL;
+    }
+    return 0;
+}
+
+static int tls_transport_destroy(esp_transport_handle_t t)
+{
+    return tls_transport_close(t);
+}
+
+esp_transport_handle_t tls_transport_create(const char *root_ca, const char *device_cert,
+                                            const char *device_key)
+{
+    esp_transport_handle_t t = esp_transport_init();
+    if (t == NULL) {
+        return NULL;
+    }
+
+    // Tamanhos em PEM incluem o '\0'
+    memset(&tls_ctx, 0, sizeof(tls_ctx));
+    tls_ctx.cfg.cacert_buf = (const unsigned char *)root_ca;
+    tls_ctx.cfg.cacert_bytes = strlen(root_ca) + 1;
+    tls_ctx.cfg.clientcert_buf = (const unsigned char *)device_cert;
+    tls_ctx.cfg.clientcert_bytes = strlen(device_cert) + 1;
+    tls_ctx.cfg.clientkey_buf = (const unsigned char *)device_key;
+    tls_ctx.cfg.clientkey_bytes = strlen(device_key) + 1;
+
+    esp_transport_set_context_data(t, &tls_ctx);
+    esp_transport_set_func(t, tls_transport_connect, tls_transport_read, tls_transport_write,
+                           tls_transport_close, tls_transport_poll_read, tls_transport_poll_write,
+                           tls_transport_destroy);
+    esp_transport_set_default_port(t, 8883);
+
+#if !CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    ESP_LOGW(TAG, "CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS desabilitado: sem retomada de sessão");
+#endif
+    return t;
+}
+
+tls_transport_stats_t tls_transport_get_stats(void)
+{
+    return stats;
+}
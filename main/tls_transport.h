@@ -0,0 +1,53 @@
+#ifndef TLS_TRANSPORT_H
+#define TLS_TRANSPORT_H
+
+#include "esp_transport.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Transporte TLS do MQTT com retomada de sessão (session ticket)
+ *
+ * Substitui o transporte SSL interno do esp-mqtt para poder oferecer a
+ * sessão salva em cada reconexão: o handshake retomado dispensa a troca
+ * de certificados e as operações RSA do handshake completo.
+ * A sessão fica na RAM (sobrevive ao light sleep); as estatísticas ficam
+ * na memória RTC e sobrevivem também ao deep sleep.
+ */
+
+// Estatísticas de handshake
+typedef struct {
+    uint32_t handshakes;       // Handshakes concluídos
+    uint32_t resumed;          // Concluídos retomando a sessão salva (servidor aceitou)
+    uint32_t rejected;         // Sessão oferecida e recusada: handshake completo
+    uint32_t failures;         // Falhas de conexão/handshake
+    uint32_t last_ms;          // Duração do último handshake
+    uint32_t full_last_ms;     // Último handshake completo
+    uint32_t full_max_ms;      // Maior handshake completo
+    uint32_t resumed_last_ms;  // Último handshake retomado
+    uint32_t resumed_max_ms;   // Maior handshake retomado
+} tls_transport_stats_t;
+
+/**
+ * @brief Cria o transporte TLS (CA e certificados em PEM terminados em '\0')
+ * @return Handle para esp_mqtt_client_config_t.network.transport ou NULL
+ */
+esp_transport_handle_t tls_transport_create(const char *root_ca, const char *device_cert,
+                                            const char *device_key);
+
+/**
+ * @brief Descarta a sessão salva (próxima conexão faz handshake completo)
+ */
+void tls_transport_forget_session(void);
+
+/**
+ * @brief Indica se há sessão salva para a próxima conexão
+ */
+bool tls_transport_has_session(void);
+
+/**
+ * @brief Obtém estatísticas de handshake
+ */
+tls_transport_stats_t tls_transport_get_stats(void);
+
+#endif // TLS_TRANSPORT_H
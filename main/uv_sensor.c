@@ -2,15 +2,23 @@
 #include "day_night_control.h"
 #include "system_commands.h"
 #include "power_manager.h"
+#include "sampling_governor.h"
+#include "json_writer.h"
+#include "mqtt_manager.h"
+#include "connectivity_manager.h"
+#include "timestamp.h"
 #include "esp_adc/adc_oneshot.h"
 #include "esp_log.h"
+#include "esp_attr.h"
 #include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include <stdio.h>
 
 static const char *TAG = "UV_SENSOR";
-extern bool mqtt_connected;
+
+// Converte leitura bruta (0-4095) em centésimos de volt (0-330)
+#define UV_RAW_TO_CENTIVOLTS(raw) (((raw) * 330) / 4095)
 
 // Handle ADC compartilhado - declarado externamente
 extern adc_oneshot_unit_handle_t adc1_handle;
@@ -38,7 +46,9 @@ esp_err_t uv_sensor_read(int *value)
     
     // Lê o valor do ADC (0-4095)
     int raw_value = 0;
+    power_manager_lock(POWER_LOCK_ADC);
     esp_err_t ret = adc_oneshot_read(adc1_handle, ADC_CHANNEL_4, &raw_value);
+    power_manager_unlock(POWER_LOCK_ADC);
     if (ret == ESP_OK) {
         *value = raw_value;
     }
@@ -51,15 +61,12 @@ void uv_sensor_task(void *pvParameters)
     esp_mqtt_client_handle_t client = (esp_mqtt_client_handle_t)pvParameters;
     int uv_value = 0;
     char message[256];
-    int counter = 0;
+    static RTC_DATA_ATTR int counter = 0;   // Continua após o deep sleep
     bool was_night = false;
     
     ESP_LOGI(TAG, "Task do sensor UV iniciada");
    // ESP_LOGW(TAG, "DEBUG: Controle dia/noite DESABILITADO - Sensor UV funcionando 24h");
     
-    // Aguarda inicialização
-    vTaskDelay(pdMS_TO_TICKS(5000));
-    
     while (1) {
         
         // Verifica se é horário noturno
@@ -67,59 +74,61 @@ void uv_sensor_task(void *pvParameters)
         
         // Log quando muda de dia para noite ou vice-versa
         if (is_night != was_night) {
+            // À noite o UV não lê: o ciclo de sleep não espera por ele
             if (is_night) {
                 ESP_LOGI(TAG, "Horário noturno detectado - Sensor UV pausado");
+                power_manager_cycle_leave(POWER_SENSOR_UV);
             } else {
                 ESP_LOGI(TAG, "Horário diurno detectado - Sensor UV ativado");
+                power_manager_cycle_join(POWER_SENSOR_UV);
             }
             was_night = is_night;
         }
         
-        // Se é noite, apenas aguarda e não publica
-        if (is_night) {
-            vTaskDelay(pdMS_TO_TICKS(60000)); // Verifica a cada 1 minuto durante a noite
-            continue;
-        }
-        
         // ===== FIM DEBUG =====
         
-        // Durante o dia, funciona normalmente
-        if (mqtt_connected && client != NULL) {
+        // Bloqueia até haver sessão MQTT (sem polling)
+        connectivity_manager_wait(CONNECTIVITY_MQTT_BIT, portMAX_DELAY);
+        
+        // Só lê com o período vencido (UV nunca à noite)
+        if (client != NULL && sampling_governor_is_due(SAMPLING_UV)) {
             esp_err_t res = uv_sensor_read(&uv_value);
             
             if (res == ESP_OK) {
-                int64_t timestamp_ms = esp_timer_get_time() / 1000;
+                timestamp_t ts = timestamp_now();
                 int hour = get_current_hour();
                 
-                // Converte para voltagem aproximada (0-3.3V)
-                float voltage = (uv_value / 4095.0) * 3.3;
+                // Converte para voltagem aproximada (0-3.3V) em ponto fixo
+                int voltage_cv = UV_RAW_TO_CENTIVOLTS(uv_value);
                 
-                snprintf(message, sizeof(message),
-                    "{\"device_id\":\"ESP32_Client\",\"uv_raw\":%d,\"uv_voltage\":%.2f,\"hour\":%d,\"counter\":%d,\"timestamp\":%lld}",
-                    uv_value, voltage, hour, counter, timestamp_ms);
+                json_writer_t w;
+                json_writer_init(&w, message, sizeof(message));
+                json_writer_begin_object(&w, NULL);
+                mqtt_manager_add_device_id(&w);
+                json_writer_add_int(&w, "uv_raw", uv_value);
+                json_writer_add_fixed(&w, "uv_voltage", voltage_cv, 2);
+                json_writer_add_int(&w, "hour", hour);
+                json_writer_add_int(&w, "counter", counter);
+                json_writer_add_int(&w, "seq", mqtt_manager_next_seq(TOPIC_UV_SENSOR));
+                timestamp_add_json(&w, ts);
+                json_writer_end_object(&w);
+                size_t len = json_writer_finish(&w);
                 
-                int msg_id = esp_mqtt_client_publish(client, TOPIC_UV_SENSOR, message, 0, 1, 0);
-                ESP_LOGI(TAG, "Publicado [msg_id=%d, hora=%02d]: UV=%d (%.2fV)", 
-                         msg_id, hour, uv_value, voltage);
+                esp_err_t pub = len > 0 ? mqtt_manager_publish(TOPIC_UV_SENSOR, message, len) : ESP_ERR_INVALID_SIZE;
+                ESP_LOGI(TAG, "Publicado [%s, hora=%02d]: UV=%d (%d.%02dV)", 
+                         esp_err_to_name(pub), hour, uv_value, voltage_cv / 100, voltage_cv % 100);
                 
-                // Marca que publicou dados
-                power_manager_mark_sensor_published("uv");
+                sampling_governor_update(SAMPLING_UV, (uv_value * 100) / 4095);
             } else {
                 ESP_LOGW(TAG, "Falha ao ler sensor UV: %d", res);
             }
             counter++;
-        } else {
-            ESP_LOGW(TAG, "MQTT não conectado, aguardando...");
         }
         
-        // Usa período configurável com power management
-        int delay_ms = system_commands_get_read_period_ms();
+        // Aguarda a próxima janela com power management
+        int delay_ms = sampling_governor_window_ms();
         
-        if (power_manager_should_sleep(delay_ms)) {
-            power_manager_sleep(delay_ms);
-        } else {
-            vTaskDelay(pdMS_TO_TICKS(delay_ms));
-        }
+        power_manager_end_cycle(POWER_SENSOR_UV, delay_ms);
     }
 }
 
@@ -135,16 +144,27 @@ void uv_sensor_force_publish(esp_mqtt_client_handle_t client)
     
     if (res == ESP_OK) {
         char message[256];
-        int64_t timestamp_ms = esp_timer_get_time() / 1000;
+        timestamp_t ts = timestamp_now();
         int hour = get_current_hour();
-        float voltage = (uv_value / 4095.0) * 3.3;
+        int voltage_cv = UV_RAW_TO_CENTIVOLTS(uv_value);
         
-        snprintf(message, sizeof(message),
-            "{\"device_id\":\"ESP32_Client\",\"uv_raw\":%d,\"uv_voltage\":%.2f,\"hour\":%d,\"forced\":true,\"timestamp\":%lld}",
-            uv_value, voltage, hour, timestamp_ms);
+        json_writer_t w;
+        json_writer_init(&w, message, sizeof(message));
+        json_writer_begin_object(&w, NULL);
+        mqtt_manager_add_device_id(&w);
+        json_writer_add_int(&w, "uv_raw", uv_value);
+        json_writer_add_fixed(&w, "uv_voltage", voltage_cv, 2);
+        json_writer_add_int(&w, "hour", hour);
+        json_writer_add_bool(&w, "forced", true);
+        json_writer_add_int(&w, "seq", mqtt_manager_next_seq(TOPIC_UV_SENSOR));
+        timestamp_add_json(&w, ts);
+        json_writer_end_object(&w);
+        size_t len = json_writer_finish(&w);
         
-        esp_mqtt_client_publish(client, TOPIC_UV_SENSOR, message, 0, 1, 0);
-        ESP_LOGI(TAG, "UV forçado: %d (%.2fV)", uv_value, voltage);
+        if (len > 0) {
+            mqtt_manager_publish(TOPIC_UV_SENSOR, message, len);
+        }
+        ESP_LOGI(TAG, "UV forçado: %d (%d.%02dV)", uv_value, voltage_cv / 100, voltage_cv % 100);
     } else {
         ESP_LOGW(TAG, "Falha ao ler sensor UV");
     }
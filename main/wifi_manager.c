@@ -3,41 +3,291 @@
 #include "esp_event.h"
 #include "esp_log.h"
 #include "esp_netif.h"
+#include "lwip/dhcp.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "connectivity_manager.h"
+#include "config_store.h"
+#include "energy_model.h"
+#include "timestamp.h"
+#include <string.h>
 
 static const char *TAG = "WIFI_MANAGER";
-static bool wifi_connected = false;
+
+// Último AP associado (na RTC: vale também ao acordar do deep sleep)
+static RTC_DATA_ATTR wifi_ap_cache_t ap_cache;
+
+// Última concessão do DHCP (só na RTC: após perder energia a idade é desconhecida)
+static RTC_DATA_ATTR struct {
+    bool valid;
+    esp_netif_ip_info_t ip_info;
+    esp_ip4_addr_t dns;
+    uint32_t lease_s;      // Tempo concedido pelo servidor (0 = desconhecido)
+    int64_t obtained_ms;   // timestamp_now_ms() ao receber a concessão
+} lease_cache;
+
+static wifi_config_t wifi_config = { 0 };   // SSID, senha e segurança (sem cache)
+static wifi_manager_stats_t stats = {0};
+static esp_netif_t *sta_netif = NULL;
+static esp_timer_handle_t ip_check_timer = NULL;
+static int64_t radio_on_us = 0;             // Instante em que o rádio foi ligado
+static int64_t connected_us = 0;            // Instante da associação (para o tempo até o IP)
+static bool using_cache = false;            // Configuração aplicada com o BSSID em cache
+static bool associated = false;             // Associado ao AP agora
+static bool timing_assoc = false;           // Primeira associação desde que o rádio ligou
+static bool timing_ip = false;              // Primeiro IP desde a associação
+
+// IP estático (wifi_manager_set_static_ip)
+static bool static_ip_set = false;
+static bool static_ip_failed = false;       // Sem MQTT com ele: DHCP até o próximo boot
+static esp_netif_ip_info_t static_ip_info;
+static esp_ip4_addr_t static_dns;
+
+static wifi_ip_mode_t ip_mode = WIFI_IP_DHCP;
+
+static const char *wifi_ip_mode_names[] = {"dhcp", "lease", "static"};
+
+// Concessão anterior ainda dentro do prazo de reaproveitamento: metade do tempo
+// concedido (quando o cliente DHCP renovaria), no máximo WIFI_MANAGER_LEASE_REUSE_MS
+static bool wifi_manager_lease_usable(void)
+{
+    if (!lease_cache.valid || lease_cache.lease_s == 0) {
+        return false;
+    }
+    int64_t limit_ms = (int64_t)lease_cache.lease_s * 1000 / 2;
+    if (limit_ms > WIFI_MANAGER_LEASE_REUSE_MS) {
+        limit_ms = WIFI_MANAGER_LEASE_REUSE_MS;
+    }
+    int64_t age_ms = timestamp_now_ms() - lease_cache.obtained_ms;
+    return age_ms >= 0 && age_ms < limit_ms;
+}
+
+// Lê o tempo concedido na thread do lwIP (o esp_netif não o expõe)
+static esp_err_t wifi_manager_read_lease_time(void *ctx)
+{
+    struct netif *netif = esp_netif_get_netif_impl(sta_netif);
+    struct dhcp *dhcp = netif != NULL ? netif_dhcp_data(netif) : NULL;
+
+    *(uint32_t *)ctx = dhcp != NULL ? dhcp->offered_t0_lease : 0;
+    return ESP_OK;
+}
+
+static void wifi_manager_set_dns(esp_ip4_addr_t dns)
+{
+    esp_netif_dns_info_t dns_info = {0};
+    dns_info.ip.type = ESP_IPADDR_TYPE_V4;
+    dns_info.ip.u_addr.ip4.addr = dns.addr;
+    esp_netif_set_dns_info(sta_netif, ESP_NETIF_DNS_MAIN, &dns_info);
+}
+
+// Escolhe a origem do IP antes de associar: estático, concessão em cache ou DHCP
+static void wifi_manager_apply_ip(void)
+{
+    const esp_netif_ip_info_t *ip_info = NULL;
+    esp_ip4_addr_t dns = {0};
+
+    if (static_ip_set && !static_ip_failed) {
+        ip_mode = WIFI_IP_STATIC;
+        ip_info = &static_ip_info;
+        dns = static_dns;
+    } else if (wifi_manager_lease_usable()) {
+        ip_mode = WIFI_IP_LEASE;
+        ip_info = &lease_cache.ip_info;
+        dns = lease_cache.dns;
+    } else {
+        ip_mode = WIFI_IP_DHCP;
+    }
+
+    if (ip_info == NULL) {
+        esp_netif_dhcpc_start(sta_netif);   // Já iniciado: nada muda
+        return;
+    }
+    esp_netif_dhcpc_stop(sta_netif);
+    if (esp_netif_set_ip_info(sta_netif, ip_info) != ESP_OK) {
+        ESP_LOGW(TAG, "Falha ao aplicar o IP fixo, usando DHCP");
+        ip_mode = WIFI_IP_DHCP;
+        esp_netif_dhcpc_start(sta_netif);
+        return;
+    }
+    wifi_manager_set_dns(dns);
+}
+
+// IP fixo sem MQTT no prazo: endereço em conflito ou fora da rede, volta ao DHCP
+static void wifi_manager_ip_check(void *arg)
+{
+    if (ip_mode == WIFI_IP_DHCP || connectivity_manager_has(CONNECTIVITY_MQTT_BIT)) {
+        return;
+    }
+
+    ESP_LOGW(TAG, "Sem MQTT %d ms após o IP %s: voltando ao DHCP", WIFI_MANAGER_IP_CHECK_MS,
+             wifi_ip_mode_names[ip_mode]);
+    if (ip_mode == WIFI_IP_STATIC) {
+        static_ip_failed = true;
+    } else {
+        lease_cache.valid = false;
+    }
+    stats.dhcp_fallbacks++;
+    ip_mode = WIFI_IP_DHCP;
+    timing_ip = false;   // O tempo até o IP vale só para a associação
+    esp_netif_dhcpc_start(sta_netif);
+}
+
+// Aplica a configuração; com cache válido associa direto ao BSSID no canal conhecido
+static void wifi_manager_apply_config(void)
+{
+    wifi_config_t config = wifi_config;
+
+    using_cache = ap_cache.valid;
+    if (using_cache) {
+        config.sta.bssid_set = true;
+        memcpy(config.sta.bssid, ap_cache.bssid, sizeof(config.sta.bssid));
+        config.sta.channel = ap_cache.channel;
+    }
+    esp_wifi_set_config(WIFI_IF_STA, &config);
+}
+
+static void wifi_manager_on_connected(const wifi_event_sta_connected_t *event)
+{
+    connected_us = esp_timer_get_time();
+    uint32_t assoc_ms = (connected_us - radio_on_us) / 1000;
+
+    associated = true;
+    timing_ip = true;
+    if (timing_assoc) {
+        timing_assoc = false;
+        stats.last_assoc_ms = assoc_ms;
+        if (assoc_ms > stats.max_assoc_ms) {
+            stats.max_assoc_ms = assoc_ms;
+        }
+        if (using_cache) {
+            stats.cache_hits++;
+        }
+        ESP_LOGI(TAG, "Associado em %lu ms (canal %u%s)", (unsigned long)assoc_ms, event->channel,
+                 using_cache ? ", BSSID em cache" : "");
+    }
+
+    // AP novo ou mudou de canal: também vai para a NVS
+    if (!ap_cache.valid || ap_cache.channel != event->channel ||
+        memcmp(ap_cache.bssid, event->bssid, sizeof(ap_cache.bssid)) != 0) {
+        memcpy(ap_cache.bssid, event->bssid, sizeof(ap_cache.bssid));
+        ap_cache.channel = event->channel;
+        ap_cache.valid = true;
+        config_store_mark_dirty(CONFIG_STORE_WIFI);
+    }
+}
+
+static void wifi_manager_on_got_ip(const ip_event_got_ip_t *event)
+{
+    if (timing_ip) {
+        timing_ip = false;
+        stats.last_ip_ms = (esp_timer_get_time() - connected_us) / 1000;
+        if (stats.last_ip_ms > stats.max_ip_ms) {
+            stats.max_ip_ms = stats.last_ip_ms;
+        }
+    }
+    ESP_LOGI(TAG, "WiFi conectado! IP: " IPSTR " (%s, %lu ms após associar)", IP2STR(&event->ip_info.ip),
+             wifi_ip_mode_names[ip_mode], (unsigned long)stats.last_ip_ms);
+
+    if (ip_mode == WIFI_IP_DHCP) {
+        // Concessão nova: reaproveitada nos próximos despertares
+        esp_netif_dns_info_t dns_info = {0};
+        esp_netif_get_dns_info(sta_netif, ESP_NETIF_DNS_MAIN, &dns_info);
+        uint32_t lease_s = 0;
+        esp_netif_tcpip_exec(wifi_manager_read_lease_time, &lease_s);
+        lease_cache.ip_info = event->ip_info;
+        lease_cache.dns.addr = dns_info.ip.u_addr.ip4.addr;
+        lease_cache.lease_s = lease_s;
+        lease_cache.obtained_ms = timestamp_now_ms();
+        lease_cache.valid = true;
+        ESP_LOGD(TAG, "Concessão do DHCP: %lu s", (unsigned long)lease_s);
+        return;
+    }
+
+    if (ip_mode == WIFI_IP_LEASE) {
+        stats.lease_reused++;
+    }
+    esp_timer_stop(ip_check_timer);
+    esp_timer_start_once(ip_check_timer, (uint64_t)WIFI_MANAGER_IP_CHECK_MS * 1000);
+}
 
 static void wifi_event_handler(void* arg, esp_event_base_t event_base,
                                 int32_t event_id, void* event_data)
 {
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
         ESP_LOGI(TAG, "WiFi iniciado, conectando...");
+        energy_model_radio_on(true);
         esp_wifi_connect();
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_STOP) {
+        energy_model_radio_on(false);
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        wifi_manager_on_connected((wifi_event_sta_connected_t*) event_data);
+        connectivity_manager_on_wifi_connected();
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        ESP_LOGW(TAG, "WiFi desconectado, tentando reconectar...");
-        wifi_connected = false;
-        esp_wifi_connect();
+        wifi_event_sta_disconnected_t* event = (wifi_event_sta_disconnected_t*) event_data;
+        ESP_LOGW(TAG, "WiFi desconectado (motivo %d)", event->reason);
+        // Tentativa pelo cache falhou (AP mudou de canal ou saiu): volta à varredura completa
+        if (using_cache && !associated) {
+            ESP_LOGW(TAG, "BSSID em cache não respondeu, voltando à varredura");
+            ap_cache.valid = false;
+            lease_cache.valid = false;   // Outro AP pode ser outra rede
+            stats.cache_misses++;
+            wifi_manager_apply_config();
+            wifi_manager_apply_ip();
+        }
+        associated = false;
+        timing_ip = false;
+        esp_timer_stop(ip_check_timer);
+        // Reconexão com backoff fica a cargo do supervisor
+        connectivity_manager_on_wifi_disconnected(event->reason);
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
-        ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
-        ESP_LOGI(TAG, "WiFi conectado! IP: " IPSTR, IP2STR(&event->ip_info.ip));
-        wifi_connected = true;
+        wifi_manager_on_got_ip((ip_event_got_ip_t*) event_data);
+        connectivity_manager_on_got_ip();
     }
 }
 
 bool wifi_manager_is_connected(void)
 {
-    return wifi_connected;
+    return connectivity_manager_has(CONNECTIVITY_IP_BIT);
+}
+
+esp_err_t wifi_manager_set_static_ip(const char *ip, const char *netmask, const char *gateway,
+                                     const char *dns)
+{
+    esp_netif_ip_info_t ip_info = {0};
+    esp_ip4_addr_t dns_addr = {0};
+
+    if (ip == NULL || netmask == NULL || gateway == NULL ||
+        esp_netif_str_to_ip4(ip, &ip_info.ip) != ESP_OK ||
+        esp_netif_str_to_ip4(netmask, &ip_info.netmask) != ESP_OK ||
+        esp_netif_str_to_ip4(gateway, &ip_info.gw) != ESP_OK ||
+        esp_netif_str_to_ip4(dns != NULL ? dns : gateway, &dns_addr) != ESP_OK) {
+        ESP_LOGE(TAG, "IP estático inválido, usando DHCP");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    static_ip_info = ip_info;
+    static_dns = dns_addr;
+    static_ip_set = true;
+    static_ip_failed = false;
+    ESP_LOGI(TAG, "IP estático configurado: %s", ip);
+    return ESP_OK;
 }
 
 void wifi_manager_init(const char *ssid, const char *password, wifi_auth_mode_t authmode)
 {
     static bool wifi_initialized = false;
-    
+
     if (!wifi_initialized) {
         ESP_LOGI(TAG, "Inicializando WiFi pela primeira vez...");
         ESP_ERROR_CHECK(esp_netif_init());
         ESP_ERROR_CHECK(esp_event_loop_create_default());
-        esp_netif_create_default_wifi_sta();
+        sta_netif = esp_netif_create_default_wifi_sta();
+
+        const esp_timer_create_args_t timer_args = {
+            .callback = wifi_manager_ip_check,
+            .name = "wifi_ip_check",
+        };
+        ESP_ERROR_CHECK(esp_timer_create(&timer_args, &ip_check_timer));
 
         wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
         ESP_ERROR_CHECK(esp_wifi_init(&cfg));
@@ -60,7 +310,7 @@ void wifi_manager_init(const char *ssid, const char *password, wifi_auth_mode_t
         esp_wifi_stop();
     }
 
-    wifi_config_t wifi_config = { 0 };
+    memset(&wifi_config, 0, sizeof(wifi_config));
     strncpy((char *)wifi_config.sta.ssid, ssid, sizeof(wifi_config.sta.ssid));
     strncpy((char *)wifi_config.sta.password, password, sizeof(wifi_config.sta.password));
     wifi_config.sta.threshold.authmode = authmode;
@@ -68,8 +318,65 @@ void wifi_manager_init(const char *ssid, const char *password, wifi_auth_mode_t
     wifi_config.sta.pmf_cfg.required = false;
 
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
+    wifi_manager_apply_config();
+    wifi_manager_apply_ip();
+    radio_on_us = esp_timer_get_time();
+    timing_assoc = true;
     ESP_ERROR_CHECK(esp_wifi_start());
 
-    ESP_LOGI(TAG, "Tentando conectar ao SSID: %s", ssid);
+    ESP_LOGI(TAG, "Tentando conectar ao SSID: %s%s (IP: %s)", ssid,
+             using_cache ? " (BSSID em cache)" : "", wifi_ip_mode_names[ip_mode]);
+}
+
+esp_err_t wifi_manager_radio_off(void)
+{
+    connectivity_manager_pause_wifi();
+    esp_err_t ret = esp_wifi_stop();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Falha ao desligar o rádio: %s", esp_err_to_name(ret));
+        connectivity_manager_resume_wifi();
+        return ret;
+    }
+
+    esp_timer_stop(ip_check_timer);
+    stats.radio_cycles++;
+    stats.last_radio_on_ms = (esp_timer_get_time() - radio_on_us) / 1000;
+    ESP_LOGI(TAG, "Rádio desligado após %lu ms ligado", (unsigned long)stats.last_radio_on_ms);
+    return ESP_OK;
+}
+
+esp_err_t wifi_manager_radio_on(void)
+{
+    wifi_manager_apply_config();
+    wifi_manager_apply_ip();
+    radio_on_us = esp_timer_get_time();
+    timing_assoc = true;
+    connectivity_manager_resume_wifi();
+
+    esp_err_t ret = esp_wifi_start();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Falha ao religar o rádio: %s", esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+wifi_manager_stats_t wifi_manager_get_stats(void)
+{
+    return stats;
+}
+
+const char *wifi_manager_ip_mode_name(void)
+{
+    return wifi_ip_mode_names[ip_mode];
+}
+
+wifi_ap_cache_t wifi_manager_get_ap_cache(void)
+{
+    return ap_cache;
+}
+
+void wifi_manager_restore_ap_cache(const wifi_ap_cache_t *cache)
+{
+    ap_cache = *cache;
+    ap_cache.valid = cache->valid && cache->channel >= 1 && cache->channel <= 14;
 }
@@ -4,8 +4,93 @@
 #include "esp_err.h"
 #include "esp_wifi.h"
 #include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Conexão rápida
+ *
+ * O último AP (BSSID e canal) fica na RTC e na NVS (config_store): religar o
+ * rádio, acordar do deep sleep ou ligar a placa associa direto, sem varredura.
+ * A última concessão do DHCP fica só na RTC e é reaproveitada (sem DHCP a cada
+ * despertar) por até metade do tempo concedido pelo servidor, no máximo
+ * WIFI_MANAGER_LEASE_REUSE_MS; sem energia a idade dela é desconhecida e o
+ * DHCP volta a rodar.
+ *
+ * IP fixo (concessão reaproveitada ou estático) sem MQTT conectado em
+ * WIFI_MANAGER_IP_CHECK_MS é descartado e o DHCP assume até o próximo boot.
+ */
+#define WIFI_MANAGER_LEASE_REUSE_MS (60LL * 60 * 1000)   // Teto; o limite é lease / 2 (T1 do DHCP)
+#define WIFI_MANAGER_IP_CHECK_MS 20000
+
+// Último AP associado (persistido pelo config_store)
+typedef struct {
+    bool valid;
+    uint8_t bssid[6];
+    uint8_t channel;
+} wifi_ap_cache_t;
+
+// Origem do endereço IP da conexão atual
+typedef enum {
+    WIFI_IP_DHCP,
+    WIFI_IP_LEASE,    // Concessão anterior do DHCP reaproveitada
+    WIFI_IP_STATIC,   // wifi_manager_set_static_ip
+} wifi_ip_mode_t;
+
+/**
+ * Tempos do rádio e da associação
+ */
+typedef struct {
+    uint32_t radio_cycles;       // Desligamentos planejados do rádio
+    uint32_t last_assoc_ms;      // Rádio ligado -> associado (última associação)
+    uint32_t max_assoc_ms;
+    uint32_t last_ip_ms;         // Associado -> IP (DHCP ou IP fixo)
+    uint32_t max_ip_ms;
+    uint32_t last_radio_on_ms;   // Rádio ligado no último ciclo (ligar -> desligar)
+    uint32_t cache_hits;         // Associações diretas pelo BSSID/canal em cache
+    uint32_t cache_misses;       // Cache descartado: voltou à varredura completa
+    uint32_t lease_reused;       // Conexões sem DHCP (concessão em cache)
+    uint32_t dhcp_fallbacks;     // IP fixo sem MQTT: voltou ao DHCP
+} wifi_manager_stats_t;
+
+/**
+ * @brief IP estático (opcional; antes do wifi_manager_init)
+ * @param dns Pode ser NULL (usa o gateway)
+ * @return ESP_ERR_INVALID_ARG se algum endereço não for válido
+ */
+esp_err_t wifi_manager_set_static_ip(const char *ip, const char *netmask, const char *gateway,
+                                     const char *dns);
 
 void wifi_manager_init(const char *ssid, const char *password, wifi_auth_mode_t authmode);
 bool wifi_manager_is_connected(void);
 
+/**
+ * @brief Desliga o rádio entre janelas (queda planejada: sem reconexão nem backoff)
+ */
+esp_err_t wifi_manager_radio_off(void);
+
+/**
+ * @brief Religa o rádio e associa pelo BSSID/canal em cache
+ */
+esp_err_t wifi_manager_radio_on(void);
+
+/**
+ * @brief Tempos de associação e de rádio ligado
+ */
+wifi_manager_stats_t wifi_manager_get_stats(void);
+
+/**
+ * @brief Origem do IP atual ("dhcp", "lease" ou "static")
+ */
+const char *wifi_manager_ip_mode_name(void);
+
+/**
+ * @brief Cópia do AP em cache (para a NVS)
+ */
+wifi_ap_cache_t wifi_manager_get_ap_cache(void);
+
+/**
+ * @brief Substitui o AP em cache pelo salvo na NVS (boot, antes do wifi_manager_init)
+ */
+void wifi_manager_restore_ap_cache(const wifi_ap_cache_t *cache);
+
 #endif // WIFI_MANAGER_H
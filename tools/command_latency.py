@@ -0,0 +1,129 @@
+"""
+Mede a latência fim a fim dos comandos do ESP32.
+
+Publica comandos com "id" e casa cada um com o ack em esp32/ack:
+  ida e volta  = ack recebido aqui - comando publicado aqui
+  dispatch_us  = recepção no ESP32 -> início da execução (fila de comandos)
+  actuate_us   = recepção no ESP32 -> efeito aplicado (GPIO / configuração)
+
+Uso:
+  python3 tools/command_latency.py                       # 50x get_status
+  python3 tools/command_latency.py --target solenoid -n 20
+  python3 tools/command_latency.py --target config --interval 2
+"""
+import argparse
+import json
+import time
+import uuid
+import logging
+import threading
+import statistics
+import paho.mqtt.client as mqtt
+
+# CONFIG
+MQTT_BROKER = "localhost"
+MQTT_PORT = 1883
+MQTT_TOPIC_ACK = "esp32/ack"
+
+# Tópico e payload de cada alvo (o "id" é acrescentado no envio)
+TARGETS = {
+    "commands": ("esp32/commands", lambda i: {"command": "get_status"}),
+    "solenoid": ("esp32/solenoid", lambda i: {"state": i % 2 == 0}),
+    "config":   ("esp32/config",   lambda i: {"irrigation_threshold": 25}),
+}
+
+ACK_TIMEOUT_S = 10
+
+logging.basicConfig(level=logging.INFO, format="%(asctime)s %(levelname)s: %(message)s")
+
+sent = {}       # id -> instante de envio (time.monotonic)
+results = {}    # id -> (rtt_ms, ack)
+lock = threading.Lock()
+connected = threading.Event()
+
+def percentile(values, p):
+    ordered = sorted(values)
+    index = min(len(ordered) - 1, int(round(p / 100 * (len(ordered) - 1))))
+    return ordered[index]
+
+def on_connect(client, userdata, flags, rc):
+    if rc == 0:
+        logging.info("MQTT conectado com sucesso")
+        client.subscribe(MQTT_TOPIC_ACK, qos=1)
+        connected.set()
+    else:
+        logging.error("Erro ao conectar no MQTT, rc=%s", rc)
+
+def on_message(client, userdata, msg):
+    now = time.monotonic()
+    try:
+        ack = json.loads(msg.payload.decode())
+    except ValueError:
+        return
+
+    cmd_id = ack.get("id")
+    with lock:
+        if cmd_id not in sent or cmd_id in results:
+            return
+        results[cmd_id] = ((now - sent[cmd_id]) * 1000, ack)
+
+def report(count):
+    rtts = [rtt for rtt, _ in results.values()]
+    dispatch = [ack["dispatch_us"] / 1000 for _, ack in results.values() if "dispatch_us" in ack]
+    actuate = [ack["actuate_us"] / 1000 for _, ack in results.values() if "actuate_us" in ack]
+    errors = sum(1 for _, ack in results.values() if ack.get("result") != "ok")
+
+    print(f"\nEnviados: {count}  confirmados: {len(results)}  "
+          f"perdidos: {count - len(results)}  com erro: {errors}")
+    if not rtts:
+        return
+    print(f"Ida e volta (ms): p50={percentile(rtts, 50):.1f}  p90={percentile(rtts, 90):.1f}  "
+          f"p99={percentile(rtts, 99):.1f}  max={max(rtts):.1f}")
+    if dispatch:
+        print(f"No ESP32 (ms, mediana): dispatch={statistics.median(dispatch):.2f}  "
+              f"actuate={statistics.median(actuate):.2f}")
+
+def main():
+    parser = argparse.ArgumentParser(description="Latência fim a fim dos comandos do ESP32")
+    parser.add_argument("--target", choices=TARGETS.keys(), default="commands")
+    parser.add_argument("-n", "--count", type=int, default=50)
+    parser.add_argument("--interval", type=float, default=0.5, help="segundos entre comandos")
+    args = parser.parse_args()
+
+    client = mqtt.Client()
+    client.on_connect = on_connect
+    client.on_message = on_message
+
+    logging.info("Conectando ao broker MQTT...")
+    client.connect(MQTT_BROKER, MQTT_PORT, 60)
+    client.loop_start()
+    if not connected.wait(10):
+        logging.error("Sem conexão com o broker")
+        return
+
+    topic, build = TARGETS[args.target]
+    prefix = uuid.uuid4().hex[:6]
+    for i in range(args.count):
+        cmd_id = f"{prefix}-{i}"
+        payload = build(i)
+        payload["id"] = cmd_id
+        with lock:
+            sent[cmd_id] = time.monotonic()
+        client.publish(topic, json.dumps(payload, separators=(",", ":")), qos=1)
+        time.sleep(args.interval)
+
+    # Aguarda os acks atrasados
+    deadline = time.monotonic() + ACK_TIMEOUT_S
+    while time.monotonic() < deadline:
+        with lock:
+            if len(results) == len(sent):
+                break
+        time.sleep(0.1)
+
+    client.loop_stop()
+    client.disconnect()
+    with lock:
+        report(args.count)
+
+if __name__ == "__main__":
+    main()
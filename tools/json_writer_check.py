@@ -0,0 +1,97 @@
+"""
+Verifica o escape de strings do escritor de JSON (main/json_writer.c).
+
+Compila o arquivo C da firmware para o host e escreve objetos com chaves e
+valores contendo aspas, barras, acentos (UTF-8) e todos os caracteres de
+controle 0x01-0x1f. Cada caso verifica:
+  - a saída é JSON válido (json.loads)
+  - a string lida de volta é igual à original
+  - não sobra nenhum caractere de controle cru na saída
+  - buffer pequeno demais: json_writer_finish retorna 0, sem escape pela metade
+
+Uso:
+  python3 tools/json_writer_check.py
+  python3 tools/json_writer_check.py -v
+"""
+import argparse
+import ctypes
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+SOURCE = os.path.join(ROOT, "main", "json_writer.c")
+
+
+class Writer(ctypes.Structure):
+    _fields_ = [("buf", ctypes.c_char_p), ("size", ctypes.c_size_t), ("len", ctypes.c_size_t),
+                ("need_comma", ctypes.c_bool), ("overflow", ctypes.c_bool)]
+
+
+def load_writer():
+    lib_path = os.path.join(tempfile.mkdtemp(), "json_writer.so")
+    subprocess.run([os.environ.get("CC", "cc"), "-std=c11", "-O2", "-shared", "-fPIC",
+                    "-I", os.path.join(ROOT, "main"), SOURCE, "-o", lib_path], check=True)
+    lib = ctypes.CDLL(lib_path)
+    w = ctypes.POINTER(Writer)
+    lib.json_writer_init.argtypes = [w, ctypes.c_char_p, ctypes.c_size_t]
+    lib.json_writer_begin_object.argtypes = [w, ctypes.c_char_p]
+    lib.json_writer_end_object.argtypes = [w]
+    lib.json_writer_add_string.argtypes = [w, ctypes.c_char_p, ctypes.c_char_p]
+    lib.json_writer_finish.argtypes = [w]
+    lib.json_writer_finish.restype = ctypes.c_size_t
+    return lib
+
+
+def write_object(lib, key, value, size):
+    buf = ctypes.create_string_buffer(size)
+    w = Writer()
+    lib.json_writer_init(ctypes.byref(w), buf, size)
+    lib.json_writer_begin_object(ctypes.byref(w), None)
+    lib.json_writer_add_string(ctypes.byref(w), key.encode(), value.encode())
+    lib.json_writer_end_object(ctypes.byref(w))
+    n = lib.json_writer_finish(ctypes.byref(w))
+    return buf.raw[:n].decode()
+
+
+def check(lib, key, value, verbose):
+    out = write_object(lib, key, value, 512)
+    try:
+        ok = json.loads(out) == {key: value}
+    except ValueError:
+        ok = False
+    ok = ok and not any(ord(c) < 0x20 for c in out)
+
+    # Buffer que corta no meio do escape: descarta tudo
+    exact = len(out.encode()) + 1
+    ok = ok and write_object(lib, key, value, exact) == out
+    ok = ok and all(write_object(lib, key, value, size) == "" for size in range(1, exact))
+
+    if verbose or not ok:
+        print(f"{'OK ' if ok else 'FALHA'} {value!r} -> {out}")
+    return ok
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("-v", "--verbose", action="store_true")
+    args = parser.parse_args()
+
+    lib = load_writer()
+    cases = [
+        ("id", "a17"),
+        ("id", 'aspas " e barra \\'),
+        ("id", "linha\nnova\r\ttab\bback\fform"),
+        ("id", "".join(chr(c) for c in range(1, 0x20))),
+        ("id", "umidade 30% çãé"),
+        ("chave\ncom\tcontrole", "valor"),
+    ]
+    results = [check(lib, key, value, args.verbose) for key, value in cases]
+    print(f"json_writer: {sum(results)}/{len(results)} caso(s) OK")
+    sys.exit(0 if all(results) else 1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,62 @@
+"""
+Mostra as propriedades MQTT 5 das mensagens publicadas pelo ESP32.
+
+Conecta em MQTT 5 e imprime, para cada mensagem de esp32/#:
+user properties (device_id, schema), content type, expiry restante e
+se o corpo ainda traz "device_id" (esperado só quando o ESP32 caiu para 3.1.1).
+
+Topic aliases são resolvidos pelo broker e não chegam ao assinante:
+para conferi-los capture a porta 8883 no Wireshark (com a chave TLS) e veja
+os PUBLISH com tópico vazio e a propriedade Topic Alias.
+
+Uso:
+  mosquitto -v -c tools/mosquitto_mqtt5.conf
+  python3 tools/mqtt5_inspect.py
+"""
+import json
+import logging
+import paho.mqtt.client as mqtt
+
+# CONFIG
+MQTT_BROKER = "localhost"
+MQTT_PORT = 1883
+MQTT_TOPIC = "esp32/#"
+
+logging.basicConfig(level=logging.INFO, format="%(asctime)s %(levelname)s: %(message)s")
+
+def on_connect(client, userdata, flags, rc, properties=None):
+    if rc == 0:
+        logging.info("MQTT 5 conectado com sucesso")
+        client.subscribe(MQTT_TOPIC, qos=1)
+        logging.info(f"Inscrito no tópico: {MQTT_TOPIC}")
+    else:
+        logging.error("Erro ao conectar no MQTT, rc=%s", rc)
+
+def on_message(client, userdata, msg):
+    props = getattr(msg, "properties", None)
+    user = dict(getattr(props, "UserProperty", []) or [])
+    content_type = getattr(props, "ContentType", None)
+    expiry = getattr(props, "MessageExpiryInterval", None)
+
+    try:
+        body = json.loads(msg.payload.decode())
+    except ValueError:
+        body = None
+    in_body = isinstance(body, dict) and "device_id" in body
+
+    logging.info(f"[{msg.topic}] {len(msg.payload)} bytes  user={user}  "
+                 f"content_type={content_type}  expiry={expiry}  device_id_no_corpo={in_body}")
+    if not user and not in_body:
+        logging.warning("Mensagem sem identificação do dispositivo")
+
+def main():
+    client = mqtt.Client(protocol=mqtt.MQTTv5)
+    client.on_connect = on_connect
+    client.on_message = on_message
+
+    logging.info("Conectando ao broker MQTT...")
+    client.connect(MQTT_BROKER, MQTT_PORT, 60)
+    client.loop_forever()
+
+if __name__ == "__main__":
+    main()
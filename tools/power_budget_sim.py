@@ -0,0 +1,125 @@
+"""
+Simula a política de energia (main/power_budget_policy.c) com curvas sintéticas.
+
+Compila o arquivo C da firmware para o host e passa por ele leituras de tensão
+a cada READ_MIN minutos (o mesmo filtro, a mesma curva de carga e os mesmos
+níveis com histerese do ESP32). Cada cenário verifica:
+  discharge  descida contínua 4,2 V -> 3,3 V: níveis só descem, sem oscilar
+  solar      dias de sol e noites com ruído de carga e nuvens: poucas trocas
+  cloudy     dias nublados seguidos: chega à reserva e volta com o sol
+
+Uso:
+  python3 tools/power_budget_sim.py                  # todos os cenários
+  python3 tools/power_budget_sim.py --scenario solar --days 5 -v
+"""
+import argparse
+import ctypes
+import math
+import os
+import random
+import subprocess
+import sys
+import tempfile
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+SOURCE = os.path.join(ROOT, "main", "power_budget_policy.c")
+
+READ_MIN = 1               # POWER_BUDGET_READ_MIN_MS
+LOAD_SAG_MV = 60           # Queda de tensão com WiFi transmitindo
+MAX_FLIPS_PER_DAY = 4      # Trocas de nível aceitas por dia com ruído
+
+
+def load_policy():
+    lib_path = os.path.join(tempfile.mkdtemp(), "power_budget_policy.so")
+    subprocess.run([os.environ.get("CC", "cc"), "-std=c11", "-O2", "-shared", "-fPIC",
+                    "-I", os.path.join(ROOT, "main"), SOURCE, "-o", lib_path], check=True)
+    lib = ctypes.CDLL(lib_path)
+    lib.power_budget_soc_from_mv.argtypes = [ctypes.c_uint16]
+    lib.power_budget_soc_from_mv.restype = ctypes.c_uint8
+    lib.power_budget_filter_mv.argtypes = [ctypes.c_uint16, ctypes.c_uint16]
+    lib.power_budget_filter_mv.restype = ctypes.c_uint16
+    lib.power_budget_level_for.argtypes = [ctypes.c_uint8, ctypes.c_int]
+    lib.power_budget_level_for.restype = ctypes.c_int
+    lib.power_budget_level_name.argtypes = [ctypes.c_int]
+    lib.power_budget_level_name.restype = ctypes.c_char_p
+    return lib
+
+
+def discharge(minute, days):
+    # Linear no tempo, em tensão: passa mais tempo nos níveis baixos que uma célula real
+    return 4200 - 900 * minute / (days * 1440)
+
+
+def solar(minute, sun=1.0):
+    # Descarrega 0,4 mV/min; de 8h às 17h o painel carrega até ~1,5 mV/min
+    hour = (minute / 60) % 24
+    charge = 0.0
+    if 8 <= hour < 17:
+        charge = 1.9 * sun * math.sin(math.pi * (hour - 8) / 9)
+    return charge - 0.4
+
+
+def run(lib, scenario, days, seed, verbose):
+    rng = random.Random(seed)
+    filtered = 0
+    level = 0
+    mv = 3950.0 if scenario != "discharge" else 4200.0
+    flips = []
+    time_in = {}
+    levels_seen = []
+
+    for minute in range(0, days * 1440, READ_MIN):
+        if scenario == "discharge":
+            mv = discharge(minute, days)
+            sample = mv
+        else:
+            sun = 1.0
+            if scenario == "cloudy":
+                day = minute // 1440
+                sun = 0.1 if 1 <= day < days - 2 else 1.0
+            mv = min(4200.0, max(3300.0, mv + solar(minute, sun) * READ_MIN * rng.uniform(0.5, 1.5)))
+            sample = mv - (LOAD_SAG_MV if rng.random() < 0.2 else 0) + rng.gauss(0, 8)
+
+        filtered = lib.power_budget_filter_mv(filtered, int(sample))
+        soc = lib.power_budget_soc_from_mv(filtered)
+        new_level = lib.power_budget_level_for(soc, level)
+        if new_level != level:
+            flips.append((minute, level, new_level, filtered, soc))
+            if verbose:
+                print(f"  dia {minute // 1440} {minute % 1440 // 60:02d}:{minute % 60:02d}  "
+                      f"{lib.power_budget_level_name(level).decode():>7} -> "
+                      f"{lib.power_budget_level_name(new_level).decode():<7} {filtered} mV {soc}%")
+            level = new_level
+        levels_seen.append(level)
+        name = lib.power_budget_level_name(level).decode()
+        time_in[name] = time_in.get(name, 0) + READ_MIN
+
+    ok = True
+    if scenario == "discharge":
+        ok = all(b >= a for a, b in zip(levels_seen, levels_seen[1:])) and level == 3
+    elif scenario == "solar":
+        ok = len(flips) <= MAX_FLIPS_PER_DAY * days
+    elif scenario == "cloudy":
+        ok = 3 in levels_seen and level < 3
+
+    share = ", ".join(f"{k} {100 * v / (days * 1440):.0f}%" for k, v in time_in.items())
+    print(f"{scenario:<10} {'OK ' if ok else 'FALHA'} {len(flips)} troca(s) em {days} dia(s): {share}")
+    return ok
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--scenario", choices=["discharge", "solar", "cloudy"], action="append")
+    parser.add_argument("--days", type=int, default=7)
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("-v", "--verbose", action="store_true")
+    args = parser.parse_args()
+
+    lib = load_policy()
+    results = [run(lib, s, args.days, args.seed, args.verbose)
+               for s in (args.scenario or ["discharge", "solar", "cloudy"])]
+    sys.exit(0 if all(results) else 1)
+
+
+if __name__ == "__main__":
+    main()
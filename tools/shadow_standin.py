@@ -0,0 +1,165 @@
+"""
+Simulador local do Device Shadow (AWS IoT) sobre um broker Mosquitto.
+
+Implementa o suficiente do protocolo para testar o shadow_sync do ESP32:
+  $aws/things/<thing>/shadow/get     -> get/accepted ou get/rejected (404)
+  $aws/things/<thing>/shadow/update  -> update/accepted e update/delta
+
+Os documentos têm o mesmo formato do serviço real: "metadata" (timestamp de
+cada campo de desired/reported), "version", "timestamp" e "clientToken" quando
+enviado. Documentos maiores que o buffer MQTT ou que o limite de tokens do
+ESP32 (DEVICE_RX_BUFFER / DEVICE_MAX_TOKENS) geram um aviso.
+
+Uso:
+  python3 tools/shadow_standin.py
+  # mudar um parâmetro (gera delta para o ESP32):
+  mosquitto_pub -t '$aws/things/esp32_estufa_inteligente_001/shadow/update' \
+      -m '{"state":{"desired":{"irrigation_threshold":30}}}'
+"""
+import json
+import time
+import logging
+import paho.mqtt.client as mqtt
+
+# CONFIG
+MQTT_BROKER = "localhost"
+MQTT_PORT = 1883
+SHADOW_PREFIX = "$aws/things/"
+
+# Limites do ESP32 (MQTT_RX_BUFFER_SIZE em mqtt_manager.h, SHADOW_MAX_TOKENS em shadow_sync.h)
+DEVICE_RX_BUFFER = 4096
+DEVICE_MAX_TOKENS = 320
+
+logging.basicConfig(level=logging.INFO, format="%(asctime)s %(levelname)s: %(message)s")
+
+# thing -> {"desired": {}, "reported": {}, "metadata": {"desired": {}, "reported": {}}, "version": int}
+shadows = {}
+
+def shadow_topic(thing, suffix):
+    return f"{SHADOW_PREFIX}{thing}/shadow/{suffix}"
+
+def merge(dst, meta, src, now):
+    # null remove o campo, como no serviço real; metadata guarda o instante de cada campo
+    for key, value in src.items():
+        if value is None:
+            dst.pop(key, None)
+            meta.pop(key, None)
+        else:
+            dst[key] = value
+            meta[key] = {"timestamp": now}
+
+def count_tokens(value):
+    # Mesma contagem do json_parser do ESP32: um token por valor e por chave
+    if isinstance(value, dict):
+        return 1 + sum(1 + count_tokens(v) for v in value.values())
+    if isinstance(value, list):
+        return 1 + sum(count_tokens(v) for v in value)
+    return 1
+
+def compute_delta(shadow):
+    return {k: v for k, v in shadow["desired"].items() if shadow["reported"].get(k) != v}
+
+def publish(client, topic, doc):
+    payload = json.dumps(doc, separators=(",", ":"))
+    tokens = count_tokens(doc)
+    if len(payload) > DEVICE_RX_BUFFER or tokens > DEVICE_MAX_TOKENS:
+        logging.warning(f"Documento excede o ESP32: {len(payload)}/{DEVICE_RX_BUFFER} bytes, "
+                        f"{tokens}/{DEVICE_MAX_TOKENS} tokens")
+    client.publish(topic, payload, qos=1)
+    logging.info(f"-> [{topic}] {payload}")
+
+def with_token(doc, request):
+    # clientToken do pedido volta na resposta
+    if isinstance(request, dict) and "clientToken" in request:
+        doc["clientToken"] = request["clientToken"]
+    return doc
+
+def handle_get(client, thing, request):
+    shadow = shadows.get(thing)
+    if shadow is None:
+        publish(client, shadow_topic(thing, "get/rejected"),
+                with_token({"code": 404, "message": f"No shadow exists with name: '{thing}'",
+                            "timestamp": int(time.time())}, request))
+        return
+
+    state = {"desired": shadow["desired"], "reported": shadow["reported"]}
+    delta = compute_delta(shadow)
+    if delta:
+        state["delta"] = delta
+    publish(client, shadow_topic(thing, "get/accepted"),
+            with_token({"state": state, "metadata": shadow["metadata"],
+                        "version": shadow["version"], "timestamp": int(time.time())}, request))
+
+def handle_update(client, thing, doc):
+    state = doc.get("state")
+    if not isinstance(state, dict):
+        publish(client, shadow_topic(thing, "update/rejected"),
+                {"code": 400, "message": "Missing required node: state"})
+        return
+
+    shadow = shadows.setdefault(thing, {"desired": {}, "reported": {},
+                                        "metadata": {"desired": {}, "reported": {}}, "version": 0})
+    now = int(time.time())
+    metadata = {}
+    for section in ("desired", "reported"):
+        changes = state.get(section) or {}
+        merge(shadow[section], shadow["metadata"][section], changes, now)
+        if changes:
+            metadata[section] = {key: {"timestamp": now} for key in changes}
+    shadow["version"] += 1
+
+    publish(client, shadow_topic(thing, "update/accepted"),
+            with_token({"state": state, "metadata": metadata,
+                        "version": shadow["version"], "timestamp": now}, doc))
+
+    # Delta só quando o desired muda e ainda difere do reported
+    delta = compute_delta(shadow)
+    if "desired" in state and delta:
+        publish(client, shadow_topic(thing, "update/delta"),
+                {"version": shadow["version"], "timestamp": now, "state": delta,
+                 "metadata": {key: shadow["metadata"]["desired"][key] for key in delta}})
+
+def on_connect(client, userdata, flags, rc):
+    if rc == 0:
+        logging.info("MQTT conectado com sucesso")
+        client.subscribe(SHADOW_PREFIX + "+/shadow/get", qos=1)
+        client.subscribe(SHADOW_PREFIX + "+/shadow/update", qos=1)
+        logging.info("Simulador de shadow ativo")
+    else:
+        logging.error("Erro ao conectar no MQTT, rc=%s", rc)
+
+def on_message(client, userdata, msg):
+    # $aws/things/<thing>/shadow/<op>
+    parts = msg.topic.split("/")
+    if len(parts) != 5:
+        return
+    thing, op = parts[2], parts[4]
+
+    logging.info(f"<- [{msg.topic}] {msg.payload.decode(errors='replace')}")
+
+    if op == "get":
+        try:
+            request = json.loads(msg.payload.decode() or "{}")
+        except ValueError:
+            request = {}
+        handle_get(client, thing, request)
+    elif op == "update":
+        try:
+            doc = json.loads(msg.payload.decode())
+        except ValueError:
+            publish(client, shadow_topic(thing, "update/rejected"),
+                    {"code": 400, "message": "Payload contains invalid json"})
+            return
+        handle_update(client, thing, doc)
+
+def main():
+    client = mqtt.Client()
+    client.on_connect = on_connect
+    client.on_message = on_message
+
+    logging.info("Conectando ao broker MQTT...")
+    client.connect(MQTT_BROKER, MQTT_PORT, 60)
+    client.loop_forever()
+
+if __name__ == "__main__":
+    main()
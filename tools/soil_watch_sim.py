@@ -0,0 +1,164 @@
+"""
+Simula a vigia do solo do ULP (main/soil_watch_model.c) com curvas sintéticas.
+
+Compila o modelo C da firmware para o host (o mesmo que ulp/soil_watch.S espelha)
+e passa por ele uma leitura a cada PERIOD_S segundos, com ruído de ADC.
+Ao acordar, o "ESP32" recarrega o programa como antes de cada deep sleep.
+Cada cenário verifica:
+  threshold  limiar em ADC igual a plant_config_should_irrigate para todo raw/limiar
+  drying     secagem com irrigação ao acordar: um despertar por ciclo, logo após o limiar
+  hover      solo parado no limiar sem irrigar: a histerese segura os despertares
+  dry_start  dormiu com o solo já seco: não acorda até molhar e secar de novo
+  disabled   irrigação automática desligada: nunca acorda
+
+Uso:
+  python3 tools/soil_watch_sim.py                    # todos os cenários
+  python3 tools/soil_watch_sim.py --scenario drying --days 10 -v
+"""
+import argparse
+import ctypes
+import os
+import random
+import subprocess
+import sys
+import tempfile
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+SOURCE = os.path.join(ROOT, "main", "soil_watch_model.c")
+
+PERIOD_S = 30              # SOIL_WATCH_PERIOD_MS
+NOISE_RAW = 15             # Ruído do ADC após a média de 4 leituras
+THRESHOLD_PERCENT = 30     # soil_moisture_min - irrigation_threshold
+MAX_LATENCY_MIN = 5        # Do cruzamento real ao despertar
+MAX_EARLY_PERCENT = 1      # Ruído pode acordar antes, com o solo até 1 ponto acima do limiar
+
+
+class Thresholds(ctypes.Structure):
+    _fields_ = [("dry_raw", ctypes.c_uint16), ("rearm_raw", ctypes.c_uint16),
+                ("debounce", ctypes.c_uint16)]
+
+
+class State(ctypes.Structure):
+    _fields_ = [("armed", ctypes.c_uint16), ("over", ctypes.c_uint16),
+                ("last_raw", ctypes.c_uint16), ("min_raw", ctypes.c_uint16),
+                ("max_raw", ctypes.c_uint16), ("samples", ctypes.c_uint16)]
+
+
+def load_model():
+    lib_path = os.path.join(tempfile.mkdtemp(), "soil_watch_model.so")
+    subprocess.run([os.environ.get("CC", "cc"), "-std=c11", "-O2", "-shared", "-fPIC",
+                    "-I", os.path.join(ROOT, "main"), SOURCE, "-o", lib_path], check=True)
+    lib = ctypes.CDLL(lib_path)
+    lib.soil_watch_thresholds_for.argtypes = [ctypes.c_int, ctypes.c_bool]
+    lib.soil_watch_thresholds_for.restype = Thresholds
+    lib.soil_watch_reset.argtypes = [ctypes.POINTER(State)]
+    lib.soil_watch_step.argtypes = [ctypes.POINTER(Thresholds), ctypes.POINTER(State), ctypes.c_uint16]
+    lib.soil_watch_step.restype = ctypes.c_bool
+    return lib
+
+
+def percent_of(raw):
+    # Mesma conversão da task do solo: 4095 (seco) -> 0%, 0 (úmido) -> 100%
+    return 100 - (raw * 100) // 4095
+
+
+def raw_of(percent):
+    return int(round((100 - percent) * 4095 / 100))
+
+
+def check_threshold(lib):
+    mismatches = 0
+    for threshold in range(-5, 101):
+        thr = lib.soil_watch_thresholds_for(threshold, True)
+        for raw in range(4096):
+            if (raw > thr.dry_raw) != (percent_of(raw) < threshold):
+                mismatches += 1
+    off = lib.soil_watch_thresholds_for(THRESHOLD_PERCENT, False)
+    over = lib.soil_watch_thresholds_for(120, True)
+    ok = mismatches == 0 and off.dry_raw == 0xFFFF and over.dry_raw == 0
+    print(f"{'threshold':<10} {'OK ' if ok else 'FALHA'} {mismatches} divergência(s) em 106 limiares x 4096 leituras")
+    return ok
+
+
+def run(lib, scenario, days, seed, verbose):
+    rng = random.Random(seed)
+    thr = lib.soil_watch_thresholds_for(THRESHOLD_PERCENT, scenario != "disabled")
+    state = State()
+    lib.soil_watch_reset(ctypes.byref(state))
+
+    steps_per_day = 86400 // PERIOD_S
+    dry_per_step = 8.0 / steps_per_day           # Perde ~8 pontos por dia
+    moisture = 20.0 if scenario == "dry_start" else 45.0
+    crossed_at = None
+    wakes = []
+    latencies = []
+
+    for step in range(days * steps_per_day):
+        if scenario == "hover":
+            moisture = THRESHOLD_PERCENT - 0.5 + 0.5 * ((step // 240) % 2)
+        elif scenario == "dry_start" and step == 2 * steps_per_day:
+            moisture = 45.0                      # Chuva: molha e volta a secar
+            crossed_at = None
+        else:
+            moisture -= dry_per_step
+
+        # Cruzamento real: a leitura sem ruído já pediria irrigação na firmware
+        if crossed_at is None and percent_of(raw_of(moisture)) < THRESHOLD_PERCENT:
+            crossed_at = step
+        raw = min(4095, max(0, raw_of(moisture) + int(rng.gauss(0, NOISE_RAW))))
+
+        if lib.soil_watch_step(ctypes.byref(thr), ctypes.byref(state), raw):
+            latency_min = (step - crossed_at) * PERIOD_S / 60 if crossed_at is not None else None
+            early = percent_of(raw_of(moisture)) - THRESHOLD_PERCENT + 1 if crossed_at is None else 0
+            wakes.append(step)
+            latencies.append((latency_min, early))
+            if verbose:
+                lat = (f"{latency_min:.1f} min após o limiar" if latency_min is not None
+                       else f"{early} ponto(s) antes do limiar")
+                print(f"  dia {step // steps_per_day} {step % steps_per_day * PERIOD_S // 3600:02d}h  "
+                      f"acordou com raw {raw} ({percent_of(raw)}%), {lat}, {state.samples} leitura(s)")
+            # Núcleos acordados: irrigam (exceto em hover) e recarregam o ULP ao dormir
+            if scenario in ("drying", "dry_start"):
+                moisture = 45.0
+                crossed_at = None
+            lib.soil_watch_reset(ctypes.byref(state))
+
+    if scenario == "drying":
+        expected = int(days * 8 / (45 - THRESHOLD_PERCENT))
+        ok = (abs(len(wakes) - expected) <= 1 and
+              all((lat is not None and lat <= MAX_LATENCY_MIN) or (lat is None and early <= MAX_EARLY_PERCENT)
+                  for lat, early in latencies))
+    elif scenario == "hover":
+        ok = len(wakes) <= 1
+    elif scenario == "dry_start":
+        ok = len(wakes) >= 1 and wakes[0] >= 2 * steps_per_day
+    else:
+        ok = len(wakes) == 0
+
+    worst = max((lat for lat, _ in latencies if lat is not None), default=0)
+    print(f"{scenario:<10} {'OK ' if ok else 'FALHA'} {len(wakes)} despertar(es) em {days} dia(s), "
+          f"pior atraso {worst:.1f} min")
+    return ok
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--scenario", choices=["threshold", "drying", "hover", "dry_start", "disabled"],
+                        action="append")
+    parser.add_argument("--days", type=int, default=7)
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("-v", "--verbose", action="store_true")
+    args = parser.parse_args()
+
+    lib = load_model()
+    results = []
+    for scenario in args.scenario or ["threshold", "drying", "hover", "dry_start", "disabled"]:
+        if scenario == "threshold":
+            results.append(check_threshold(lib))
+        else:
+            results.append(run(lib, scenario, args.days, args.seed, args.verbose))
+    sys.exit(0 if all(results) else 1)
+
+
+if __name__ == "__main__":
+    main()